@@ -0,0 +1,94 @@
+// Copyright 2022 DeepMind Technologies Limited
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "dataset/arena_pool.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+#include "google/protobuf/arena.h"
+#include "absl/synchronization/mutex.h"
+
+namespace deepmind::code_contests {
+
+namespace {
+
+std::unique_ptr<google::protobuf::Arena> NewArena(char* block,
+                                                  const size_t block_size) {
+  google::protobuf::ArenaOptions options;
+  options.initial_block = block;
+  options.initial_block_size = block_size;
+  return std::make_unique<google::protobuf::Arena>(options);
+}
+
+}  // namespace
+
+std::shared_ptr<ArenaPool> ArenaPool::Create(ArenaPoolOptions options) {
+  return std::shared_ptr<ArenaPool>(new ArenaPool(options));
+}
+
+std::shared_ptr<google::protobuf::Arena> ArenaPool::Acquire() {
+  Entry* entry;
+  {
+    absl::MutexLock l(&mu_);
+    if (!free_entries_.empty()) {
+      entry = free_entries_.back();
+      free_entries_.pop_back();
+    } else {
+      auto new_entry = std::make_unique<Entry>();
+      new_entry->block_size = options_.initial_block_size;
+      // Not value-initialized, unlike std::make_unique<char[]>.
+      new_entry->block.reset(new char[new_entry->block_size]);
+      new_entry->arena =
+          NewArena(new_entry->block.get(), new_entry->block_size);
+      entry = new_entry.get();
+      entries_.push_back(std::move(new_entry));
+    }
+  }
+  // The deleter keeps the pool alive for as long as any of its arenas is in
+  // use.
+  return std::shared_ptr<google::protobuf::Arena>(
+      entry->arena.get(),
+      [pool = shared_from_this(), entry](google::protobuf::Arena*) {
+        pool->Release(entry);
+      });
+}
+
+int ArenaPool::num_arenas() const {
+  absl::MutexLock l(&mu_);
+  return entries_.size();
+}
+
+void ArenaPool::Release(Entry* const entry) {
+  const uint64_t space_allocated = entry->arena->SpaceAllocated();
+  if (space_allocated > entry->block_size &&
+      entry->block_size < options_.max_block_size) {
+    // The arena overflowed its first block, so it had to allocate more from
+    // the heap. Grow the first block so that this is not needed next time.
+    entry->arena.reset();
+    entry->block_size =
+        std::min<size_t>(space_allocated, options_.max_block_size);
+    entry->block.reset(new char[entry->block_size]);
+    entry->arena = NewArena(entry->block.get(), entry->block_size);
+  } else {
+    entry->arena->Reset();
+  }
+  absl::MutexLock l(&mu_);
+  free_entries_.push_back(entry);
+}
+
+}  // namespace deepmind::code_contests
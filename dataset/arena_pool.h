@@ -0,0 +1,92 @@
+// Copyright 2022 DeepMind Technologies Limited
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// A pool of protobuf arenas that are reset and reused instead of freed.
+//
+// Parsing a ContestProblem onto the heap allocates every Test submessage and
+// every string separately. Parsing it onto an arena turns those into pointer
+// bumps, and resetting the arena afterwards frees them all at once. Arenas from
+// a pool keep their first block across resets, and that block grows to fit
+// the largest use seen so far, so steady-state parsing does not touch the heap
+// at all.
+//
+// Example usage:
+//
+//   std::shared_ptr<ArenaPool> pool = ArenaPool::Create();
+//   {
+//     std::shared_ptr<google::protobuf::Arena> arena = pool->Acquire();
+//     auto* problem =
+//         google::protobuf::Arena::CreateMessage<ContestProblem>(arena.get());
+//     ...
+//   }  // The arena is reset and returned to the pool here.
+
+#ifndef THIRD_PARTY_DEEPMIND_CODE_CONTESTS_DATASET_ARENA_POOL_H_
+#define THIRD_PARTY_DEEPMIND_CODE_CONTESTS_DATASET_ARENA_POOL_H_
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include "google/protobuf/arena.h"
+#include "absl/base/thread_annotations.h"
+#include "absl/synchronization/mutex.h"
+
+namespace deepmind::code_contests {
+
+struct ArenaPoolOptions {
+  // The size of the block each arena starts out with.
+  size_t initial_block_size = 1 << 20;
+  // The largest block an arena's first block is grown to. Memory used beyond
+  // it is allocated from the heap on every use of the arena.
+  size_t max_block_size = 64 << 20;
+};
+
+class ArenaPool : public std::enable_shared_from_this<ArenaPool> {
+ public:
+  static std::shared_ptr<ArenaPool> Create(
+      ArenaPoolOptions options = ArenaPoolOptions());
+
+  ArenaPool(const ArenaPool&) = delete;
+  ArenaPool& operator=(const ArenaPool&) = delete;
+
+  // Returns an empty arena, creating one if all arenas are in use. The arena is
+  // reset and returned to the pool once the last copy of the returned pointer
+  // is destroyed, so every copy must be destroyed before messages allocated on
+  // the arena are used for the last time. Thread-safe.
+  std::shared_ptr<google::protobuf::Arena> Acquire();
+
+  // The number of arenas created so far, i.e. the most that were ever in use
+  // at the same time.
+  int num_arenas() const;
+
+ private:
+  struct Entry {
+    std::unique_ptr<char[]> block;
+    size_t block_size;
+    std::unique_ptr<google::protobuf::Arena> arena;
+  };
+
+  explicit ArenaPool(ArenaPoolOptions options) : options_(options) {}
+
+  void Release(Entry* entry);
+
+  const ArenaPoolOptions options_;
+  mutable absl::Mutex mu_;
+  std::vector<std::unique_ptr<Entry>> entries_ ABSL_GUARDED_BY(mu_);
+  std::vector<Entry*> free_entries_ ABSL_GUARDED_BY(mu_);
+};
+
+}  // namespace deepmind::code_contests
+
+#endif  // THIRD_PARTY_DEEPMIND_CODE_CONTESTS_DATASET_ARENA_POOL_H_
@@ -0,0 +1,77 @@
+// Copyright 2022 DeepMind Technologies Limited
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "dataset/arena_pool.h"
+
+#include <memory>
+#include <string>
+
+#include "google/protobuf/arena.h"
+#include "gtest/gtest.h"
+#include "contest_problem.pb.h"
+
+namespace deepmind::code_contests {
+namespace {
+
+ContestProblem* NewProblem(google::protobuf::Arena* arena) {
+  auto* problem = google::protobuf::Arena::CreateMessage<ContestProblem>(arena);
+  problem->set_name("123_X. Adding integers");
+  problem->add_public_tests()->set_input(std::string(1000, 'x'));
+  return problem;
+}
+
+TEST(ArenaPoolTest, ReusesReleasedArenas) {
+  std::shared_ptr<ArenaPool> pool = ArenaPool::Create();
+  google::protobuf::Arena* first;
+  {
+    std::shared_ptr<google::protobuf::Arena> arena = pool->Acquire();
+    first = arena.get();
+    NewProblem(arena.get());
+  }
+  std::shared_ptr<google::protobuf::Arena> arena = pool->Acquire();
+  EXPECT_EQ(arena.get(), first);
+  EXPECT_EQ(pool->num_arenas(), 1);
+}
+
+TEST(ArenaPoolTest, CreatesArenasWhileAllAreInUse) {
+  std::shared_ptr<ArenaPool> pool = ArenaPool::Create();
+  std::shared_ptr<google::protobuf::Arena> first = pool->Acquire();
+  std::shared_ptr<google::protobuf::Arena> second = pool->Acquire();
+  EXPECT_NE(first.get(), second.get());
+  EXPECT_EQ(pool->num_arenas(), 2);
+}
+
+TEST(ArenaPoolTest, GrowsFirstBlockToFitPreviousUse) {
+  std::shared_ptr<ArenaPool> pool = ArenaPool::Create(
+      {.initial_block_size = 256, .max_block_size = 1 << 20});
+  uint64_t space_used;
+  {
+    std::shared_ptr<google::protobuf::Arena> arena = pool->Acquire();
+    for (int i = 0; i < 10; ++i) NewProblem(arena.get());
+    space_used = arena->SpaceAllocated();
+  }
+  std::shared_ptr<google::protobuf::Arena> arena = pool->Acquire();
+  for (int i = 0; i < 10; ++i) NewProblem(arena.get());
+  // Everything fits in the first block, so nothing else was allocated.
+  EXPECT_EQ(arena->SpaceAllocated(), space_used);
+}
+
+TEST(ArenaPoolTest, PoolOutlivesItsUsers) {
+  std::shared_ptr<google::protobuf::Arena> arena =
+      ArenaPool::Create()->Acquire();
+  EXPECT_NE(NewProblem(arena.get()), nullptr);
+}
+
+}  // namespace
+}  // namespace deepmind::code_contests
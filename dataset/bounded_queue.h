@@ -0,0 +1,97 @@
+// Copyright 2022 DeepMind Technologies Limited
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef THIRD_PARTY_DEEPMIND_CODE_CONTESTS_DATASET_BOUNDED_QUEUE_H_
+#define THIRD_PARTY_DEEPMIND_CODE_CONTESTS_DATASET_BOUNDED_QUEUE_H_
+
+#include <cassert>
+#include <cstddef>
+#include <deque>
+#include <optional>
+#include <utility>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/synchronization/mutex.h"
+
+namespace deepmind::code_contests {
+
+// A multi-producer, multi-consumer FIFO queue holding at most `capacity`
+// items. Producers block while the queue is full, which bounds the memory used
+// when consumers are slower than producers.
+template <typename T>
+class BoundedQueue {
+ public:
+  explicit BoundedQueue(size_t capacity) : capacity_(capacity) {
+    assert(capacity > 0);
+  }
+
+  BoundedQueue(const BoundedQueue &) = delete;
+  BoundedQueue &operator=(const BoundedQueue &) = delete;
+
+  // Blocks until there is space in the queue, then adds `value`. Returns false
+  // without adding anything if the queue is closed.
+  bool Push(T value) {
+    absl::MutexLock l(&mu_);
+    mu_.Await(absl::Condition(this, &BoundedQueue::CanPush));
+    if (closed_) {
+      return false;
+    }
+    items_.push_back(std::move(value));
+    return true;
+  }
+
+  // Blocks until an item is available and removes it. Returns nullopt once the
+  // queue is closed and all items added before closing have been removed.
+  std::optional<T> Pop() {
+    absl::MutexLock l(&mu_);
+    mu_.Await(absl::Condition(this, &BoundedQueue::CanPop));
+    if (items_.empty()) {
+      return std::nullopt;
+    }
+    T value = std::move(items_.front());
+    items_.pop_front();
+    return value;
+  }
+
+  // Stops accepting new items and wakes up all blocked producers and
+  // consumers. Items already in the queue can still be removed.
+  void Close() {
+    absl::MutexLock l(&mu_);
+    closed_ = true;
+  }
+
+  // Closes the queue and drops any items in it.
+  void Cancel() {
+    absl::MutexLock l(&mu_);
+    closed_ = true;
+    items_.clear();
+  }
+
+ private:
+  bool CanPush() const ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+    return closed_ || items_.size() < capacity_;
+  }
+  bool CanPop() const ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+    return closed_ || !items_.empty();
+  }
+
+  absl::Mutex mu_;
+  std::deque<T> items_ ABSL_GUARDED_BY(mu_);
+  bool closed_ ABSL_GUARDED_BY(mu_) = false;
+  const size_t capacity_;
+};
+
+}  // namespace deepmind::code_contests
+
+#endif  // THIRD_PARTY_DEEPMIND_CODE_CONTESTS_DATASET_BOUNDED_QUEUE_H_
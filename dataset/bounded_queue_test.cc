@@ -0,0 +1,103 @@
+// Copyright 2022 DeepMind Technologies Limited
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "dataset/bounded_queue.h"
+
+#include <atomic>
+#include <optional>
+#include <thread>  // NOLINT(build/c++11)
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+
+namespace deepmind::code_contests {
+namespace {
+
+using ::testing::Optional;
+
+TEST(BoundedQueueTest, PopsInFifoOrder) {
+  BoundedQueue<int> queue(3);
+  EXPECT_TRUE(queue.Push(1));
+  EXPECT_TRUE(queue.Push(2));
+  EXPECT_TRUE(queue.Push(3));
+  EXPECT_THAT(queue.Pop(), Optional(1));
+  EXPECT_THAT(queue.Pop(), Optional(2));
+  EXPECT_THAT(queue.Pop(), Optional(3));
+}
+
+TEST(BoundedQueueTest, DrainsAfterClose) {
+  BoundedQueue<int> queue(2);
+  EXPECT_TRUE(queue.Push(1));
+  queue.Close();
+  EXPECT_FALSE(queue.Push(2));
+  EXPECT_THAT(queue.Pop(), Optional(1));
+  EXPECT_EQ(queue.Pop(), std::nullopt);
+}
+
+TEST(BoundedQueueTest, CancelDropsItems) {
+  BoundedQueue<int> queue(2);
+  EXPECT_TRUE(queue.Push(1));
+  queue.Cancel();
+  EXPECT_EQ(queue.Pop(), std::nullopt);
+}
+
+TEST(BoundedQueueTest, ProducerBlocksWhileFull) {
+  BoundedQueue<int> queue(1);
+  EXPECT_TRUE(queue.Push(1));
+  std::atomic<bool> pushed = false;
+  std::thread producer([&] {
+    queue.Push(2);
+    pushed = true;
+  });
+  absl::SleepFor(absl::Milliseconds(50));
+  EXPECT_FALSE(pushed);
+  EXPECT_THAT(queue.Pop(), Optional(1));
+  producer.join();
+  EXPECT_TRUE(pushed);
+  EXPECT_THAT(queue.Pop(), Optional(2));
+}
+
+TEST(BoundedQueueTest, ManyProducersAndConsumers) {
+  constexpr int kNumProducers = 4;
+  constexpr int kItemsPerProducer = 1000;
+  BoundedQueue<int> queue(8);
+  std::atomic<int> sum = 0;
+  std::vector<std::thread> consumers;
+  for (int i = 0; i < 3; ++i) {
+    consumers.emplace_back([&] {
+      while (std::optional<int> value = queue.Pop()) {
+        sum += *value;
+      }
+    });
+  }
+  std::vector<std::thread> producers;
+  for (int i = 0; i < kNumProducers; ++i) {
+    producers.emplace_back([&] {
+      for (int j = 1; j <= kItemsPerProducer; ++j) {
+        queue.Push(j);
+      }
+    });
+  }
+  for (auto& producer : producers) producer.join();
+  queue.Close();
+  for (auto& consumer : consumers) consumer.join();
+  EXPECT_EQ(sum,
+            kNumProducers * kItemsPerProducer * (kItemsPerProducer + 1) / 2);
+}
+
+}  // namespace
+}  // namespace deepmind::code_contests
@@ -0,0 +1,57 @@
+// Copyright 2022 DeepMind Technologies Limited
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Builds a problem index (see problem_index.h) for the given shards, so that
+// tools can seek straight to the problems they need. The index must be rebuilt
+// when shards change; readers fall back to scanning stale shards.
+//
+// Example usage:
+//
+//   build_problem_index --index_path=/path/to/dataset/code_contests.index \
+//     /path/to/dataset/code_contests_*
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "dataset/problem_index.h"
+#include "dataset/shard_reader.h"
+
+ABSL_FLAG(std::string, index_path, "", "Path to write the index to.");
+
+int main(int argc, char* argv[]) {
+  const std::vector<char*> args = absl::ParseCommandLine(argc, argv);
+  const std::string index_path = absl::GetFlag(FLAGS_index_path);
+  if (index_path.empty() || args.size() < 2) {
+    std::cerr << "Usage: " << args[0] << " --index_path=<path> <shard>...\n";
+    return 1;
+  }
+  const std::vector<std::string> shards(args.begin() + 1, args.end());
+
+  absl::StatusOr<deepmind::code_contests::ProblemIndex> index =
+      deepmind::code_contests::ProblemIndex::Build(
+          shards, deepmind::code_contests::ShardReadModeFromFlags());
+  if (!index.ok()) {
+    std::cerr << "Failed: " << index.status().message() << std::endl;
+    return 1;
+  }
+  if (absl::Status status = index->Save(index_path); !status.ok()) {
+    std::cerr << "Failed: " << status.message() << std::endl;
+    return 1;
+  }
+  std::cout << "Indexed " << index->file().problems_size() << " problems in "
+            << shards.size() << " shards to " << index_path << std::endl;
+}
@@ -0,0 +1,92 @@
+// Copyright 2022 DeepMind Technologies Limited
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Extracts the tests of every problem in the given shards into a test pack (see
+// test_pack.h), so that evaluation can use them without parsing the dataset.
+//
+// Example usage:
+//
+//   build_test_pack --output_path=/path/to/code_contests_valid.testpack \
+//     /path/to/dataset/code_contests_valid.riegeli
+//
+// Pass --compress to store tests as zstd frames, which makes packs of the
+// training set several times smaller.
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "dataset/shard_reader.h"
+#include "dataset/test_pack.h"
+#include "dataset/test_views.h"
+#include "execution/status_macros.h"
+
+ABSL_FLAG(std::string, output_path, "", "Path to write the test pack to.");
+ABSL_FLAG(bool, compress, false,
+          "Whether to compress tests with a zstd dictionary per problem.");
+ABSL_FLAG(int, compression_level, 9, "zstd compression level.");
+
+namespace deepmind::code_contests {
+namespace {
+
+absl::StatusOr<int> BuildTestPack(const std::vector<std::string>& shards,
+                                  const std::string& output_path,
+                                  const TestPackWriterOptions& options) {
+  ASSIGN_OR_RETURN(TestPackWriter writer,
+                   TestPackWriter::Create(output_path, options));
+  int num_problems = 0;
+  for (const std::string& shard : shards) {
+    // Tests are copied straight from the decompressed records into the pack.
+    RETURN_IF_ERROR(ForEachRecord(
+        shard, ShardReadModeFromFlags(),
+        [&](const absl::string_view record) -> absl::Status {
+          ASSIGN_OR_RETURN(const ProblemTestViews tests,
+                           ParseTestViews(record));
+          ++num_problems;
+          return writer.Add(tests.name, tests);
+        }));
+  }
+  RETURN_IF_ERROR(writer.Close());
+  return num_problems;
+}
+
+}  // namespace
+}  // namespace deepmind::code_contests
+
+int main(int argc, char* argv[]) {
+  const std::vector<char*> args = absl::ParseCommandLine(argc, argv);
+  const std::string output_path = absl::GetFlag(FLAGS_output_path);
+  if (output_path.empty() || args.size() < 2) {
+    std::cerr << "Usage: " << args[0] << " --output_path=<path> <shard>...\n";
+    return 1;
+  }
+  const std::vector<std::string> shards(args.begin() + 1, args.end());
+
+  const deepmind::code_contests::TestPackWriterOptions options{
+      .compress = absl::GetFlag(FLAGS_compress),
+      .compression_level = absl::GetFlag(FLAGS_compression_level)};
+  absl::StatusOr<int> num_problems =
+      deepmind::code_contests::BuildTestPack(shards, output_path, options);
+  if (!num_problems.ok()) {
+    std::cerr << "Failed: " << num_problems.status().message() << std::endl;
+    return 1;
+  }
+  std::cout << "Packed the tests of " << *num_problems << " problems in "
+            << shards.size() << " shards to " << output_path << std::endl;
+}
@@ -0,0 +1,226 @@
+// Copyright 2022 DeepMind Technologies Limited
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "dataset/problem_filter.h"
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "google/protobuf/io/coded_stream.h"
+#include "google/protobuf/wire_format_lite.h"
+#include "absl/algorithm/container.h"
+#include "absl/flags/flag.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "contest_problem.pb.h"
+#include "dataset/projected_problem.h"
+#include "dataset/sharded_problem_reader.h"
+#include "execution/status_macros.h"
+
+ABSL_FLAG(std::vector<std::string>, sources, {},
+          "Only use problems from these sources, e.g. CODEFORCES,ATCODER.");
+ABSL_FLAG(std::vector<std::string>, difficulties, {},
+          "Only use problems with these difficulties, e.g. EASY,A.");
+ABSL_FLAG(int, min_cf_rating, 0,
+          "If positive, only use Codeforces problems rated at least this.");
+ABSL_FLAG(int, max_cf_rating, 0,
+          "If positive, only use Codeforces problems rated at most this.");
+ABSL_FLAG(std::vector<std::string>, cf_tags, {},
+          "Only use problems with all of these tags.");
+ABSL_FLAG(std::vector<std::string>, solution_languages, {},
+          "Only use problems with a correct solution in one of these "
+          "languages, e.g. PYTHON3,CPP.");
+ABSL_FLAG(int, min_tests, 0,
+          "Only use problems with at least this many tests in total.");
+ABSL_FLAG(std::vector<std::string>, problem_names, {},
+          "Only use problems with these names.");
+
+namespace deepmind::code_contests {
+
+namespace {
+
+using ::google::protobuf::internal::WireFormatLite;
+
+// Returns the language of a solution, given its encoded field including the
+// tag. The language is the first field of a solution, so the solution itself
+// is not read.
+std::optional<int> EncodedSolutionLanguage(const absl::string_view field) {
+  google::protobuf::io::CodedInputStream input(
+      reinterpret_cast<const uint8_t*>(field.data()), field.size());
+  uint32_t length;
+  if (input.ReadTag() == 0 || !input.ReadVarint32(&length)) {
+    return std::nullopt;
+  }
+  input.PushLimit(length);
+  for (uint32_t tag; (tag = input.ReadTag()) != 0;) {
+    if (tag == WireFormatLite::MakeTag(
+                   ContestProblem::Solution::kLanguageFieldNumber,
+                   WireFormatLite::WIRETYPE_VARINT)) {
+      uint32_t value;
+      if (!input.ReadVarint32(&value)) return std::nullopt;
+      return value;
+    }
+    if (!WireFormatLite::SkipField(&input, tag)) return std::nullopt;
+  }
+  return ContestProblem::Solution::UNKNOWN_LANGUAGE;
+}
+
+bool HasSolutionIn(
+    const ProjectedProblem& problem,
+    const std::vector<ContestProblem::Solution::Language>& languages) {
+  if (problem.decoded_fields().Contains(
+          ContestProblem::kSolutionsFieldNumber)) {
+    return absl::c_any_of(problem.problem().solutions(),
+                          [&](const ContestProblem::Solution& solution) {
+                            return absl::c_linear_search(languages,
+                                                         solution.language());
+                          });
+  }
+  for (const absl::string_view field :
+       problem.SkippedBytes(ContestProblem::kSolutionsFieldNumber)) {
+    const std::optional<int> language = EncodedSolutionLanguage(field);
+    if (language.has_value() &&
+        absl::c_linear_search(languages, *language)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+int NumTests(const ProjectedProblem& projected) {
+  const ContestProblem& problem = projected.problem();
+  const std::pair<int, int> tiers[] = {
+      {ContestProblem::kPublicTestsFieldNumber, problem.public_tests_size()},
+      {ContestProblem::kPrivateTestsFieldNumber, problem.private_tests_size()},
+      {ContestProblem::kGeneratedTestsFieldNumber,
+       problem.generated_tests_size()}};
+  int num_tests = 0;
+  for (const auto& [field_number, num_decoded] : tiers) {
+    // Tests that were not decoded are counted by their encoded fields, one per
+    // test.
+    num_tests += projected.decoded_fields().Contains(field_number)
+                     ? num_decoded
+                     : projected.SkippedBytes(field_number).size();
+  }
+  return num_tests;
+}
+
+template <typename Enum>
+absl::StatusOr<std::vector<Enum>> ParseEnumNames(
+    const std::vector<std::string>& names,
+    bool (*parse)(const std::string& name, Enum* value),
+    const absl::string_view flag) {
+  std::vector<Enum> values;
+  for (const std::string& name : names) {
+    Enum value;
+    if (!parse(name, &value)) {
+      return absl::InvalidArgumentError(
+          absl::StrCat("Invalid value for --", flag, ": ", name));
+    }
+    values.push_back(value);
+  }
+  return values;
+}
+
+}  // namespace
+
+bool ProblemFilter::MatchesAll() const {
+  return sources.empty() && difficulties.empty() &&
+         !min_cf_rating.has_value() && !max_cf_rating.has_value() &&
+         cf_tags.empty() && solution_languages.empty() && min_tests <= 0 &&
+         names.empty();
+}
+
+ProblemFieldMask ProblemFilter::Fields() const {
+  ProblemFieldMask fields = ProblemFieldMask::NameOnly();
+  if (!sources.empty()) fields.Add(ContestProblem::kSourceFieldNumber);
+  if (!difficulties.empty()) fields.Add(ContestProblem::kDifficultyFieldNumber);
+  if (min_cf_rating.has_value() || max_cf_rating.has_value()) {
+    fields.Add(ContestProblem::kCfRatingFieldNumber);
+  }
+  if (!cf_tags.empty()) fields.Add(ContestProblem::kCfTagsFieldNumber);
+  return fields;
+}
+
+bool ProblemFilter::Matches(const ProjectedProblem& projected) const {
+  const ContestProblem& problem = projected.problem();
+  if (!names.empty() && !names.contains(problem.name())) return false;
+  if (!sources.empty() && !absl::c_linear_search(sources, problem.source())) {
+    return false;
+  }
+  if (!difficulties.empty() &&
+      !absl::c_linear_search(difficulties, problem.difficulty())) {
+    return false;
+  }
+  if (min_cf_rating.has_value() || max_cf_rating.has_value()) {
+    if (!problem.has_cf_rating() ||
+        (min_cf_rating.has_value() && problem.cf_rating() < *min_cf_rating) ||
+        (max_cf_rating.has_value() && problem.cf_rating() > *max_cf_rating)) {
+      return false;
+    }
+  }
+  for (const std::string& tag : cf_tags) {
+    if (!absl::c_linear_search(problem.cf_tags(), tag)) return false;
+  }
+  if (min_tests > 0 && NumTests(projected) < min_tests) return false;
+  if (!solution_languages.empty() &&
+      !HasSolutionIn(projected, solution_languages)) {
+    return false;
+  }
+  return true;
+}
+
+void ProblemFilter::ApplyTo(ShardedProblemReaderOptions& options) const {
+  if (MatchesAll()) return;
+  options.filter = [filter = *this](const ProjectedProblem& problem) {
+    return filter.Matches(problem);
+  };
+  options.filter_fields = Fields();
+}
+
+absl::StatusOr<ProblemFilter> ProblemFilterFromFlags() {
+  ProblemFilter filter;
+  ASSIGN_OR_RETURN(filter.sources,
+                   ParseEnumNames<ContestProblem::Source>(
+                       absl::GetFlag(FLAGS_sources),
+                       &ContestProblem::Source_Parse, "sources"));
+  ASSIGN_OR_RETURN(filter.difficulties,
+                   ParseEnumNames<ContestProblem::Difficulty>(
+                       absl::GetFlag(FLAGS_difficulties),
+                       &ContestProblem::Difficulty_Parse, "difficulties"));
+  ASSIGN_OR_RETURN(filter.solution_languages,
+                   ParseEnumNames<ContestProblem::Solution::Language>(
+                       absl::GetFlag(FLAGS_solution_languages),
+                       &ContestProblem::Solution::Language_Parse,
+                       "solution_languages"));
+  if (const int rating = absl::GetFlag(FLAGS_min_cf_rating); rating > 0) {
+    filter.min_cf_rating = rating;
+  }
+  if (const int rating = absl::GetFlag(FLAGS_max_cf_rating); rating > 0) {
+    filter.max_cf_rating = rating;
+  }
+  filter.cf_tags = absl::GetFlag(FLAGS_cf_tags);
+  filter.min_tests = absl::GetFlag(FLAGS_min_tests);
+  for (const std::string& name : absl::GetFlag(FLAGS_problem_names)) {
+    filter.names.insert(name);
+  }
+  return filter;
+}
+
+}  // namespace deepmind::code_contests
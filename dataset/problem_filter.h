@@ -0,0 +1,79 @@
+// Copyright 2022 DeepMind Technologies Limited
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Selecting problems by their metadata while reading the dataset.
+//
+// A ProblemFilter only needs a few small top-level fields of a record, so
+// ShardedProblemReader decodes just those before applying it, and fully
+// decodes only the problems that match. Tests and solutions are never decoded
+// for filtering: tests are only counted, and solution languages are read
+// straight from the encoded solutions.
+//
+// The flags defined in problem_filter.cc build a filter for command-line tools,
+// e.g. --sources=CODEFORCES --max_cf_rating=1600 --solution_languages=PYTHON3.
+//
+// Example usage:
+//
+//   ASSIGN_OR_RETURN(const ProblemFilter filter, ProblemFilterFromFlags());
+//   ShardedProblemReaderOptions options;
+//   filter.ApplyTo(options);
+//   ShardedProblemReader reader(shards, std::move(options));
+
+#ifndef THIRD_PARTY_DEEPMIND_CODE_CONTESTS_DATASET_PROBLEM_FILTER_H_
+#define THIRD_PARTY_DEEPMIND_CODE_CONTESTS_DATASET_PROBLEM_FILTER_H_
+
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "absl/container/flat_hash_set.h"
+#include "absl/status/statusor.h"
+#include "contest_problem.pb.h"
+#include "dataset/projected_problem.h"
+#include "dataset/sharded_problem_reader.h"
+
+namespace deepmind::code_contests {
+
+// Problems match if they satisfy every condition. Empty lists and unset bounds
+// do not restrict problems.
+struct ProblemFilter {
+  std::vector<ContestProblem::Source> sources;
+  std::vector<ContestProblem::Difficulty> difficulties;
+  // Problems without a cf_rating never match if either bound is set.
+  std::optional<int> min_cf_rating;
+  std::optional<int> max_cf_rating;
+  // Problems must have all of these tags.
+  std::vector<std::string> cf_tags;
+  // Problems must have a correct solution in one of these languages.
+  std::vector<ContestProblem::Solution::Language> solution_languages;
+  // The minimum number of public, private and generated tests together.
+  int min_tests = 0;
+  absl::flat_hash_set<std::string> names;
+
+  // Whether every problem matches.
+  bool MatchesAll() const;
+  // The fields that must be decoded for `Matches`.
+  ProblemFieldMask Fields() const;
+  bool Matches(const ProjectedProblem& problem) const;
+  // Makes a reader return only matching problems. Does nothing if every
+  // problem matches.
+  void ApplyTo(ShardedProblemReaderOptions& options) const;
+};
+
+// Returns the filter given by the command-line flags.
+absl::StatusOr<ProblemFilter> ProblemFilterFromFlags();
+
+}  // namespace deepmind::code_contests
+
+#endif  // THIRD_PARTY_DEEPMIND_CODE_CONTESTS_DATASET_PROBLEM_FILTER_H_
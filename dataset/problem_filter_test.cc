@@ -0,0 +1,122 @@
+// Copyright 2022 DeepMind Technologies Limited
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "dataset/problem_filter.h"
+
+#include <string>
+
+#include "google/protobuf/text_format.h"
+#include "gtest/gtest.h"
+#include "absl/strings/string_view.h"
+#include "contest_problem.pb.h"
+#include "dataset/projected_problem.h"
+#include "dataset/sharded_problem_reader.h"
+
+namespace deepmind::code_contests {
+namespace {
+
+constexpr absl::string_view kTextProtoExample = R"pb(
+  name: "123_X. Adding integers"
+  public_tests: { input: "1 2\n" output: "3" }
+  private_tests: { input: "5 6\n" output: "11" }
+  generated_tests: { input: "9 10\n" output: "19" }
+  generated_tests: { input: "11 12\n" output: "23" }
+  source: CODEFORCES
+  difficulty: B
+  solutions: { language: CPP solution: "int main() {}" }
+  solutions: {
+    language: PYTHON3
+    solution: "print(int(input()) + int(input()))\n"
+  }
+  cf_rating: 1100
+  cf_tags: "math"
+  cf_tags: "implementation"
+  incorrect_solutions: { language: JAVA solution: "class Main {}" }
+)pb";
+
+// Decodes the example with only the fields `filter` needs.
+ProjectedProblem Project(const ProblemFilter& filter) {
+  ContestProblem problem;
+  EXPECT_TRUE(google::protobuf::TextFormat::ParseFromString(
+      std::string(kTextProtoExample), &problem));
+  ProjectedProblem projected;
+  EXPECT_TRUE(
+      projected.Decode(problem.SerializeAsString(), filter.Fields()).ok());
+  return projected;
+}
+
+bool Matches(const ProblemFilter& filter) {
+  const bool matches = filter.Matches(Project(filter));
+  // Filters must not depend on which fields are decoded.
+  ProjectedProblem decoded = Project(filter);
+  EXPECT_TRUE(decoded.MaterializeAll().ok());
+  EXPECT_EQ(filter.Matches(decoded), matches);
+  return matches;
+}
+
+TEST(ProblemFilterTest, MatchesAllByDefault) {
+  const ProblemFilter filter;
+  EXPECT_TRUE(filter.MatchesAll());
+  EXPECT_TRUE(Matches(filter));
+  ShardedProblemReaderOptions options;
+  filter.ApplyTo(options);
+  EXPECT_FALSE(options.filter);
+}
+
+TEST(ProblemFilterTest, FiltersOnMetadata) {
+  EXPECT_TRUE(Matches({.sources = {ContestProblem::ATCODER,
+                                   ContestProblem::CODEFORCES}}));
+  EXPECT_FALSE(Matches({.sources = {ContestProblem::ATCODER}}));
+  EXPECT_TRUE(Matches({.difficulties = {ContestProblem::B}}));
+  EXPECT_FALSE(Matches({.difficulties = {ContestProblem::EASY}}));
+  EXPECT_TRUE(Matches({.min_cf_rating = 1100, .max_cf_rating = 1600}));
+  EXPECT_FALSE(Matches({.max_cf_rating = 1000}));
+  EXPECT_FALSE(Matches({.min_cf_rating = 1200}));
+  EXPECT_TRUE(Matches({.cf_tags = {"implementation", "math"}}));
+  EXPECT_FALSE(Matches({.cf_tags = {"math", "greedy"}}));
+  EXPECT_TRUE(Matches({.names = {"123_X. Adding integers"}}));
+  EXPECT_FALSE(Matches({.names = {"Other"}}));
+}
+
+TEST(ProblemFilterTest, CountsTestsWithoutDecodingThem) {
+  const ProblemFilter filter{.min_tests = 4};
+  EXPECT_EQ(Project(filter).problem().generated_tests_size(), 0);
+  EXPECT_TRUE(Matches(filter));
+  EXPECT_FALSE(Matches({.min_tests = 5}));
+}
+
+TEST(ProblemFilterTest, ChecksSolutionLanguagesWithoutDecodingSolutions) {
+  const ProblemFilter filter{
+      .solution_languages = {ContestProblem::Solution::PYTHON3}};
+  EXPECT_EQ(Project(filter).problem().solutions_size(), 0);
+  EXPECT_TRUE(Matches(filter));
+  // Incorrect solutions do not count.
+  EXPECT_FALSE(Matches(
+      {.solution_languages = {ContestProblem::Solution::JAVA,
+                              ContestProblem::Solution::PYTHON}}));
+}
+
+TEST(ProblemFilterTest, AppliesToReaderOptions) {
+  const ProblemFilter filter{.sources = {ContestProblem::CODEFORCES}};
+  ShardedProblemReaderOptions options;
+  filter.ApplyTo(options);
+  ASSERT_TRUE(options.filter);
+  EXPECT_TRUE(options.filter_fields.Contains(ContestProblem::kSourceFieldNumber));
+  EXPECT_FALSE(
+      options.filter_fields.Contains(ContestProblem::kSolutionsFieldNumber));
+  EXPECT_TRUE(options.filter(Project(filter)));
+}
+
+}  // namespace
+}  // namespace deepmind::code_contests
@@ -0,0 +1,317 @@
+// Copyright 2022 DeepMind Technologies Limited
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "dataset/problem_index.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <string>
+#include <system_error>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_set.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "absl/strings/substitute.h"
+#include "absl/types/span.h"
+#include "contest_problem.pb.h"
+#include "dataset/problem_index.pb.h"
+#include "dataset/projected_problem.h"
+#include "dataset/shard_reader.h"
+#include "dataset/sharded_problem_reader.h"
+#include "execution/status_macros.h"
+#include "riegeli/bytes/fd_reader.h"
+#include "riegeli/bytes/fd_writer.h"
+#include "riegeli/records/record_position.h"
+#include "riegeli/records/record_reader.h"
+#include "riegeli/records/record_writer.h"
+
+namespace deepmind::code_contests {
+
+namespace {
+
+bool SameFingerprint(const IndexedShard& a, const IndexedShard& b) {
+  return a.size_bytes() == b.size_bytes() && a.mtime_nanos() == b.mtime_nanos();
+}
+
+absl::Status ScanShards(
+    std::vector<std::string> shards,
+    const absl::flat_hash_set<std::string>& names,
+    const std::function<absl::Status(const ContestProblem&)>& callback,
+    ShardedProblemReaderOptions reader_options) {
+  if (shards.empty()) return absl::OkStatus();
+  // Only names, and whatever fields the caller's filter needs, are decoded
+  // until a problem is known to match.
+  ProblemFieldMask filter_fields = ProblemFieldMask::NameOnly();
+  if (reader_options.filter) filter_fields.Add(reader_options.filter_fields);
+  reader_options.filter = [&names, filter = std::move(reader_options.filter)](
+                              const ProjectedProblem& problem) {
+    return names.contains(problem.problem().name()) &&
+           (!filter || filter(problem));
+  };
+  reader_options.filter_fields = filter_fields;
+  ShardedProblemReader reader(std::move(shards), std::move(reader_options));
+  // Read in place, so that problems stay on their arenas if there are any.
+  ProjectedProblem problem;
+  while (reader.ReadProblem(problem)) {
+    RETURN_IF_ERROR(callback(problem.problem()));
+  }
+  return reader.Close();
+}
+
+absl::Status SeekInShard(
+    const std::string& shard, std::vector<const IndexedProblem*> locations,
+    const std::function<absl::Status(const ContestProblem&)>& callback,
+    const ShardReadMode read_mode,
+    const std::function<bool(const ProjectedProblem&)>& filter = nullptr) {
+  if (locations.empty()) return absl::OkStatus();
+  // Visit records in file order, so that reads are sequential.
+  std::sort(locations.begin(), locations.end(),
+            [](const IndexedProblem* a, const IndexedProblem* b) {
+              return std::make_pair(a->chunk_begin(), a->record_index()) <
+                     std::make_pair(b->chunk_begin(), b->record_index());
+            });
+  const std::unique_ptr<riegeli::RecordReaderBase> reader =
+      OpenShard(shard, read_mode);
+  std::string record;
+  ProjectedProblem problem;
+  for (const IndexedProblem* location : locations) {
+    if (!reader->Seek(riegeli::RecordPosition(location->chunk_begin(),
+                                              location->record_index())) ||
+        !reader->ReadRecord(record)) {
+      if (!reader->ok()) return reader->status();
+      return absl::DataLossError(absl::StrCat(
+          "Index points past the end of ", shard, " for ", location->name()));
+    }
+    RETURN_IF_ERROR(problem.Decode(std::move(record), ProblemFieldMask::All()));
+    if (problem.problem().name() != location->name()) {
+      return absl::DataLossError(absl::Substitute(
+          "Index entry for \"$0\" in $1 points to \"$2\".", location->name(),
+          shard, problem.problem().name()));
+    }
+    if (filter && !filter(problem)) continue;
+    RETURN_IF_ERROR(callback(problem.problem()));
+  }
+  if (!reader->Close()) return reader->status();
+  return absl::OkStatus();
+}
+
+}  // namespace
+
+absl::StatusOr<IndexedShard> FingerprintShard(absl::string_view path) {
+  struct stat st;
+  const std::string path_string(path);
+  if (stat(path_string.c_str(), &st) != 0) {
+    return absl::NotFoundError(
+        absl::Substitute("Unable to stat $0: errno $1", path, errno));
+  }
+  IndexedShard shard;
+  shard.set_path(path_string);
+  shard.set_size_bytes(st.st_size);
+  shard.set_mtime_nanos(int64_t{st.st_mtim.tv_sec} * 1000000000 +
+                        st.st_mtim.tv_nsec);
+  return shard;
+}
+
+std::string NormalizeShardPath(absl::string_view path) {
+  std::error_code error;
+  const std::filesystem::path normalized =
+      std::filesystem::weakly_canonical(std::filesystem::path(path), error);
+  if (error) return std::string(path);
+  return normalized.string();
+}
+
+ProblemIndex::ProblemIndex(ProblemIndexFile file) : file_(std::move(file)) {
+  shard_is_fresh_.reserve(file_.shards_size());
+  for (int i = 0; i < file_.shards_size(); ++i) {
+    const IndexedShard& shard = file_.shards(i);
+    shard_by_path_[NormalizeShardPath(shard.path())] = i;
+    absl::StatusOr<IndexedShard> on_disk = FingerprintShard(shard.path());
+    shard_is_fresh_.push_back(on_disk.ok() && SameFingerprint(shard, *on_disk));
+  }
+  for (int i = 0; i < file_.problems_size(); ++i) {
+    problems_by_name_[file_.problems(i).name()].push_back(i);
+  }
+}
+
+absl::StatusOr<ProblemIndex> ProblemIndex::Build(
+    absl::Span<const std::string> shards, const ShardReadMode read_mode) {
+  ProblemIndexFile file;
+  for (int shard_index = 0; shard_index < shards.size(); ++shard_index) {
+    const std::string& shard = shards[shard_index];
+    // Paths are stored normalized, so that the index can be used from any
+    // working directory.
+    ASSIGN_OR_RETURN(*file.add_shards(),
+                     FingerprintShard(NormalizeShardPath(shard)));
+    const std::unique_ptr<riegeli::RecordReaderBase> reader =
+        OpenShard(shard, read_mode);
+    ContestProblem problem;
+    while (reader->ReadRecord(problem)) {
+      const riegeli::RecordPosition position = reader->last_pos();
+      IndexedProblem& location = *file.add_problems();
+      location.set_name(problem.name());
+      location.set_source(problem.source());
+      if (problem.has_cf_contest_id()) {
+        location.set_cf_contest_id(problem.cf_contest_id());
+      }
+      if (problem.has_cf_index()) location.set_cf_index(problem.cf_index());
+      location.set_shard(shard_index);
+      location.set_chunk_begin(position.chunk_begin());
+      location.set_record_index(position.record_index());
+    }
+    if (!reader->Close()) return reader->status();
+  }
+  return ProblemIndex(std::move(file));
+}
+
+absl::StatusOr<ProblemIndex> ProblemIndex::Load(absl::string_view index_path) {
+  riegeli::RecordReader<riegeli::FdReader<>> reader(
+      std::forward_as_tuple(index_path));
+  ProblemIndexFile file;
+  if (!reader.ReadRecord(file)) {
+    if (!reader.ok()) return reader.status();
+    return absl::DataLossError(
+        absl::StrCat("Problem index ", index_path, " is empty."));
+  }
+  if (!reader.Close()) return reader.status();
+  return ProblemIndex(std::move(file));
+}
+
+absl::Status ProblemIndex::Save(absl::string_view index_path) const {
+  // Write to a temporary file first, so that concurrent readers never observe
+  // a partially written index.
+  const std::string temp_path = absl::StrCat(index_path, ".tmp");
+  riegeli::RecordWriter<riegeli::FdWriter<>> writer(
+      std::forward_as_tuple(temp_path, O_WRONLY | O_CREAT | O_TRUNC));
+  writer.WriteRecord(file_);
+  if (!writer.Close()) return writer.status();
+  if (rename(temp_path.c_str(), std::string(index_path).c_str()) != 0) {
+    return absl::UnknownError(absl::Substitute("Renaming $0 to $1 failed: $2",
+                                               temp_path, index_path, errno));
+  }
+  return absl::OkStatus();
+}
+
+bool ProblemIndex::IsFresh(absl::string_view shard) const {
+  const int shard_index = ShardIndex(shard);
+  return shard_index >= 0 && shard_is_fresh_[shard_index];
+}
+
+int ProblemIndex::ShardIndex(absl::string_view shard) const {
+  const auto it = shard_by_path_.find(NormalizeShardPath(shard));
+  return it != shard_by_path_.end() ? it->second : -1;
+}
+
+std::vector<const IndexedProblem*> ProblemIndex::Find(
+    absl::string_view name) const {
+  std::vector<const IndexedProblem*> locations;
+  const auto it = problems_by_name_.find(name);
+  if (it == problems_by_name_.end()) return locations;
+  for (const int i : it->second) {
+    locations.push_back(&file_.problems(i));
+  }
+  return locations;
+}
+
+std::vector<const IndexedProblem*> ProblemIndex::ProblemsInShard(
+    absl::string_view shard) const {
+  std::vector<const IndexedProblem*> locations;
+  const int shard_index = ShardIndex(shard);
+  if (shard_index < 0) return locations;
+  for (const IndexedProblem& location : file_.problems()) {
+    if (location.shard() == shard_index) locations.push_back(&location);
+  }
+  return locations;
+}
+
+absl::StatusOr<ContestProblem> ReadIndexedProblem(
+    absl::string_view shard, const IndexedProblem& location,
+    const ShardReadMode read_mode) {
+  std::optional<ContestProblem> result;
+  RETURN_IF_ERROR(SeekInShard(
+      std::string(shard), {&location},
+      [&](const ContestProblem& problem) {
+        result = problem;
+        return absl::OkStatus();
+      },
+      read_mode));
+  return *std::move(result);
+}
+
+absl::Status ForEachNamedProblem(
+    absl::Span<const std::string> shards, absl::string_view index_path,
+    const absl::flat_hash_set<std::string>& names,
+    const std::function<absl::Status(const ContestProblem&)>& callback,
+    ShardedProblemReaderOptions reader_options) {
+  std::optional<ProblemIndex> index;
+  if (!index_path.empty()) {
+    absl::StatusOr<ProblemIndex> loaded = ProblemIndex::Load(index_path);
+    if (loaded.ok()) {
+      index = *std::move(loaded);
+    } else {
+      std::cerr << "Unable to load problem index, scanning all shards: "
+                << loaded.status() << std::endl;
+    }
+  }
+
+  std::vector<std::string> shards_to_scan;
+  for (const std::string& shard : shards) {
+    // Missing shards are skipped, rather than failing after the problems of
+    // other shards were already visited.
+    if (const absl::StatusOr<IndexedShard> on_disk = FingerprintShard(shard);
+        absl::IsNotFound(on_disk.status())) {
+      std::cerr << "Skipping missing shard " << shard << ": "
+                << on_disk.status() << std::endl;
+      continue;
+    }
+    if (!index.has_value() || !index->IsFresh(shard)) {
+      if (index.has_value()) {
+        std::cerr << "Problem index is stale for " << shard
+                  << ", scanning it instead." << std::endl;
+      }
+      shards_to_scan.push_back(shard);
+      continue;
+    }
+    const int shard_index = index->ShardIndex(shard);
+    std::vector<const IndexedProblem*> locations;
+    for (const std::string& name : names) {
+      for (const IndexedProblem* location : index->Find(name)) {
+        if (location->shard() == shard_index) {
+          locations.push_back(location);
+        }
+      }
+    }
+    RETURN_IF_ERROR(SeekInShard(shard, std::move(locations), callback,
+                                reader_options.read_mode,
+                                reader_options.filter));
+  }
+  return ScanShards(std::move(shards_to_scan), names, callback,
+                    std::move(reader_options));
+}
+
+}  // namespace deepmind::code_contests
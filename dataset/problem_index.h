@@ -0,0 +1,117 @@
+// Copyright 2022 DeepMind Technologies Limited
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// An index from problem names to the riegeli records that contain them.
+//
+// Finding a handful of problems in the dataset otherwise requires reading and
+// parsing every record of every shard. The index is built once (see
+// build_problem_index.cc) and stored in a sidecar file. Readers use it to seek
+// straight to the records they need, and fall back to scanning any shard that
+// is not covered by the index or has changed since the index was built.
+
+#ifndef THIRD_PARTY_DEEPMIND_CODE_CONTESTS_DATASET_PROBLEM_INDEX_H_
+#define THIRD_PARTY_DEEPMIND_CODE_CONTESTS_DATASET_PROBLEM_INDEX_H_
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "absl/types/span.h"
+#include "contest_problem.pb.h"
+#include "dataset/problem_index.pb.h"
+#include "dataset/shard_reader.h"
+#include "dataset/sharded_problem_reader.h"
+
+namespace deepmind::code_contests {
+
+// Returns the path, size and modification time of `path`.
+absl::StatusOr<IndexedShard> FingerprintShard(absl::string_view path);
+
+// Returns `path` as an absolute path without symlinks, "." or "..", so that
+// every spelling of a shard's path finds it in an index. Returns `path`
+// unchanged if it cannot be normalized.
+std::string NormalizeShardPath(absl::string_view path);
+
+class ProblemIndex {
+ public:
+  // Builds an index by reading every record of `shards`.
+  static absl::StatusOr<ProblemIndex> Build(
+      absl::Span<const std::string> shards,
+      ShardReadMode read_mode = ShardReadMode::kFd);
+  // Loads an index previously written with `Save`.
+  static absl::StatusOr<ProblemIndex> Load(absl::string_view index_path);
+
+  absl::Status Save(absl::string_view index_path) const;
+
+  // Returns whether `shard` is covered by the index and is unchanged on disk
+  // since the index was built.
+  bool IsFresh(absl::string_view shard) const;
+
+  // Returns the position of `shard` in file().shards(), or -1 if the shard is
+  // not covered by the index.
+  int ShardIndex(absl::string_view shard) const;
+
+  // Returns the locations of all problems called `name`. Note that names could
+  // agree between different sources.
+  std::vector<const IndexedProblem*> Find(absl::string_view name) const;
+
+  // Returns the locations of all problems in `shard`, in record order, or an
+  // empty vector if the shard is not covered by the index.
+  std::vector<const IndexedProblem*> ProblemsInShard(
+      absl::string_view shard) const;
+
+  const std::string& ShardPath(const IndexedProblem& problem) const {
+    return file_.shards(problem.shard()).path();
+  }
+
+  const ProblemIndexFile& file() const { return file_; }
+
+ private:
+  explicit ProblemIndex(ProblemIndexFile file);
+
+  ProblemIndexFile file_;
+  // Keyed by normalized paths.
+  absl::flat_hash_map<std::string, int> shard_by_path_;
+  absl::flat_hash_map<std::string, std::vector<int>> problems_by_name_;
+  std::vector<bool> shard_is_fresh_;
+};
+
+// Reads the record at `location` from `shard`.
+absl::StatusOr<ContestProblem> ReadIndexedProblem(
+    absl::string_view shard, const IndexedProblem& location,
+    ShardReadMode read_mode = ShardReadMode::kFd);
+
+// Calls `callback` for every problem in `shards` whose name is in `names`.
+// The index at `index_path` is used to seek to the matching records of every
+// shard for which it is fresh, visiting those shards first. All other shards,
+// or all shards if `index_path` is empty or cannot be loaded, are then scanned
+// concurrently with a ShardedProblemReader configured by `reader_options`,
+// whose `read_mode` also applies to seeking. If `reader_options.filter` is
+// set, only problems that also pass it are visited. Shards that do not exist
+// are skipped with a warning.
+absl::Status ForEachNamedProblem(
+    absl::Span<const std::string> shards, absl::string_view index_path,
+    const absl::flat_hash_set<std::string>& names,
+    const std::function<absl::Status(const ContestProblem&)>& callback,
+    ShardedProblemReaderOptions reader_options =
+        ShardedProblemReaderOptions());
+
+}  // namespace deepmind::code_contests
+
+#endif  // THIRD_PARTY_DEEPMIND_CODE_CONTESTS_DATASET_PROBLEM_INDEX_H_
@@ -0,0 +1,92 @@
+// Copyright 2022 DeepMind Technologies Limited
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "dataset/problem_index.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "contest_problem.pb.h"
+#include "riegeli/bytes/fd_writer.h"
+#include "riegeli/records/record_writer.h"
+
+namespace deepmind::code_contests {
+namespace {
+
+using ::testing::ElementsAre;
+using ::testing::SizeIs;
+
+std::string WriteShard(const std::string& name) {
+  const std::string path = absl::StrCat(testing::TempDir(), "/", name);
+  riegeli::RecordWriter<riegeli::FdWriter<>> writer(
+      std::forward_as_tuple(path, O_WRONLY | O_CREAT | O_TRUNC));
+  for (const char* problem_name : {"a", "b"}) {
+    ContestProblem problem;
+    problem.set_name(problem_name);
+    EXPECT_TRUE(writer.WriteRecord(problem));
+  }
+  EXPECT_TRUE(writer.Close()) << writer.status();
+  return path;
+}
+
+TEST(ProblemIndexTest, FindsShardsByAnySpellingOfTheirPath) {
+  const std::string shard = WriteShard("indexed.riegeli");
+  const std::string symlink_path =
+      absl::StrCat(testing::TempDir(), "/symlink.riegeli");
+  unlink(symlink_path.c_str());
+  ASSERT_EQ(symlink(shard.c_str(), symlink_path.c_str()), 0);
+
+  absl::StatusOr<ProblemIndex> index = ProblemIndex::Build({shard});
+  ASSERT_TRUE(index.ok()) << index.status();
+  for (const std::string& path :
+       {shard, absl::StrCat(testing::TempDir(), "/./indexed.riegeli"),
+        absl::StrCat(testing::TempDir(), "//indexed.riegeli"), symlink_path}) {
+    EXPECT_TRUE(index->IsFresh(path)) << path;
+    EXPECT_THAT(index->ProblemsInShard(path), SizeIs(2)) << path;
+  }
+  EXPECT_FALSE(index->IsFresh(absl::StrCat(testing::TempDir(), "/other")));
+}
+
+TEST(ProblemIndexTest, SkipsMissingShards) {
+  const std::string shard = WriteShard("present.riegeli");
+  const std::string index_path =
+      absl::StrCat(testing::TempDir(), "/problems.index");
+  absl::StatusOr<ProblemIndex> index = ProblemIndex::Build({shard});
+  ASSERT_TRUE(index.ok()) << index.status();
+  ASSERT_TRUE(index->Save(index_path).ok());
+
+  for (const std::string& path : {index_path, std::string()}) {
+    std::vector<std::string> names;
+    const absl::Status status = ForEachNamedProblem(
+        {absl::StrCat(testing::TempDir(), "/missing.riegeli"), shard}, path,
+        {"b"}, [&](const ContestProblem& problem) {
+          names.push_back(problem.name());
+          return absl::OkStatus();
+        });
+    EXPECT_TRUE(status.ok()) << status;
+    EXPECT_THAT(names, ElementsAre("b"));
+  }
+}
+
+}  // namespace
+}  // namespace deepmind::code_contests
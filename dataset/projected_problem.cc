@@ -0,0 +1,236 @@
+// Copyright 2022 DeepMind Technologies Limited
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "dataset/projected_problem.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "google/protobuf/arena.h"
+#include "google/protobuf/io/coded_stream.h"
+#include "google/protobuf/wire_format_lite.h"
+#include "absl/status/status.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "contest_problem.pb.h"
+#include "execution/status_macros.h"
+
+namespace deepmind::code_contests {
+
+namespace {
+
+using ::google::protobuf::internal::WireFormatLite;
+
+// Parses the fields in `bytes` and merges them into `problem`.
+absl::Status MergeBytes(absl::string_view bytes, ContestProblem& problem) {
+  google::protobuf::io::CodedInputStream input(
+      reinterpret_cast<const uint8_t*>(bytes.data()), bytes.size());
+  if (!problem.MergePartialFromCodedStream(&input)) {
+    return absl::DataLossError("Failed to parse ContestProblem fields.");
+  }
+  return absl::OkStatus();
+}
+
+}  // namespace
+
+ProblemFieldMask::ProblemFieldMask(std::initializer_list<int> field_numbers) {
+  for (const int field_number : field_numbers) {
+    Add(field_number);
+  }
+}
+
+ProblemFieldMask ProblemFieldMask::All() {
+  ProblemFieldMask mask;
+  mask.all_ = true;
+  return mask;
+}
+
+ProblemFieldMask ProblemFieldMask::NameOnly() {
+  return {ContestProblem::kNameFieldNumber};
+}
+
+ProblemFieldMask ProblemFieldMask::NameAndTests() {
+  return {ContestProblem::kNameFieldNumber,
+          ContestProblem::kPublicTestsFieldNumber,
+          ContestProblem::kPrivateTestsFieldNumber,
+          ContestProblem::kGeneratedTestsFieldNumber};
+}
+
+ProblemFieldMask ProblemFieldMask::Metadata() {
+  return {ContestProblem::kNameFieldNumber,
+          ContestProblem::kSourceFieldNumber,
+          ContestProblem::kDifficultyFieldNumber,
+          ContestProblem::kCfContestIdFieldNumber,
+          ContestProblem::kCfIndexFieldNumber,
+          ContestProblem::kCfPointsFieldNumber,
+          ContestProblem::kCfRatingFieldNumber,
+          ContestProblem::kCfTagsFieldNumber,
+          ContestProblem::kIsDescriptionTranslatedFieldNumber,
+          ContestProblem::kTimeLimitFieldNumber,
+          ContestProblem::kMemoryLimitBytesFieldNumber,
+          ContestProblem::kInputFileFieldNumber,
+          ContestProblem::kOutputFileFieldNumber};
+}
+
+bool ProblemFieldMask::Contains(const int field_number) const {
+  if (all_) return true;
+  if (field_number < 0 || field_number > kMaxFieldNumber) return false;
+  return (bits_ >> field_number) & 1;
+}
+
+ProblemFieldMask& ProblemFieldMask::Add(const int field_number) {
+  if (field_number < 0 || field_number > kMaxFieldNumber) {
+    // Such fields can only be represented by the mask of all fields.
+    all_ = true;
+  } else {
+    bits_ |= uint64_t{1} << field_number;
+  }
+  return *this;
+}
+
+ProblemFieldMask& ProblemFieldMask::Add(const ProblemFieldMask& other) {
+  all_ |= other.all_;
+  bits_ |= other.bits_;
+  return *this;
+}
+
+ProjectedProblem::ProjectedProblem(
+    std::shared_ptr<google::protobuf::Arena> arena)
+    : arena_(std::move(arena)),
+      problem_(google::protobuf::Arena::CreateMessage<ContestProblem>(
+          arena_.get())) {}
+
+ProjectedProblem::~ProjectedProblem() {
+  if (arena_ == nullptr) {
+    delete problem_;
+  }
+}
+
+ProjectedProblem::ProjectedProblem(ProjectedProblem&& other)
+    : record_(std::move(other.record_)),
+      arena_(std::move(other.arena_)),
+      problem_(std::exchange(other.problem_, nullptr)),
+      decoded_fields_(other.decoded_fields_),
+      skipped_(std::move(other.skipped_)) {}
+
+ProjectedProblem& ProjectedProblem::operator=(ProjectedProblem&& other) {
+  // Our previous problem is released by `other`'s destructor.
+  std::swap(record_, other.record_);
+  std::swap(arena_, other.arena_);
+  std::swap(problem_, other.problem_);
+  std::swap(decoded_fields_, other.decoded_fields_);
+  std::swap(skipped_, other.skipped_);
+  return *this;
+}
+
+absl::Status ProjectedProblem::Decode(std::string record,
+                                      const ProblemFieldMask& fields) {
+  record_ = std::move(record);
+  problem_->Clear();
+  skipped_.clear();
+  decoded_fields_ = fields;
+  if (fields.IsAll()) {
+    // Nothing will be skipped, so there is no need to keep the record.
+    RETURN_IF_ERROR(MergeBytes(record_, *problem_));
+    record_.clear();
+    return absl::OkStatus();
+  }
+
+  // Adjacent fields that we decode are merged in one go.
+  std::vector<std::pair<size_t, size_t>> decoded_ranges;
+  RETURN_IF_ERROR(internal::ForEachWireField(
+      record_, [&](const int field_number, const size_t begin,
+                   const size_t end) {
+        if (!fields.Contains(field_number)) {
+          skipped_.push_back({field_number, begin, end});
+        } else if (!decoded_ranges.empty() &&
+                   decoded_ranges.back().second == begin) {
+          decoded_ranges.back().second = end;
+        } else {
+          decoded_ranges.emplace_back(begin, end);
+        }
+      }));
+  const absl::string_view record_view = record_;
+  for (const auto& [begin, end] : decoded_ranges) {
+    RETURN_IF_ERROR(
+        MergeBytes(record_view.substr(begin, end - begin), *problem_));
+  }
+  return absl::OkStatus();
+}
+
+absl::Status ProjectedProblem::Materialize(const ProblemFieldMask& fields) {
+  const absl::string_view record_view = record_;
+  std::vector<FieldRange> still_skipped;
+  for (const FieldRange& range : skipped_) {
+    if (fields.Contains(range.field_number)) {
+      RETURN_IF_ERROR(MergeBytes(
+          record_view.substr(range.begin, range.end - range.begin), *problem_));
+    } else {
+      still_skipped.push_back(range);
+    }
+  }
+  skipped_ = std::move(still_skipped);
+  decoded_fields_.Add(fields);
+  if (skipped_.empty()) {
+    record_.clear();
+  }
+  return absl::OkStatus();
+}
+
+std::vector<absl::string_view> ProjectedProblem::SkippedBytes(
+    const int field_number) const {
+  const absl::string_view record_view = record_;
+  std::vector<absl::string_view> bytes;
+  for (const FieldRange& range : skipped_) {
+    if (range.field_number == field_number) {
+      bytes.push_back(record_view.substr(range.begin, range.end - range.begin));
+    }
+  }
+  return bytes;
+}
+
+namespace internal {
+
+absl::Status ForEachWireField(
+    absl::string_view bytes,
+    const std::function<void(int field_number, size_t begin, size_t end)>&
+        fn) {
+  google::protobuf::io::CodedInputStream input(
+      reinterpret_cast<const uint8_t*>(bytes.data()), bytes.size());
+  for (;;) {
+    const size_t begin = input.CurrentPosition();
+    const uint32_t tag = input.ReadTag();
+    if (tag == 0) {
+      if (begin == bytes.size()) break;
+      return absl::DataLossError(
+          absl::StrCat("Invalid tag at byte ", begin, " of message."));
+    }
+    if (!WireFormatLite::SkipField(&input, tag)) {
+      return absl::DataLossError(
+          absl::StrCat("Truncated field at byte ", begin, " of message."));
+    }
+    fn(WireFormatLite::GetTagFieldNumber(tag), begin, input.CurrentPosition());
+  }
+  return absl::OkStatus();
+}
+
+}  // namespace internal
+
+}  // namespace deepmind::code_contests
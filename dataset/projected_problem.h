@@ -0,0 +1,159 @@
+// Copyright 2022 DeepMind Technologies Limited
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Decoding of selected ContestProblem fields.
+//
+// Most of the bytes of a ContestProblem record are in its tests and solutions,
+// which tools that only filter problems (e.g. by name) never look at. A
+// ProjectedProblem parses only the top-level fields in a ProblemFieldMask and
+// keeps the others as unparsed byte ranges of the record, which can be parsed
+// later if they turn out to be needed.
+//
+// Example usage:
+//
+//   ProjectedProblem projected;
+//   RETURN_IF_ERROR(projected.Decode(std::move(record),
+//                                    ProblemFieldMask::NameOnly()));
+//   if (projected.problem().name() == wanted) {
+//     RETURN_IF_ERROR(projected.MaterializeAll());
+//     ...
+//   }
+
+#ifndef THIRD_PARTY_DEEPMIND_CODE_CONTESTS_DATASET_PROJECTED_PROBLEM_H_
+#define THIRD_PARTY_DEEPMIND_CODE_CONTESTS_DATASET_PROJECTED_PROBLEM_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "google/protobuf/arena.h"
+#include "absl/status/status.h"
+#include "absl/strings/string_view.h"
+#include "contest_problem.pb.h"
+
+namespace deepmind::code_contests {
+
+// A set of top-level ContestProblem fields, identified by field number.
+class ProblemFieldMask {
+ public:
+  // The empty mask.
+  ProblemFieldMask() = default;
+  ProblemFieldMask(std::initializer_list<int> field_numbers);
+
+  // Every field, including any unknown to this version of the proto.
+  static ProblemFieldMask All();
+  // Just the name.
+  static ProblemFieldMask NameOnly();
+  // The name and all public, private and generated tests.
+  static ProblemFieldMask NameAndTests();
+  // Every field except tests, solutions and descriptions, i.e. the cheap
+  // scalar fields that identify and classify a problem.
+  static ProblemFieldMask Metadata();
+
+  bool Contains(int field_number) const;
+  bool IsAll() const { return all_; }
+  bool IsEmpty() const { return !all_ && bits_ == 0; }
+
+  ProblemFieldMask& Add(int field_number);
+  ProblemFieldMask& Add(const ProblemFieldMask& other);
+
+  bool operator==(const ProblemFieldMask& other) const {
+    return all_ == other.all_ && bits_ == other.bits_;
+  }
+  bool operator!=(const ProblemFieldMask& other) const {
+    return !(*this == other);
+  }
+
+ private:
+  static constexpr int kMaxFieldNumber = 63;
+
+  bool all_ = false;
+  uint64_t bits_ = 0;
+};
+
+// A ContestProblem of which only some fields have been parsed.
+class ProjectedProblem {
+ public:
+  // If `arena` is not null, the problem is allocated on it, and the arena is
+  // kept alive for as long as this object (or any object it is moved to) is.
+  explicit ProjectedProblem(
+      std::shared_ptr<google::protobuf::Arena> arena = nullptr);
+  ~ProjectedProblem();
+
+  // Moving transfers ownership of the problem, and of the reference to its
+  // arena, without copying. A moved-from object may only be destroyed or
+  // assigned to.
+  ProjectedProblem(ProjectedProblem&& other);
+  ProjectedProblem& operator=(ProjectedProblem&& other);
+
+  // Parses the fields of `record` (a serialized ContestProblem) that are in
+  // `fields`, replacing any previous contents. The record is retained so that
+  // the other fields can be parsed later.
+  absl::Status Decode(std::string record, const ProblemFieldMask& fields);
+
+  // Parses the previously skipped fields in `fields` and merges them into
+  // `problem()`.
+  absl::Status Materialize(const ProblemFieldMask& fields);
+  absl::Status MaterializeAll() { return Materialize(ProblemFieldMask::All()); }
+
+  // The parsed fields. Fields that have not been materialized are unset.
+  const ContestProblem& problem() const { return *problem_; }
+  ContestProblem& mutable_problem() { return *problem_; }
+
+  // The arena the problem is allocated on, or null if it is on the heap.
+  google::protobuf::Arena* arena() const { return arena_.get(); }
+
+  // The fields that have been parsed so far.
+  const ProblemFieldMask& decoded_fields() const { return decoded_fields_; }
+
+  // Returns the serialized bytes of every occurrence of `field_number` that has
+  // not been parsed yet, including tags. The views are valid until the next
+  // call to Decode.
+  std::vector<absl::string_view> SkippedBytes(int field_number) const;
+
+ private:
+  struct FieldRange {
+    int field_number;
+    size_t begin;
+    size_t end;
+  };
+
+  std::string record_;
+  std::shared_ptr<google::protobuf::Arena> arena_;
+  // Owned by arena_, or by this object if arena_ is null.
+  ContestProblem* problem_;
+  ProblemFieldMask decoded_fields_;
+  // Byte ranges of record_ holding fields that have not been parsed yet, in
+  // record order.
+  std::vector<FieldRange> skipped_;
+};
+
+namespace internal {
+
+// Calls `fn` with the field number and the byte range (including the tag) of
+// every top-level field of the serialized message `bytes`, in order. Returns
+// an error if the message is malformed.
+absl::Status ForEachWireField(
+    absl::string_view bytes,
+    const std::function<void(int field_number, size_t begin, size_t end)>& fn);
+
+}  // namespace internal
+
+}  // namespace deepmind::code_contests
+
+#endif  // THIRD_PARTY_DEEPMIND_CODE_CONTESTS_DATASET_PROJECTED_PROBLEM_H_
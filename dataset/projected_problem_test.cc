@@ -0,0 +1,161 @@
+// Copyright 2022 DeepMind Technologies Limited
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "dataset/projected_problem.h"
+
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "google/protobuf/arena.h"
+#include "google/protobuf/text_format.h"
+#include "google/protobuf/util/message_differencer.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/strings/string_view.h"
+#include "contest_problem.pb.h"
+
+namespace deepmind::code_contests {
+namespace {
+
+using ::google::protobuf::util::MessageDifferencer;
+
+constexpr absl::string_view kTextProtoExample = R"pb(
+  name: "123_X. Adding integers"
+  description: "Add integers together to get a sum."
+  public_tests: { input: "1 2\n" output: "3" }
+  private_tests: { input: "5 6\n" output: "11" }
+  generated_tests: { input: "9 10\n" output: "19" }
+  generated_tests: { input: "11 12\n" output: "23" }
+  source: CODEFORCES
+  solutions: {
+    language: PYTHON3
+    solution: "print(int(input()) + int(input()))\n"
+  }
+  cf_contest_id: 123
+  cf_index: "X"
+  cf_rating: 1100
+  cf_tags: "math"
+  cf_tags: "implementation"
+  incorrect_solutions: {
+    language: PYTHON3
+    solution: "print(int(input()) - int(input()))\n"
+  }
+)pb";
+
+ContestProblem ExampleProblem() {
+  ContestProblem problem;
+  EXPECT_TRUE(google::protobuf::TextFormat::ParseFromString(
+      std::string(kTextProtoExample), &problem));
+  return problem;
+}
+
+TEST(ProblemFieldMaskTest, ContainsAddedFields) {
+  ProblemFieldMask mask = ProblemFieldMask::NameOnly();
+  EXPECT_TRUE(mask.Contains(ContestProblem::kNameFieldNumber));
+  EXPECT_FALSE(mask.Contains(ContestProblem::kSourceFieldNumber));
+  mask.Add(ContestProblem::kSourceFieldNumber);
+  EXPECT_TRUE(mask.Contains(ContestProblem::kSourceFieldNumber));
+  EXPECT_TRUE(ProblemFieldMask::All().Contains(1000));
+  EXPECT_TRUE(ProblemFieldMask().IsEmpty());
+}
+
+TEST(ProjectedProblemTest, DecodesAllFields) {
+  const ContestProblem example = ExampleProblem();
+  ProjectedProblem projected;
+  ASSERT_TRUE(projected
+                  .Decode(example.SerializeAsString(), ProblemFieldMask::All())
+                  .ok());
+  EXPECT_TRUE(MessageDifferencer::Equals(projected.problem(), example));
+}
+
+TEST(ProjectedProblemTest, DecodesOnlyName) {
+  const ContestProblem example = ExampleProblem();
+  ProjectedProblem projected;
+  ASSERT_TRUE(
+      projected
+          .Decode(example.SerializeAsString(), ProblemFieldMask::NameOnly())
+          .ok());
+  ContestProblem expected;
+  expected.set_name(example.name());
+  EXPECT_TRUE(MessageDifferencer::Equals(projected.problem(), expected));
+  EXPECT_EQ(projected.SkippedBytes(ContestProblem::kGeneratedTestsFieldNumber)
+                .size(),
+            2);
+}
+
+TEST(ProjectedProblemTest, DecodesTests) {
+  const ContestProblem example = ExampleProblem();
+  ProjectedProblem projected;
+  ASSERT_TRUE(
+      projected
+          .Decode(example.SerializeAsString(), ProblemFieldMask::NameAndTests())
+          .ok());
+  EXPECT_EQ(projected.problem().generated_tests_size(), 2);
+  EXPECT_EQ(projected.problem().generated_tests(1).input(), "11 12\n");
+  EXPECT_EQ(projected.problem().solutions_size(), 0);
+  EXPECT_FALSE(projected.problem().has_cf_rating());
+}
+
+TEST(ProjectedProblemTest, MaterializesSkippedFields) {
+  const ContestProblem example = ExampleProblem();
+  ProjectedProblem projected;
+  ASSERT_TRUE(
+      projected
+          .Decode(example.SerializeAsString(), ProblemFieldMask::NameOnly())
+          .ok());
+  ASSERT_TRUE(projected.Materialize(ProblemFieldMask::Metadata()).ok());
+  EXPECT_EQ(projected.problem().cf_rating(), 1100);
+  EXPECT_THAT(projected.problem().cf_tags(),
+              testing::ElementsAre("math", "implementation"));
+  EXPECT_EQ(projected.problem().solutions_size(), 0);
+  ASSERT_TRUE(projected.MaterializeAll().ok());
+  EXPECT_TRUE(MessageDifferencer::Equals(projected.problem(), example));
+  EXPECT_TRUE(projected.decoded_fields().IsAll());
+}
+
+TEST(ProjectedProblemTest, DecodesOntoArena) {
+  const ContestProblem example = ExampleProblem();
+  auto arena = std::make_shared<google::protobuf::Arena>();
+  ProjectedProblem projected(arena);
+  ASSERT_TRUE(projected
+                  .Decode(example.SerializeAsString(), ProblemFieldMask::All())
+                  .ok());
+  EXPECT_EQ(projected.problem().GetArena(), arena.get());
+  EXPECT_TRUE(MessageDifferencer::Equals(projected.problem(), example));
+}
+
+TEST(ProjectedProblemTest, MoveKeepsArenaAlive) {
+  const ContestProblem example = ExampleProblem();
+  ProjectedProblem heap_problem;
+  {
+    ProjectedProblem projected(std::make_shared<google::protobuf::Arena>());
+    ASSERT_TRUE(
+        projected
+            .Decode(example.SerializeAsString(), ProblemFieldMask::All())
+            .ok());
+    heap_problem = std::move(projected);
+  }
+  ASSERT_NE(heap_problem.arena(), nullptr);
+  EXPECT_TRUE(MessageDifferencer::Equals(heap_problem.problem(), example));
+}
+
+TEST(ProjectedProblemTest, RejectsMalformedRecord) {
+  ProjectedProblem projected;
+  EXPECT_FALSE(
+      projected.Decode("\x0a\x10truncated", ProblemFieldMask::NameOnly()).ok());
+}
+
+}  // namespace
+}  // namespace deepmind::code_contests
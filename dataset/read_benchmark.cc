@@ -0,0 +1,180 @@
+// Copyright 2022 DeepMind Technologies Limited
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Measures how fast ContestProblems can be read from the dataset, and how many
+// heap allocations parsing them takes, with and without protobuf arenas.
+//
+// Three ways of reading every field of every record are compared:
+//   heap_reuse: one thread parsing into a single reused ContestProblem, as the
+//     tools in the root package used to do;
+//   heap: a ShardedProblemReader parsing onto the heap;
+//   arena: a ShardedProblemReader parsing onto pooled arenas.
+// In addition, test_views finds just the tests of every record in place, with
+// no parsing or copying.
+//
+// Shards are read as set by --shard_read_mode.
+//
+// Example usage:
+//
+//   read_benchmark --shard_read_mode=mmap \
+//     /path/to/dataset/code_contests_valid.riegeli
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "absl/status/status.h"
+#include "absl/strings/str_format.h"
+#include "absl/strings/string_view.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "contest_problem.pb.h"
+#include "dataset/projected_problem.h"
+#include "dataset/shard_reader.h"
+#include "dataset/sharded_problem_reader.h"
+#include "dataset/test_views.h"
+#include "execution/status_macros.h"
+#include "riegeli/records/record_reader.h"
+
+ABSL_FLAG(int, reader_threads, 1, "Number of shards to read concurrently.");
+ABSL_FLAG(int, arena_batch_size, 64,
+          "Number of records parsed onto each arena in the arena benchmark.");
+ABSL_FLAG(int, repetitions, 3, "Number of times to read the shards.");
+
+namespace {
+
+std::atomic<int64_t> num_allocations{0};
+
+}  // namespace
+
+// Count every heap allocation made through operator new, which is what both
+// protobuf and std::string use.
+void* operator new(const size_t size) {
+  num_allocations.fetch_add(1, std::memory_order_relaxed);
+  if (void* ptr = std::malloc(size == 0 ? 1 : size)) return ptr;
+  throw std::bad_alloc();
+}
+void* operator new[](const size_t size) { return ::operator new(size); }
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+void operator delete[](void* ptr) noexcept { std::free(ptr); }
+void operator delete(void* ptr, size_t) noexcept { std::free(ptr); }
+void operator delete[](void* ptr, size_t) noexcept { std::free(ptr); }
+
+namespace {
+
+using ::deepmind::code_contests::ContestProblem;
+using ::deepmind::code_contests::ForEachRecord;
+using ::deepmind::code_contests::OpenShard;
+using ::deepmind::code_contests::ParseTestViews;
+using ::deepmind::code_contests::ProjectedProblem;
+using ::deepmind::code_contests::ShardedProblemReader;
+using ::deepmind::code_contests::ShardedProblemReaderOptions;
+using ::deepmind::code_contests::ShardReadModeFromFlags;
+
+absl::Status ReadWithReusedProblem(const std::vector<std::string>& shards,
+                                   int64_t& num_records) {
+  ContestProblem problem;
+  for (const std::string& shard : shards) {
+    const std::unique_ptr<riegeli::RecordReaderBase> reader =
+        OpenShard(shard, ShardReadModeFromFlags());
+    while (reader->ReadRecord(problem)) {
+      ++num_records;
+    }
+    if (!reader->Close()) return reader->status();
+  }
+  return absl::OkStatus();
+}
+
+absl::Status ReadTestViews(const std::vector<std::string>& shards,
+                           int64_t& num_records) {
+  for (const std::string& shard : shards) {
+    RETURN_IF_ERROR(ForEachRecord(
+        shard, ShardReadModeFromFlags(),
+        [&](const absl::string_view record) -> absl::Status {
+          RETURN_IF_ERROR(ParseTestViews(record).status());
+          ++num_records;
+          return absl::OkStatus();
+        }));
+  }
+  return absl::OkStatus();
+}
+
+absl::Status ReadWithShardedReader(const std::vector<std::string>& shards,
+                                   const int arena_batch_size,
+                                   int64_t& num_records) {
+  ShardedProblemReaderOptions options;
+  options.num_threads = absl::GetFlag(FLAGS_reader_threads);
+  options.arena_batch_size = arena_batch_size;
+  options.read_mode = ShardReadModeFromFlags();
+  ShardedProblemReader reader(shards, options);
+  ProjectedProblem problem;
+  while (reader.ReadProblem(problem)) {
+    ++num_records;
+  }
+  return reader.Close();
+}
+
+template <typename ReadFn>
+void Benchmark(const absl::string_view name, const ReadFn& read) {
+  for (int i = 0; i < absl::GetFlag(FLAGS_repetitions); ++i) {
+    int64_t num_records = 0;
+    const int64_t allocations_before = num_allocations.load();
+    const absl::Time start = absl::Now();
+    const absl::Status status = read(num_records);
+    const double seconds = absl::ToDoubleSeconds(absl::Now() - start);
+    const int64_t allocations = num_allocations.load() - allocations_before;
+    if (!status.ok()) {
+      std::cerr << name << " failed: " << status << std::endl;
+      return;
+    }
+    const double per_record = num_records == 0 ? 1 : num_records;
+    std::cout << absl::StrFormat(
+        "%-10s %8d records %8.3fs %10.1f records/s %12.1f allocations/record\n",
+        name, num_records, seconds, num_records / seconds,
+        allocations / per_record);
+  }
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  const std::vector<char*> args = absl::ParseCommandLine(argc, argv);
+  if (args.size() < 2) {
+    std::cerr << "Usage: " << args[0] << " <shard>...\n";
+    return 1;
+  }
+  const std::vector<std::string> shards(args.begin() + 1, args.end());
+
+  Benchmark("heap_reuse", [&](int64_t& num_records) {
+    return ReadWithReusedProblem(shards, num_records);
+  });
+  Benchmark("heap", [&](int64_t& num_records) {
+    return ReadWithShardedReader(shards, /*arena_batch_size=*/0, num_records);
+  });
+  Benchmark("arena", [&](int64_t& num_records) {
+    return ReadWithShardedReader(
+        shards, absl::GetFlag(FLAGS_arena_batch_size), num_records);
+  });
+  Benchmark("test_views", [&](int64_t& num_records) {
+    return ReadTestViews(shards, num_records);
+  });
+}
@@ -0,0 +1,222 @@
+// Copyright 2022 DeepMind Technologies Limited
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "dataset/reshard.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <numeric>
+#include <queue>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "absl/cleanup/cleanup.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_format.h"
+#include "absl/strings/str_split.h"
+#include "absl/strings/string_view.h"
+#include "absl/strings/substitute.h"
+#include "absl/types/span.h"
+#include "dataset/shard_reader.h"
+#include "dataset/test_views.h"
+#include "execution/status_macros.h"
+#include "riegeli/bytes/fd_writer.h"
+#include "riegeli/records/record_writer.h"
+
+namespace deepmind::code_contests {
+
+double EstimateEvaluationCost(const ProblemTestViews& tests) {
+  double bytes = 0;
+  int num_tests = 0;
+  for (const std::vector<TestView>* tier :
+       {&tests.public_tests, &tests.private_tests, &tests.generated_tests}) {
+    for (const TestView& test : *tier) {
+      bytes += test.input.size() + test.output.size();
+      ++num_tests;
+    }
+  }
+  // Even problems without tests take some time to read.
+  return std::max(1.0, bytes * num_tests);
+}
+
+std::vector<int> BalanceShards(absl::Span<const double> costs,
+                               const int num_shards) {
+  std::vector<int> order(costs.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(),
+                   [&](const int a, const int b) { return costs[a] > costs[b]; });
+  // The total cost and index of every shard, cheapest first.
+  std::priority_queue<std::pair<double, int>,
+                      std::vector<std::pair<double, int>>, std::greater<>>
+      shards;
+  for (int shard = 0; shard < num_shards; ++shard) {
+    shards.push({0, shard});
+  }
+  std::vector<int> assignment(costs.size());
+  for (const int item : order) {
+    const auto [cost, shard] = shards.top();
+    shards.pop();
+    assignment[item] = shard;
+    shards.push({cost + costs[item], shard});
+  }
+  return assignment;
+}
+
+absl::StatusOr<absl::flat_hash_map<std::string, double>> LoadRuntimeWeights(
+    const absl::string_view path) {
+  std::ifstream file{std::string(path)};
+  if (!file) {
+    return absl::NotFoundError(absl::StrCat("Unable to open ", path));
+  }
+  absl::flat_hash_map<std::string, double> weights;
+  std::string line;
+  for (int line_number = 1; std::getline(file, line); ++line_number) {
+    if (line.empty()) continue;
+    const std::vector<absl::string_view> fields = absl::StrSplit(line, '\t');
+    double weight;
+    if (fields.size() != 2 || !absl::SimpleAtod(fields[1], &weight) ||
+        weight < 0) {
+      return absl::InvalidArgumentError(absl::Substitute(
+          "Invalid runtime weight on line $0 of $1", line_number, path));
+    }
+    weights[fields[0]] = weight;
+  }
+  return weights;
+}
+
+std::string ShardPath(const absl::string_view prefix, const int shard,
+                      const int num_shards) {
+  return absl::StrFormat("%s-%05d-of-%05d", prefix, shard, num_shards);
+}
+
+absl::StatusOr<ReshardStats> Reshard(absl::Span<const std::string> shards,
+                                     const absl::string_view output_prefix,
+                                     const ReshardOptions& options) {
+  if (options.num_shards <= 0) {
+    return absl::InvalidArgumentError(
+        absl::StrCat("Invalid number of shards: ", options.num_shards));
+  }
+  riegeli::RecordWriterBase::Options writer_options;
+  RETURN_IF_ERROR(writer_options.FromString(options.record_writer_options));
+  double default_weight = 1;
+  if (!options.runtime_weights.empty()) {
+    double total_weight = 0;
+    for (const auto& [name, weight] : options.runtime_weights) {
+      total_weight += weight;
+    }
+    default_weight = total_weight / options.runtime_weights.size();
+  }
+
+  // First, estimate the cost of every problem.
+  ReshardStats stats;
+  std::vector<std::string> names;
+  std::vector<double> costs;
+  for (const std::string& shard : shards) {
+    double shard_cost = 0;
+    RETURN_IF_ERROR(ForEachRecord(
+        shard, options.read_mode,
+        [&](const absl::string_view record) -> absl::Status {
+          ASSIGN_OR_RETURN(const ProblemTestViews tests,
+                           ParseTestViews(record));
+          const auto it = options.runtime_weights.find(tests.name);
+          const double cost =
+              EstimateEvaluationCost(tests) *
+              (it == options.runtime_weights.end() ? default_weight
+                                                   : it->second);
+          names.push_back(std::string(tests.name));
+          costs.push_back(cost);
+          shard_cost += cost;
+          return absl::OkStatus();
+        }));
+    stats.input_costs.push_back(shard_cost);
+  }
+  stats.num_problems = costs.size();
+  const std::vector<int> assignment = BalanceShards(costs, options.num_shards);
+  stats.output_costs.assign(options.num_shards, 0);
+  for (int i = 0; i < assignment.size(); ++i) {
+    stats.output_costs[assignment[i]] += costs[i];
+  }
+
+  // Then copy every record unchanged into its new shard. Shards are written to
+  // temporary files first, so that a failed run does not leave behind a
+  // partial dataset that looks complete.
+  std::vector<std::string> temp_paths;
+  // Declared before the writers, so that they are closed before their files
+  // are removed.
+  absl::Cleanup remove_temp_paths = [&temp_paths] {
+    for (const std::string& temp_path : temp_paths) {
+      unlink(temp_path.c_str());
+    }
+  };
+  std::vector<std::unique_ptr<riegeli::RecordWriter<riegeli::FdWriter<>>>>
+      writers;
+  for (int shard = 0; shard < options.num_shards; ++shard) {
+    temp_paths.push_back(absl::StrCat(
+        ShardPath(output_prefix, shard, options.num_shards), ".tmp"));
+    writers.push_back(
+        std::make_unique<riegeli::RecordWriter<riegeli::FdWriter<>>>(
+            std::forward_as_tuple(temp_paths.back(),
+                                  O_WRONLY | O_CREAT | O_TRUNC),
+            writer_options));
+  }
+  size_t problem = 0;
+  for (const std::string& shard : shards) {
+    RETURN_IF_ERROR(ForEachRecord(
+        shard, options.read_mode,
+        [&](const absl::string_view record) -> absl::Status {
+          ASSIGN_OR_RETURN(const ProblemTestViews tests,
+                           ParseTestViews(record));
+          if (problem >= names.size() || tests.name != names[problem]) {
+            return absl::DataLossError(
+                absl::StrCat(shard, " changed while resharding."));
+          }
+          riegeli::RecordWriterBase& writer = *writers[assignment[problem++]];
+          if (!writer.WriteRecord(record)) return writer.status();
+          return absl::OkStatus();
+        }));
+  }
+  if (problem != names.size()) {
+    return absl::DataLossError("Input shards changed while resharding.");
+  }
+  for (const auto& writer : writers) {
+    if (!writer->Close()) return writer->status();
+  }
+  for (int shard = 0; shard < options.num_shards; ++shard) {
+    const std::string path =
+        ShardPath(output_prefix, shard, options.num_shards);
+    if (rename(temp_paths[shard].c_str(), path.c_str()) != 0) {
+      return absl::UnknownError(
+          absl::Substitute("Renaming $0 to $1 failed: errno $2",
+                           temp_paths[shard], path, errno));
+    }
+  }
+  std::move(remove_temp_paths).Cancel();
+  return stats;
+}
+
+}  // namespace deepmind::code_contests
@@ -0,0 +1,92 @@
+// Copyright 2022 DeepMind Technologies Limited
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Rewriting dataset shards so that they take about equally long to evaluate.
+//
+// The released shards hold about the same number of problems each, but
+// evaluating solutions to a problem takes roughly as long as running all of
+// its tests, and some problems have thousands of large generated tests. When
+// every worker evaluates one shard, the slowest shard sets the wall time.
+//
+// Resharding reads the tests of every problem to estimate its cost, assigns
+// problems to shards greedily, most expensive first, and then copies every
+// record unchanged into its new shard. Readers of the dataset see the same
+// ContestProblem records, just grouped differently.
+//
+// Example usage:
+//
+//   ASSIGN_OR_RETURN(ReshardStats stats,
+//                    Reshard(shards, "/path/to/balanced_train.riegeli",
+//                            ReshardOptions{.num_shards = 128}));
+
+#ifndef THIRD_PARTY_DEEPMIND_CODE_CONTESTS_DATASET_RESHARD_H_
+#define THIRD_PARTY_DEEPMIND_CODE_CONTESTS_DATASET_RESHARD_H_
+
+#include <string>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "absl/types/span.h"
+#include "dataset/shard_reader.h"
+#include "dataset/test_views.h"
+
+namespace deepmind::code_contests {
+
+struct ReshardOptions {
+  int num_shards = 128;
+  // Relative runtimes of problems, by name, e.g. measured in a previous
+  // evaluation. Estimated costs are multiplied by them. Problems without one
+  // get the mean of all runtimes.
+  absl::flat_hash_map<std::string, double> runtime_weights;
+  ShardReadMode read_mode = ShardReadMode::kFd;
+  // Options for writing the new shards, in riegeli's RecordWriter options
+  // syntax, e.g. "transpose,zstd".
+  std::string record_writer_options;
+};
+
+struct ReshardStats {
+  int num_problems = 0;
+  // The estimated cost of every input and output shard.
+  std::vector<double> input_costs;
+  std::vector<double> output_costs;
+};
+
+// Estimates the cost of evaluating a solution to a problem with `tests`, as
+// the total size of all its tests times their number.
+double EstimateEvaluationCost(const ProblemTestViews& tests);
+
+// Returns the shard of every item, so that the total costs of the shards are
+// nearly equal.
+std::vector<int> BalanceShards(absl::Span<const double> costs, int num_shards);
+
+// Reads runtime weights from a file with a problem name, a tab and a weight on
+// every line.
+absl::StatusOr<absl::flat_hash_map<std::string, double>> LoadRuntimeWeights(
+    absl::string_view path);
+
+// Returns the path of one of `num_shards` shards, following the naming of the
+// released dataset, e.g. "code_contests_train.riegeli-00003-of-00128".
+std::string ShardPath(absl::string_view prefix, int shard, int num_shards);
+
+// Writes the problems of `shards` to `options.num_shards` new shards at
+// `output_prefix`, balancing their estimated costs.
+absl::StatusOr<ReshardStats> Reshard(absl::Span<const std::string> shards,
+                                     absl::string_view output_prefix,
+                                     const ReshardOptions& options);
+
+}  // namespace deepmind::code_contests
+
+#endif  // THIRD_PARTY_DEEPMIND_CODE_CONTESTS_DATASET_RESHARD_H_
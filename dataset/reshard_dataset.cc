@@ -0,0 +1,100 @@
+// Copyright 2022 DeepMind Technologies Limited
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Rewrites dataset shards so that evaluating each of them takes about as long
+// (see reshard.h). Every output shard holds unchanged ContestProblem records.
+//
+// Example usage:
+//
+//   reshard_dataset --num_shards=128 \
+//     --output_prefix=/path/to/balanced/code_contests_train.riegeli \
+//     /path/to/dataset/code_contests_train.riegeli-*
+//
+// Pass --runtime_weights_path to weight estimated costs by the runtimes of a
+// previous evaluation, given as lines of a problem name, a tab and a weight.
+
+#include <algorithm>
+#include <iostream>
+#include <numeric>
+#include <string>
+#include <vector>
+
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "dataset/reshard.h"
+#include "dataset/shard_reader.h"
+#include "execution/status_macros.h"
+
+ABSL_FLAG(std::string, output_prefix, "",
+          "Path prefix of the new shards, which are suffixed with "
+          "-<shard>-of-<num_shards>.");
+ABSL_FLAG(int, num_shards, 128, "Number of shards to write.");
+ABSL_FLAG(std::string, runtime_weights_path, "",
+          "Optional path to relative runtimes of problems.");
+ABSL_FLAG(std::string, record_writer_options, "",
+          "riegeli RecordWriter options for the new shards.");
+
+namespace deepmind::code_contests {
+namespace {
+
+// Returns how much longer the most expensive shard takes than the average.
+double Imbalance(const std::vector<double>& costs) {
+  if (costs.empty()) return 1;
+  const double total = std::accumulate(costs.begin(), costs.end(), 0.0);
+  if (total == 0) return 1;
+  return *std::max_element(costs.begin(), costs.end()) * costs.size() / total;
+}
+
+absl::StatusOr<ReshardStats> ReshardFromFlags(
+    const std::vector<std::string>& shards) {
+  ReshardOptions options{
+      .num_shards = absl::GetFlag(FLAGS_num_shards),
+      .read_mode = ShardReadModeFromFlags(),
+      .record_writer_options = absl::GetFlag(FLAGS_record_writer_options)};
+  const std::string runtime_weights_path =
+      absl::GetFlag(FLAGS_runtime_weights_path);
+  if (!runtime_weights_path.empty()) {
+    ASSIGN_OR_RETURN(options.runtime_weights,
+                     LoadRuntimeWeights(runtime_weights_path));
+  }
+  return Reshard(shards, absl::GetFlag(FLAGS_output_prefix), options);
+}
+
+}  // namespace
+}  // namespace deepmind::code_contests
+
+int main(int argc, char* argv[]) {
+  const std::vector<char*> args = absl::ParseCommandLine(argc, argv);
+  if (absl::GetFlag(FLAGS_output_prefix).empty() || args.size() < 2) {
+    std::cerr << "Usage: " << args[0] << " --output_prefix=<path> <shard>...\n";
+    return 1;
+  }
+  const std::vector<std::string> shards(args.begin() + 1, args.end());
+
+  absl::StatusOr<deepmind::code_contests::ReshardStats> stats =
+      deepmind::code_contests::ReshardFromFlags(shards);
+  if (!stats.ok()) {
+    std::cerr << "Failed: " << stats.status().message() << std::endl;
+    return 1;
+  }
+  std::cout << "Resharded " << stats->num_problems << " problems from "
+            << shards.size() << " into " << stats->output_costs.size()
+            << " shards.\nMost expensive shard vs. mean: "
+            << deepmind::code_contests::Imbalance(stats->input_costs)
+            << "x before, "
+            << deepmind::code_contests::Imbalance(stats->output_costs)
+            << "x after." << std::endl;
+}
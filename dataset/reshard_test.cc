@@ -0,0 +1,196 @@
+// Copyright 2022 DeepMind Technologies Limited
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "dataset/reshard.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "contest_problem.pb.h"
+#include "dataset/shard_reader.h"
+#include "riegeli/bytes/fd_writer.h"
+#include "riegeli/records/record_reader.h"
+#include "riegeli/records/record_writer.h"
+
+namespace deepmind::code_contests {
+namespace {
+
+using ::testing::Each;
+using ::testing::ElementsAre;
+using ::testing::Pair;
+using ::testing::UnorderedElementsAre;
+using ::testing::UnorderedElementsAreArray;
+
+std::string TestPath(const absl::string_view name) {
+  return absl::StrCat(testing::TempDir(), "/", name);
+}
+
+TEST(EstimateEvaluationCostTest, MultipliesTestBytesByTestCount) {
+  ProblemTestViews tests;
+  tests.public_tests = {{"1 2\n", "3"}};
+  tests.generated_tests = {{"5 6\n", "11"}, {"", ""}};
+  EXPECT_EQ(EstimateEvaluationCost(tests), (5 + 6) * 3);
+  EXPECT_EQ(EstimateEvaluationCost(ProblemTestViews()), 1);
+}
+
+TEST(BalanceShardsTest, BalancesCosts) {
+  const std::vector<double> costs = {10, 1, 9, 2, 8, 3, 7, 4, 6, 5};
+  const std::vector<int> assignment = BalanceShards(costs, 3);
+  ASSERT_EQ(assignment.size(), costs.size());
+  std::vector<double> totals(3);
+  for (int i = 0; i < costs.size(); ++i) {
+    ASSERT_GE(assignment[i], 0);
+    ASSERT_LT(assignment[i], 3);
+    totals[assignment[i]] += costs[i];
+  }
+  EXPECT_THAT(totals, UnorderedElementsAre(18, 18, 19));
+}
+
+TEST(BalanceShardsTest, SpreadsExpensiveItems) {
+  const std::vector<int> assignment = BalanceShards({100, 100, 100, 1}, 3);
+  EXPECT_THAT(std::vector<int>(assignment.begin(), assignment.begin() + 3),
+              UnorderedElementsAre(0, 1, 2));
+}
+
+TEST(LoadRuntimeWeightsTest, ParsesLines) {
+  const std::string path = TestPath("runtimes.tsv");
+  std::ofstream(path) << "1_A. Some, problem\t2.5\n\n2_B. Other\t0\n";
+  absl::StatusOr<absl::flat_hash_map<std::string, double>> weights =
+      LoadRuntimeWeights(path);
+  ASSERT_TRUE(weights.ok()) << weights.status();
+  EXPECT_THAT(*weights, UnorderedElementsAre(Pair("1_A. Some, problem", 2.5),
+                                             Pair("2_B. Other", 0)));
+
+  std::ofstream(path) << "no weight\n";
+  EXPECT_EQ(LoadRuntimeWeights(path).status().code(),
+            absl::StatusCode::kInvalidArgument);
+  EXPECT_FALSE(LoadRuntimeWeights(TestPath("missing.tsv")).ok());
+}
+
+TEST(ShardPathTest, FollowsDatasetNaming) {
+  EXPECT_EQ(ShardPath("code_contests_train.riegeli", 3, 128),
+            "code_contests_train.riegeli-00003-of-00128");
+}
+
+// Writes one shard holding problems with `num_tests` tests each.
+std::string WriteShard(const absl::string_view name,
+                       const std::vector<int>& num_tests,
+                       std::vector<std::string>& names) {
+  const std::string path = TestPath(name);
+  riegeli::RecordWriter<riegeli::FdWriter<>> writer(
+      std::forward_as_tuple(path, O_WRONLY | O_CREAT | O_TRUNC));
+  for (int i = 0; i < num_tests.size(); ++i) {
+    ContestProblem problem;
+    problem.set_name(absl::StrCat(name, "_", i));
+    problem.set_cf_rating(800 + i);
+    for (int j = 0; j < num_tests[i]; ++j) {
+      ContestProblem::Test* test = problem.add_generated_tests();
+      test->set_input(std::string(100, 'x'));
+      test->set_output("1");
+    }
+    names.push_back(problem.name());
+    EXPECT_TRUE(writer.WriteRecord(problem));
+  }
+  EXPECT_TRUE(writer.Close()) << writer.status();
+  return path;
+}
+
+TEST(ReshardTest, BalancesAndKeepsEveryProblem) {
+  std::vector<std::string> names;
+  // All expensive problems start out in the first shard.
+  const std::vector<std::string> shards = {
+      WriteShard("heavy.riegeli", {50, 50, 50, 50}, names),
+      WriteShard("light.riegeli", {1, 1, 1, 1, 1, 1, 1, 1}, names)};
+  const std::string prefix = TestPath("balanced.riegeli");
+  absl::StatusOr<ReshardStats> stats =
+      Reshard(shards, prefix, ReshardOptions{.num_shards = 4});
+  ASSERT_TRUE(stats.ok()) << stats.status();
+  EXPECT_EQ(stats->num_problems, 12);
+  ASSERT_EQ(stats->input_costs.size(), 2);
+  EXPECT_GT(stats->input_costs[0], 100 * stats->input_costs[1]);
+  ASSERT_EQ(stats->output_costs.size(), 4);
+  const auto [min_cost, max_cost] = std::minmax_element(
+      stats->output_costs.begin(), stats->output_costs.end());
+  EXPECT_LT(*max_cost, 1.01 * *min_cost);
+
+  std::vector<std::string> resharded_names;
+  for (int shard = 0; shard < 4; ++shard) {
+    const std::unique_ptr<riegeli::RecordReaderBase> reader =
+        OpenShard(ShardPath(prefix, shard, 4), ShardReadMode::kFd);
+    ContestProblem problem;
+    while (reader->ReadRecord(problem)) {
+      resharded_names.push_back(problem.name());
+      EXPECT_EQ(problem.cf_rating(), 800 + (resharded_names.back().back() - '0'));
+    }
+    EXPECT_TRUE(reader->Close()) << reader->status();
+  }
+  EXPECT_THAT(resharded_names, UnorderedElementsAreArray(names));
+}
+
+TEST(ReshardTest, UsesRuntimeWeights) {
+  std::vector<std::string> names;
+  const std::vector<std::string> shards = {
+      WriteShard("weighted.riegeli", {1, 1, 1}, names)};
+  absl::StatusOr<ReshardStats> stats = Reshard(
+      shards, TestPath("weighted_out.riegeli"),
+      ReshardOptions{.num_shards = 2,
+                     .runtime_weights = {{"weighted.riegeli_0", 2},
+                                         {"weighted.riegeli_1", 4}}});
+  ASSERT_TRUE(stats.ok()) << stats.status();
+  // Problems without a runtime get the mean weight of 3.
+  EXPECT_THAT(stats->output_costs, UnorderedElementsAre(4 * 101, 5 * 101));
+}
+
+TEST(ReshardTest, FailureLeavesNoTemporaryShards) {
+  std::vector<std::string> names;
+  const std::vector<std::string> shards = {
+      WriteShard("blocked.riegeli", {1, 1}, names)};
+  const std::string prefix = TestPath("blocked_out.riegeli");
+  // A non-empty directory where the last shard goes makes renaming it fail.
+  const std::string blocked = ShardPath(prefix, 1, 2);
+  mkdir(blocked.c_str(), 0755);
+  std::ofstream(absl::StrCat(blocked, "/file")) << "x";
+  EXPECT_FALSE(Reshard(shards, prefix, {.num_shards = 2}).ok());
+  for (int shard = 0; shard < 2; ++shard) {
+    EXPECT_NE(
+        access(absl::StrCat(ShardPath(prefix, shard, 2), ".tmp").c_str(), F_OK),
+        0);
+  }
+}
+
+TEST(ReshardTest, RejectsInvalidOptions) {
+  EXPECT_EQ(Reshard({}, TestPath("none.riegeli"), {.num_shards = 0})
+                .status()
+                .code(),
+            absl::StatusCode::kInvalidArgument);
+  EXPECT_FALSE(Reshard({}, TestPath("none.riegeli"),
+                       {.record_writer_options = "not an option"})
+                   .ok());
+}
+
+}  // namespace
+}  // namespace deepmind::code_contests
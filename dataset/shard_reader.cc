@@ -0,0 +1,92 @@
+// Copyright 2022 DeepMind Technologies Limited
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "dataset/shard_reader.h"
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <tuple>
+
+#include "absl/flags/flag.h"
+#include "absl/status/status.h"
+#include "absl/strings/string_view.h"
+#include "execution/status_macros.h"
+#include "riegeli/bytes/fd_mmap_reader.h"
+#include "riegeli/bytes/fd_reader.h"
+#include "riegeli/records/record_reader.h"
+
+ABSL_FLAG(deepmind::code_contests::ShardReadMode, shard_read_mode,
+          deepmind::code_contests::ShardReadMode::kFd,
+          "How to read dataset shards: \"fd\" to read() them, or \"mmap\" to "
+          "map them into memory so that the page cache holds the only copy. "
+          "Shards must not be modified while they are mapped.");
+
+namespace deepmind::code_contests {
+
+bool AbslParseFlag(const absl::string_view text, ShardReadMode* const mode,
+                   std::string* const error) {
+  if (text == "fd") {
+    *mode = ShardReadMode::kFd;
+    return true;
+  }
+  if (text == "mmap") {
+    *mode = ShardReadMode::kMmap;
+    return true;
+  }
+  *error = "expected \"fd\" or \"mmap\"";
+  return false;
+}
+
+std::string AbslUnparseFlag(const ShardReadMode mode) {
+  switch (mode) {
+    case ShardReadMode::kFd:
+      return "fd";
+    case ShardReadMode::kMmap:
+      return "mmap";
+  }
+  return "fd";
+}
+
+ShardReadMode ShardReadModeFromFlags() {
+  return absl::GetFlag(FLAGS_shard_read_mode);
+}
+
+std::unique_ptr<riegeli::RecordReaderBase> OpenShard(
+    const absl::string_view path, const ShardReadMode mode) {
+  switch (mode) {
+    case ShardReadMode::kFd:
+      return std::make_unique<riegeli::RecordReader<riegeli::FdReader<>>>(
+          std::forward_as_tuple(path));
+    case ShardReadMode::kMmap:
+      return std::make_unique<riegeli::RecordReader<riegeli::FdMMapReader<>>>(
+          std::forward_as_tuple(path));
+  }
+  return nullptr;
+}
+
+absl::Status ForEachRecord(
+    const absl::string_view shard, const ShardReadMode mode,
+    const std::function<absl::Status(absl::string_view record)>& fn) {
+  const std::unique_ptr<riegeli::RecordReaderBase> reader =
+      OpenShard(shard, mode);
+  absl::string_view record;
+  while (reader->ReadRecord(record)) {
+    RETURN_IF_ERROR(fn(record));
+  }
+  if (!reader->Close()) return reader->status();
+  return absl::OkStatus();
+}
+
+}  // namespace deepmind::code_contests
@@ -0,0 +1,71 @@
+// Copyright 2022 DeepMind Technologies Limited
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Opening dataset shards for reading, either with read() or with mmap().
+//
+// By default riegeli reads a shard with read(), copying every compressed chunk
+// from the page cache into its own buffer before decompressing it. With mmap()
+// chunks are decompressed straight from the page cache, which is worthwhile
+// when the same shards are read over and over on one machine. Only
+// decompressed chunks, which riegeli needs to hold anyway, are then copied.
+//
+// Example usage:
+//
+//   RETURN_IF_ERROR(ForEachRecord(
+//       shard, ShardReadModeFromFlags(), [&](absl::string_view record) {
+//         ...
+//         return absl::OkStatus();
+//       }));
+
+#ifndef THIRD_PARTY_DEEPMIND_CODE_CONTESTS_DATASET_SHARD_READER_H_
+#define THIRD_PARTY_DEEPMIND_CODE_CONTESTS_DATASET_SHARD_READER_H_
+
+#include <functional>
+#include <memory>
+#include <string>
+
+#include "absl/status/status.h"
+#include "absl/strings/string_view.h"
+#include "riegeli/records/record_reader.h"
+
+namespace deepmind::code_contests {
+
+enum class ShardReadMode {
+  kFd,
+  kMmap,
+};
+
+// Flag support, with "fd" and "mmap" as the names of the modes.
+bool AbslParseFlag(absl::string_view text, ShardReadMode* mode,
+                   std::string* error);
+std::string AbslUnparseFlag(ShardReadMode mode);
+
+// The mode set with --shard_read_mode.
+ShardReadMode ShardReadModeFromFlags();
+
+// Opens the riegeli file at `path`. Failures, including failing to open the
+// file, are reported through the reader's status.
+std::unique_ptr<riegeli::RecordReaderBase> OpenShard(absl::string_view path,
+                                                     ShardReadMode mode);
+
+// Calls `fn` with every record of `shard`, in order, stopping at the first
+// error. The record points into riegeli's decompressed chunk and is only valid
+// during the call, but is not copied.
+absl::Status ForEachRecord(
+    absl::string_view shard, ShardReadMode mode,
+    const std::function<absl::Status(absl::string_view record)>& fn);
+
+}  // namespace deepmind::code_contests
+
+#endif  // THIRD_PARTY_DEEPMIND_CODE_CONTESTS_DATASET_SHARD_READER_H_
@@ -0,0 +1,101 @@
+// Copyright 2022 DeepMind Technologies Limited
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "dataset/shard_reader.h"
+
+#include <fcntl.h>
+
+#include <memory>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/flags/marshalling.h"
+#include "absl/status/status.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "contest_problem.pb.h"
+#include "riegeli/bytes/fd_writer.h"
+#include "riegeli/records/record_reader.h"
+#include "riegeli/records/record_writer.h"
+
+namespace deepmind::code_contests {
+namespace {
+
+using ::testing::ElementsAre;
+
+std::string WriteShard() {
+  const std::string path = absl::StrCat(testing::TempDir(), "/shard.riegeli");
+  riegeli::RecordWriter<riegeli::FdWriter<>> writer(
+      std::forward_as_tuple(path, O_WRONLY | O_CREAT | O_TRUNC));
+  for (const absl::string_view name : {"first", "second", "third"}) {
+    ContestProblem problem;
+    problem.set_name(std::string(name));
+    EXPECT_TRUE(writer.WriteRecord(problem));
+  }
+  EXPECT_TRUE(writer.Close()) << writer.status();
+  return path;
+}
+
+class ShardReaderTest : public testing::TestWithParam<ShardReadMode> {};
+
+TEST_P(ShardReaderTest, ReadsAllRecords) {
+  const std::unique_ptr<riegeli::RecordReaderBase> reader =
+      OpenShard(WriteShard(), GetParam());
+  std::vector<std::string> names;
+  ContestProblem problem;
+  while (reader->ReadRecord(problem)) {
+    names.push_back(problem.name());
+  }
+  EXPECT_TRUE(reader->Close()) << reader->status();
+  EXPECT_THAT(names, ElementsAre("first", "second", "third"));
+}
+
+TEST_P(ShardReaderTest, VisitsRecordsInPlace) {
+  std::vector<std::string> names;
+  EXPECT_TRUE(ForEachRecord(WriteShard(), GetParam(),
+                            [&](absl::string_view record) {
+                              ContestProblem problem;
+                              EXPECT_TRUE(problem.ParseFromArray(
+                                  record.data(), record.size()));
+                              names.push_back(problem.name());
+                              return absl::OkStatus();
+                            })
+                  .ok());
+  EXPECT_THAT(names, ElementsAre("first", "second", "third"));
+}
+
+TEST_P(ShardReaderTest, ReportsMissingShard) {
+  EXPECT_FALSE(ForEachRecord("/nonexistent/shard", GetParam(),
+                             [](absl::string_view) { return absl::OkStatus(); })
+                   .ok());
+}
+
+INSTANTIATE_TEST_SUITE_P(AllModes, ShardReaderTest,
+                         testing::Values(ShardReadMode::kFd,
+                                         ShardReadMode::kMmap));
+
+TEST(ShardReadModeTest, ParsesFlag) {
+  ShardReadMode mode;
+  std::string error;
+  EXPECT_TRUE(absl::ParseFlag("mmap", &mode, &error));
+  EXPECT_EQ(mode, ShardReadMode::kMmap);
+  EXPECT_EQ(absl::UnparseFlag(mode), "mmap");
+  EXPECT_FALSE(absl::ParseFlag("mapped", &mode, &error));
+}
+
+}  // namespace
+}  // namespace deepmind::code_contests
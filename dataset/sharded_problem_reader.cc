@@ -0,0 +1,194 @@
+// Copyright 2022 DeepMind Technologies Limited
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "dataset/sharded_problem_reader.h"
+
+#include <algorithm>
+#include <memory>
+#include <optional>
+#include <string>
+#include <thread>  // NOLINT(build/c++11)
+#include <utility>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/synchronization/mutex.h"
+#include "google/protobuf/arena.h"
+#include "contest_problem.pb.h"
+#include "dataset/arena_pool.h"
+#include "dataset/bounded_queue.h"
+#include "dataset/projected_problem.h"
+#include "dataset/shard_reader.h"
+#include "execution/status_macros.h"
+#include "riegeli/records/record_reader.h"
+
+namespace deepmind::code_contests {
+
+ShardedProblemReader::ShardedProblemReader(std::vector<std::string> shards,
+                                           ShardedProblemReaderOptions options)
+    : shards_(std::move(shards)),
+      options_(std::move(options)),
+      arena_pool_(options_.arena_batch_size > 0
+                      ? ArenaPool::Create(options_.arena_options)
+                      : nullptr) {
+  const int num_queues = options_.deterministic ? shards_.size() : 1;
+  for (int i = 0; i < num_queues; ++i) {
+    queues_.push_back(
+        std::make_unique<BoundedQueue<Item>>(options_.queue_capacity));
+  }
+  const int num_threads = std::max(
+      1, std::min<int>(options_.num_threads, std::max<int>(shards_.size(), 1)));
+  {
+    absl::MutexLock l(&mu_);
+    running_readers_ = num_threads;
+  }
+  for (int i = 0; i < num_threads; ++i) {
+    threads_.push_back(std::thread(&ShardedProblemReader::ReadShards, this));
+  }
+}
+
+ShardedProblemReader::~ShardedProblemReader() { Close().IgnoreError(); }
+
+bool ShardedProblemReader::ReadProblem(ContestProblem& problem,
+                                       int* shard_index) {
+  ProjectedProblem projected;
+  if (!ReadProblem(projected, shard_index)) {
+    return false;
+  }
+  problem = std::move(projected.mutable_problem());
+  return true;
+}
+
+bool ShardedProblemReader::ReadProblem(ProjectedProblem& problem,
+                                       int* shard_index) {
+  std::optional<Item> item;
+  if (!options_.deterministic) {
+    item = queues_.front()->Pop();
+  } else {
+    absl::MutexLock consumer_lock(&consumer_mu_);
+    for (;;) {
+      int shard;
+      {
+        absl::MutexLock l(&mu_);
+        shard = consumer_shard_;
+      }
+      if (shard >= shards_.size()) break;
+      item = queues_[shard]->Pop();
+      if (item.has_value()) break;
+      // This shard is exhausted; move on to the next one.
+      absl::MutexLock l(&mu_);
+      ++consumer_shard_;
+    }
+  }
+  if (!item.has_value()) {
+    return false;
+  }
+  problem = std::move(item->problem);
+  if (shard_index != nullptr) {
+    *shard_index = item->shard_index;
+  }
+  return true;
+}
+
+absl::Status ShardedProblemReader::Close() {
+  {
+    absl::MutexLock l(&mu_);
+    Cancel();
+  }
+  for (std::thread& thread : threads_) {
+    thread.join();
+  }
+  threads_.clear();
+  absl::MutexLock l(&mu_);
+  return status_;
+}
+
+bool ShardedProblemReader::CanStartShard() const {
+  // In deterministic mode, shards that consumers have not reached yet cannot be
+  // drained, so we only read a few shards ahead to bound memory use.
+  return cancelled_ || !options_.deterministic ||
+         next_shard_ < consumer_shard_ + options_.num_threads;
+}
+
+void ShardedProblemReader::Cancel() {
+  cancelled_ = true;
+  for (auto& queue : queues_) {
+    queue->Cancel();
+  }
+}
+
+void ShardedProblemReader::ReadShards() {
+  for (;;) {
+    int shard_index;
+    {
+      absl::MutexLock l(&mu_);
+      mu_.Await(absl::Condition(this, &ShardedProblemReader::CanStartShard));
+      if (cancelled_ || next_shard_ >= shards_.size()) break;
+      shard_index = next_shard_++;
+    }
+    const absl::Status status = ReadShard(shard_index);
+    if (!status.ok()) {
+      absl::MutexLock l(&mu_);
+      status_.Update(status);
+      Cancel();
+      break;
+    }
+    if (options_.deterministic) {
+      queues_[shard_index]->Close();
+    }
+  }
+
+  absl::MutexLock l(&mu_);
+  if (--running_readers_ == 0) {
+    // Every shard has been started and finished, so consumers should stop once
+    // they have drained the queues.
+    for (auto& queue : queues_) {
+      queue->Close();
+    }
+  }
+}
+
+absl::Status ShardedProblemReader::ReadShard(const int shard_index) {
+  const std::unique_ptr<riegeli::RecordReaderBase> reader =
+      OpenShard(shards_[shard_index], options_.read_mode);
+  BoundedQueue<Item>& queue =
+      *queues_[options_.deterministic ? shard_index : 0];
+  const ProblemFieldMask& first_fields =
+      options_.filter ? options_.filter_fields : options_.fields;
+  std::string record;
+  std::shared_ptr<google::protobuf::Arena> arena;
+  int records_on_arena = 0;
+  while (reader->ReadRecord(record)) {
+    if (arena_pool_ != nullptr &&
+        records_on_arena++ % options_.arena_batch_size == 0) {
+      // Problems already on the previous arena keep it alive until consumers
+      // are done with them.
+      arena = arena_pool_->Acquire();
+    }
+    Item item{.shard_index = shard_index, .problem = ProjectedProblem(arena)};
+    RETURN_IF_ERROR(item.problem.Decode(std::move(record), first_fields));
+    if (options_.filter) {
+      if (!options_.filter(item.problem)) continue;
+      RETURN_IF_ERROR(item.problem.Materialize(options_.fields));
+    }
+    if (!queue.Push(std::move(item))) {
+      // The reader was closed.
+      return absl::OkStatus();
+    }
+  }
+  if (!reader->Close()) return reader->status();
+  return absl::OkStatus();
+}
+
+}  // namespace deepmind::code_contests
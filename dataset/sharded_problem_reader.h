@@ -0,0 +1,143 @@
+// Copyright 2022 DeepMind Technologies Limited
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Reads ContestProblems from several riegeli shards concurrently.
+//
+// Each reader thread opens one shard at a time, decompresses and parses the
+// requested fields of its records and pushes them onto a bounded queue that
+// any number of consumers drain with `ReadProblem`. Readers block while the
+// queue is full, so memory use stays bounded when consumers are slower than
+// readers.
+//
+// Example usage:
+//
+//   ShardedProblemReader reader(shards, {.num_threads = 8});
+//   ContestProblem problem;
+//   while (reader.ReadProblem(problem)) {
+//     ...
+//   }
+//   RETURN_IF_ERROR(reader.Close());
+
+#ifndef THIRD_PARTY_DEEPMIND_CODE_CONTESTS_DATASET_SHARDED_PROBLEM_READER_H_
+#define THIRD_PARTY_DEEPMIND_CODE_CONTESTS_DATASET_SHARDED_PROBLEM_READER_H_
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>  // NOLINT(build/c++11)
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/status/status.h"
+#include "absl/synchronization/mutex.h"
+#include "contest_problem.pb.h"
+#include "dataset/arena_pool.h"
+#include "dataset/bounded_queue.h"
+#include "dataset/projected_problem.h"
+#include "dataset/shard_reader.h"
+
+namespace deepmind::code_contests {
+
+struct ShardedProblemReaderOptions {
+  // The number of shards read concurrently, each on its own thread.
+  int num_threads = 4;
+  // The maximum number of parsed problems buffered ahead of consumers. In
+  // deterministic mode this applies to each shard being read.
+  int queue_capacity = 16;
+  // If true, problems are returned in the same order as reading the shards one
+  // after another would return them. Otherwise problems from different shards
+  // are interleaved in whatever order they are parsed.
+  bool deterministic = false;
+  // The fields of the problems returned. Other fields are left unparsed, which
+  // saves most of the decoding work when tests and solutions are not needed.
+  ProblemFieldMask fields = ProblemFieldMask::All();
+  // If set, only problems for which this returns true are returned. It is
+  // called concurrently from the reader threads, on problems with only
+  // `filter_fields` decoded, whose other fields can still be inspected
+  // undecoded with `ProjectedProblem::SkippedBytes`. The remaining `fields` are
+  // only decoded for problems that pass the filter. See also ProblemFilter.
+  std::function<bool(const ProjectedProblem&)> filter;
+  ProblemFieldMask filter_fields = ProblemFieldMask::All();
+  // If positive, problems are parsed onto protobuf arenas instead of the heap,
+  // which saves allocating every test and solution separately. Each reader
+  // thread starts a new arena every `arena_batch_size` records, and an arena is
+  // reset for reuse once every problem parsed onto it has been destroyed. Read
+  // problems into a ProjectedProblem to use them in place; reading into a
+  // ContestProblem copies them off the arena. Consumers that hold on to
+  // problems keep their whole batch alive, so keep batches small in that case.
+  int arena_batch_size = 0;
+  ArenaPoolOptions arena_options;
+  // How shards are read from disk.
+  ShardReadMode read_mode = ShardReadMode::kFd;
+};
+
+class ShardedProblemReader {
+ public:
+  // Starts reading `shards` in the background.
+  explicit ShardedProblemReader(
+      std::vector<std::string> shards,
+      ShardedProblemReaderOptions options = ShardedProblemReaderOptions());
+  ~ShardedProblemReader();
+
+  ShardedProblemReader(const ShardedProblemReader&) = delete;
+  ShardedProblemReader& operator=(const ShardedProblemReader&) = delete;
+
+  // Blocks until a problem is available and moves it into `problem`. If
+  // `shard_index` is not null, it is set to the index in `shards` of the shard
+  // the problem was read from. Returns false once every shard has been read,
+  // or if reading failed or the reader was closed. Thread-safe.
+  bool ReadProblem(ContestProblem& problem, int* shard_index = nullptr);
+  // As above, but keeps the fields that were not decoded available for
+  // `ProjectedProblem::Materialize`, and leaves the problem on its arena if
+  // `arena_batch_size` is positive.
+  bool ReadProblem(ProjectedProblem& problem, int* shard_index = nullptr);
+
+  // Stops all reader threads and returns the first error encountered while
+  // reading, if any. Closing before all problems are read is not an error.
+  absl::Status Close();
+
+ private:
+  struct Item {
+    int shard_index;
+    ProjectedProblem problem;
+  };
+
+  void ReadShards();
+  absl::Status ReadShard(int shard_index);
+  bool CanStartShard() const ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+  void Cancel() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  const std::vector<std::string> shards_;
+  const ShardedProblemReaderOptions options_;
+  // Null unless options_.arena_batch_size is positive.
+  const std::shared_ptr<ArenaPool> arena_pool_;
+  // A single queue, or one queue per shard in deterministic mode.
+  std::vector<std::unique_ptr<BoundedQueue<Item>>> queues_;
+
+  absl::Mutex mu_;
+  int next_shard_ ABSL_GUARDED_BY(mu_) = 0;
+  int running_readers_ ABSL_GUARDED_BY(mu_) = 0;
+  // In deterministic mode, the shard consumers are currently draining.
+  int consumer_shard_ ABSL_GUARDED_BY(mu_) = 0;
+  bool cancelled_ ABSL_GUARDED_BY(mu_) = false;
+  absl::Status status_ ABSL_GUARDED_BY(mu_);
+
+  // Serializes consumers in deterministic mode.
+  absl::Mutex consumer_mu_;
+  std::vector<std::thread> threads_;
+};
+
+}  // namespace deepmind::code_contests
+
+#endif  // THIRD_PARTY_DEEPMIND_CODE_CONTESTS_DATASET_SHARDED_PROBLEM_READER_H_
@@ -0,0 +1,179 @@
+// Copyright 2022 DeepMind Technologies Limited
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "dataset/sharded_problem_reader.h"
+
+#include <fcntl.h>
+
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/strings/str_cat.h"
+#include "contest_problem.pb.h"
+#include "dataset/projected_problem.h"
+#include "riegeli/bytes/fd_writer.h"
+#include "riegeli/records/record_writer.h"
+
+namespace deepmind::code_contests {
+namespace {
+
+using ::testing::ElementsAreArray;
+using ::testing::UnorderedElementsAreArray;
+
+constexpr int kNumShards = 5;
+constexpr int kProblemsPerShard = 20;
+
+// Writes test shards, returning their paths and the names of all problems in
+// the order they were written.
+std::vector<std::string> WriteShards(std::vector<std::string>& names) {
+  std::vector<std::string> shards;
+  for (int shard = 0; shard < kNumShards; ++shard) {
+    const std::string path =
+        absl::StrCat(testing::TempDir(), "/problems.riegeli-", shard);
+    riegeli::RecordWriter<riegeli::FdWriter<>> writer(
+        std::forward_as_tuple(path, O_WRONLY | O_CREAT | O_TRUNC));
+    for (int i = 0; i < kProblemsPerShard; ++i) {
+      ContestProblem problem;
+      problem.set_name(absl::StrCat(shard, "_", i));
+      problem.set_cf_rating(i);
+      names.push_back(problem.name());
+      EXPECT_TRUE(writer.WriteRecord(problem));
+    }
+    EXPECT_TRUE(writer.Close()) << writer.status();
+    shards.push_back(path);
+  }
+  return shards;
+}
+
+std::vector<std::string> ReadAllNames(ShardedProblemReader& reader) {
+  std::vector<std::string> names;
+  ContestProblem problem;
+  while (reader.ReadProblem(problem)) {
+    names.push_back(problem.name());
+  }
+  EXPECT_TRUE(reader.Close().ok());
+  return names;
+}
+
+TEST(ShardedProblemReaderTest, ReadsAllProblems) {
+  std::vector<std::string> names;
+  const std::vector<std::string> shards = WriteShards(names);
+  ShardedProblemReader reader(shards, {.num_threads = 3, .queue_capacity = 2});
+  EXPECT_THAT(ReadAllNames(reader), UnorderedElementsAreArray(names));
+}
+
+TEST(ShardedProblemReaderTest, DeterministicPreservesOrder) {
+  std::vector<std::string> names;
+  const std::vector<std::string> shards = WriteShards(names);
+  ShardedProblemReader reader(
+      shards, {.num_threads = 3, .queue_capacity = 2, .deterministic = true});
+  EXPECT_THAT(ReadAllNames(reader), ElementsAreArray(names));
+}
+
+TEST(ShardedProblemReaderTest, ReportsShardIndex) {
+  std::vector<std::string> names;
+  const std::vector<std::string> shards = WriteShards(names);
+  ShardedProblemReader reader(shards, {.num_threads = 2});
+  ContestProblem problem;
+  int shard_index;
+  while (reader.ReadProblem(problem, &shard_index)) {
+    EXPECT_EQ(problem.name().substr(0, 1), absl::StrCat(shard_index));
+  }
+  EXPECT_TRUE(reader.Close().ok());
+}
+
+TEST(ShardedProblemReaderTest, AppliesFilter) {
+  std::vector<std::string> names;
+  const std::vector<std::string> shards = WriteShards(names);
+  ShardedProblemReader reader(
+      shards, {.num_threads = 2,
+               .filter = [](const ProjectedProblem& problem) {
+                 return problem.problem().cf_rating() == 0;
+               }});
+  EXPECT_THAT(ReadAllNames(reader),
+              UnorderedElementsAreArray({"0_0", "1_0", "2_0", "3_0", "4_0"}));
+}
+
+TEST(ShardedProblemReaderTest, DecodesOnlyRequestedFields) {
+  std::vector<std::string> names;
+  const std::vector<std::string> shards = WriteShards(names);
+  ShardedProblemReader reader(
+      shards, {.num_threads = 2, .fields = ProblemFieldMask::NameOnly()});
+  ProjectedProblem problem;
+  int num_read = 0;
+  while (reader.ReadProblem(problem)) {
+    EXPECT_FALSE(problem.problem().has_cf_rating());
+    ASSERT_TRUE(problem.MaterializeAll().ok());
+    EXPECT_TRUE(problem.problem().has_cf_rating());
+    ++num_read;
+  }
+  EXPECT_TRUE(reader.Close().ok());
+  EXPECT_EQ(num_read, names.size());
+}
+
+TEST(ShardedProblemReaderTest, ReadsOntoArenas) {
+  std::vector<std::string> names;
+  const std::vector<std::string> shards = WriteShards(names);
+  ShardedProblemReader reader(
+      shards, {.num_threads = 2, .arena_batch_size = 3});
+  // Hold on to some problems so that their arenas cannot be reused yet.
+  std::vector<ProjectedProblem> held;
+  std::vector<std::string> read_names;
+  ProjectedProblem problem;
+  while (reader.ReadProblem(problem)) {
+    ASSERT_NE(problem.arena(), nullptr);
+    EXPECT_EQ(problem.problem().GetArena(), problem.arena());
+    read_names.push_back(problem.problem().name());
+    if (read_names.size() % 10 == 0) {
+      held.push_back(std::move(problem));
+    }
+  }
+  EXPECT_TRUE(reader.Close().ok());
+  EXPECT_THAT(read_names, UnorderedElementsAreArray(names));
+  for (const ProjectedProblem& held_problem : held) {
+    EXPECT_EQ(held_problem.problem().name().find('_'), 1);
+  }
+}
+
+TEST(ShardedProblemReaderTest, CopiesOffArenas) {
+  std::vector<std::string> names;
+  const std::vector<std::string> shards = WriteShards(names);
+  ShardedProblemReader reader(shards,
+                              {.num_threads = 2, .arena_batch_size = 4});
+  EXPECT_THAT(ReadAllNames(reader), UnorderedElementsAreArray(names));
+}
+
+TEST(ShardedProblemReaderTest, CanCloseEarly) {
+  std::vector<std::string> names;
+  const std::vector<std::string> shards = WriteShards(names);
+  ShardedProblemReader reader(shards, {.num_threads = 2, .queue_capacity = 1});
+  ContestProblem problem;
+  EXPECT_TRUE(reader.ReadProblem(problem));
+  EXPECT_TRUE(reader.Close().ok());
+  EXPECT_FALSE(reader.ReadProblem(problem));
+}
+
+TEST(ShardedProblemReaderTest, ReportsMissingShard) {
+  ShardedProblemReader reader({"/nonexistent/shard"});
+  ContestProblem problem;
+  EXPECT_FALSE(reader.ReadProblem(problem));
+  EXPECT_FALSE(reader.Close().ok());
+}
+
+}  // namespace
+}  // namespace deepmind::code_contests
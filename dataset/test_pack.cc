@@ -0,0 +1,621 @@
+// Copyright 2022 DeepMind Technologies Limited
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "dataset/test_pack.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "absl/strings/substitute.h"
+#include "absl/time/time.h"
+#include "dataset/test_pack.pb.h"
+#include "dataset/test_views.h"
+#include "execution/status_macros.h"
+#include "execution/test_data.h"
+#include "farmhash.h"
+#include "zdict.h"
+#include "zstd.h"
+
+namespace deepmind::code_contests {
+
+namespace {
+
+constexpr char kMagic[8] = {'C', 'C', 'T', 'P', 'A', 'C', 'K', '1'};
+constexpr uint64_t kVersion = 1;
+
+constexpr size_t kWord = sizeof(uint64_t);
+// Public, private and generated tests.
+constexpr int kNumTiers = 3;
+// The number of words describing each test in a block.
+constexpr int kTestFields = 4;
+// Compressed blocks also hold the offset and size of their dictionary.
+constexpr int kDictionaryFields = 2;
+// The number of words describing each test in a compressed block.
+constexpr int kCompressedTestFields = 6;
+
+uint64_t LoadUint64(const char* p) {
+  uint64_t value;
+  std::memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+void AppendUint64(const uint64_t value, std::string& out) {
+  out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+absl::Status ErrnoError(const absl::string_view what,
+                        const absl::string_view path) {
+  return absl::UnknownError(
+      absl::Substitute("$0 $1 failed: errno $2", what, path, errno));
+}
+
+struct ZstdDeleter {
+  void operator()(ZSTD_CCtx* context) const { ZSTD_freeCCtx(context); }
+  void operator()(ZSTD_CDict* dictionary) const { ZSTD_freeCDict(dictionary); }
+  void operator()(ZSTD_DCtx* context) const { ZSTD_freeDCtx(context); }
+  void operator()(ZSTD_DDict* dictionary) const { ZSTD_freeDDict(dictionary); }
+};
+
+absl::Status ZstdError(const absl::string_view what, const size_t code) {
+  return absl::InternalError(
+      absl::StrCat(what, " failed: ", ZSTD_getErrorName(code)));
+}
+
+// Returns the tests of a block as inputs and outputs, alternately.
+std::vector<absl::string_view> TestContents(const ProblemTestViews& tests) {
+  std::vector<absl::string_view> contents;
+  for (const std::vector<TestView>* tier :
+       {&tests.public_tests, &tests.private_tests, &tests.generated_tests}) {
+    for (const TestView& test : *tier) {
+      contents.push_back(test.input);
+      contents.push_back(test.output);
+    }
+  }
+  return contents;
+}
+
+size_t TotalSize(const std::vector<std::string>& strings) {
+  size_t size = 0;
+  for (const std::string& s : strings) size += s.size();
+  return size;
+}
+
+// Compresses each of `contents` into its own frame, using `dictionary` unless
+// it is empty.
+absl::StatusOr<std::vector<std::string>> CompressFrames(
+    const std::vector<absl::string_view>& contents,
+    const absl::string_view dictionary, const int level) {
+  const std::unique_ptr<ZSTD_CCtx, ZstdDeleter> context(ZSTD_createCCtx());
+  std::unique_ptr<ZSTD_CDict, ZstdDeleter> prepared_dictionary;
+  if (!dictionary.empty()) {
+    prepared_dictionary.reset(
+        ZSTD_createCDict(dictionary.data(), dictionary.size(), level));
+  }
+  if (context == nullptr ||
+      (!dictionary.empty() && prepared_dictionary == nullptr)) {
+    return absl::ResourceExhaustedError("Unable to set up zstd compression.");
+  }
+  std::vector<std::string> frames;
+  frames.reserve(contents.size());
+  for (const absl::string_view content : contents) {
+    std::string frame(ZSTD_compressBound(content.size()), '\0');
+    const size_t size =
+        prepared_dictionary == nullptr
+            ? ZSTD_compressCCtx(context.get(), frame.data(), frame.size(),
+                                content.data(), content.size(), level)
+            : ZSTD_compress_usingCDict(context.get(), frame.data(),
+                                       frame.size(), content.data(),
+                                       content.size(),
+                                       prepared_dictionary.get());
+    if (ZSTD_isError(size)) return ZstdError("Compressing a test", size);
+    frame.resize(size);
+    frames.push_back(std::move(frame));
+  }
+  return frames;
+}
+
+// Trains a dictionary of at most `max_size` bytes on `samples`. Returns an
+// empty dictionary if training fails, e.g. because there are too few samples.
+std::string TrainDictionary(const std::vector<absl::string_view>& samples,
+                            const size_t max_size) {
+  // Dictionaries should be about a hundredth of the size of their samples, and
+  // training on more samples than that takes long for little gain.
+  const size_t max_sample_bytes = 100 * max_size;
+  std::string sample_bytes;
+  std::vector<size_t> sample_sizes;
+  for (const absl::string_view sample : samples) {
+    if (sample_bytes.size() + sample.size() > max_sample_bytes) break;
+    sample_bytes.append(sample.data(), sample.size());
+    sample_sizes.push_back(sample.size());
+  }
+  std::string dictionary(std::min(max_size, sample_bytes.size() / 100), '\0');
+  if (dictionary.empty()) return dictionary;
+  const size_t size = ZDICT_trainFromBuffer(
+      dictionary.data(), dictionary.size(), sample_bytes.data(),
+      sample_sizes.data(), sample_sizes.size());
+  if (ZDICT_isError(size)) return std::string();
+  dictionary.resize(size);
+  return dictionary;
+}
+
+// Returns test data that is decompressed from `frame` when needed. It is
+// fingerprinted by its frame, its size and `dictionary_fingerprint`, which
+// identifies the dictionary, so that it need not be decompressed for that.
+TestData LazyFrame(const absl::string_view frame, const size_t size,
+                   std::shared_ptr<const ZSTD_DDict> dictionary,
+                   const uint64_t dictionary_fingerprint) {
+  const uint64_t parts[] = {farmhash::Fingerprint64(frame.data(), frame.size()),
+                            size, dictionary_fingerprint};
+  return TestData(
+      size,
+      [frame, dictionary = std::move(dictionary)](
+          const absl::Span<char> out) -> absl::Status {
+        const std::unique_ptr<ZSTD_DCtx, ZstdDeleter> context(
+            ZSTD_createDCtx());
+        if (context == nullptr) {
+          return absl::ResourceExhaustedError(
+              "Unable to set up zstd decompression.");
+        }
+        const size_t size =
+            dictionary == nullptr
+                ? ZSTD_decompressDCtx(context.get(), out.data(), out.size(),
+                                      frame.data(), frame.size())
+                : ZSTD_decompress_usingDDict(context.get(), out.data(),
+                                             out.size(), frame.data(),
+                                             frame.size(), dictionary.get());
+        if (ZSTD_isError(size)) return ZstdError("Decompressing a test", size);
+        if (size != out.size()) {
+          return absl::DataLossError(absl::Substitute(
+              "Decompressed test has $0 bytes instead of $1.", size,
+              out.size()));
+        }
+        return absl::OkStatus();
+      },
+      farmhash::Fingerprint64(reinterpret_cast<const char*>(parts),
+                              sizeof(parts)));
+}
+
+// Copies the limits stored in `entry` to `tests`, a PackedTests or
+// PackedTestData.
+template <typename Tests>
+void SetLimits(const TestPackEntry& entry, Tests& tests) {
+  if (entry.has_time_limit_nanos()) {
+    tests.time_limit = absl::Nanoseconds(entry.time_limit_nanos());
+  }
+  if (entry.has_memory_limit_bytes()) {
+    tests.memory_limit_bytes = entry.memory_limit_bytes();
+  }
+}
+
+}  // namespace
+
+absl::StatusOr<TestPackWriter> TestPackWriter::Create(
+    absl::string_view path, TestPackWriterOptions options) {
+  // Write to a temporary file first, so that readers never observe a partially
+  // written pack.
+  std::string temp_path = absl::StrCat(path, ".tmp");
+  const int fd = open(temp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) return ErrnoError("Opening", temp_path);
+  TestPackWriter writer(std::string(path), std::move(temp_path), fd,
+                        std::move(options));
+  writer.directory_.set_compressed(writer.options_.compress);
+  // Reserve space for the header, which is written last.
+  RETURN_IF_ERROR(writer.Write(std::string(kTestPackAlignment, '\0')));
+  return writer;
+}
+
+TestPackWriter::TestPackWriter(std::string path, std::string temp_path,
+                               const int fd, TestPackWriterOptions options)
+    : path_(std::move(path)),
+      temp_path_(std::move(temp_path)),
+      fd_(fd),
+      options_(std::move(options)) {}
+
+TestPackWriter::TestPackWriter(TestPackWriter&& other)
+    : path_(std::move(other.path_)),
+      temp_path_(std::move(other.temp_path_)),
+      fd_(std::exchange(other.fd_, -1)),
+      options_(std::move(other.options_)),
+      offset_(other.offset_),
+      directory_(std::move(other.directory_)) {}
+
+TestPackWriter::~TestPackWriter() {
+  if (fd_ >= 0) {
+    close(fd_);
+    unlink(temp_path_.c_str());
+  }
+}
+
+absl::Status TestPackWriter::Add(const absl::string_view name,
+                                 const ProblemTestViews& tests) {
+  RETURN_IF_ERROR(PadToAlignment());
+  std::string block;
+  if (options_.compress) {
+    ASSIGN_OR_RETURN(block, CompressedBlock(tests));
+  } else {
+    block = PlainBlock(tests);
+  }
+  TestPackEntry& entry = *directory_.add_problems();
+  entry.set_name(std::string(name));
+  entry.set_offset(offset_);
+  entry.set_size(block.size());
+  if (tests.time_limit.has_value()) {
+    entry.set_time_limit_nanos(absl::ToInt64Nanoseconds(*tests.time_limit));
+  }
+  if (tests.memory_limit_bytes.has_value()) {
+    entry.set_memory_limit_bytes(*tests.memory_limit_bytes);
+  }
+  return Write(block);
+}
+
+std::string TestPackWriter::PlainBlock(const ProblemTestViews& tests) const {
+  const std::vector<TestView>* tiers[] = {
+      &tests.public_tests, &tests.private_tests, &tests.generated_tests};
+  uint64_t num_tests = 0;
+  std::string block;
+  for (const std::vector<TestView>* tier : tiers) {
+    AppendUint64(tier->size(), block);
+    num_tests += tier->size();
+  }
+  // Inputs and outputs follow the table of offsets, each output right after
+  // its input.
+  uint64_t data_offset = (kNumTiers + kTestFields * num_tests) * kWord;
+  for (const std::vector<TestView>* tier : tiers) {
+    for (const TestView& test : *tier) {
+      AppendUint64(data_offset, block);
+      AppendUint64(test.input.size(), block);
+      data_offset += test.input.size();
+      AppendUint64(data_offset, block);
+      AppendUint64(test.output.size(), block);
+      data_offset += test.output.size();
+    }
+  }
+  block.reserve(data_offset);
+  for (const std::vector<TestView>* tier : tiers) {
+    for (const TestView& test : *tier) {
+      block.append(test.input.data(), test.input.size());
+      block.append(test.output.data(), test.output.size());
+    }
+  }
+  return block;
+}
+
+absl::StatusOr<std::string> TestPackWriter::CompressedBlock(
+    const ProblemTestViews& tests) const {
+  const std::vector<absl::string_view> contents = TestContents(tests);
+  ASSIGN_OR_RETURN(
+      std::vector<std::string> frames,
+      CompressFrames(contents, /*dictionary=*/"", options_.compression_level));
+  std::string dictionary =
+      TrainDictionary(contents, options_.max_dictionary_size);
+  if (!dictionary.empty()) {
+    ASSIGN_OR_RETURN(std::vector<std::string> dictionary_frames,
+                     CompressFrames(contents, dictionary,
+                                    options_.compression_level));
+    // Small problems may not make up for the size of their dictionary.
+    if (dictionary.size() + TotalSize(dictionary_frames) < TotalSize(frames)) {
+      frames = std::move(dictionary_frames);
+    } else {
+      dictionary.clear();
+    }
+  }
+
+  std::string block;
+  for (const std::vector<TestView>* tier :
+       {&tests.public_tests, &tests.private_tests, &tests.generated_tests}) {
+    AppendUint64(tier->size(), block);
+  }
+  const uint64_t num_tests = contents.size() / 2;
+  uint64_t data_offset =
+      (kNumTiers + kDictionaryFields + kCompressedTestFields * num_tests) *
+      kWord;
+  AppendUint64(data_offset, block);
+  AppendUint64(dictionary.size(), block);
+  data_offset += dictionary.size();
+  // Each test is described by its input's frame followed by its output's.
+  for (size_t i = 0; i < frames.size(); ++i) {
+    AppendUint64(data_offset, block);
+    AppendUint64(frames[i].size(), block);
+    AppendUint64(contents[i].size(), block);
+    data_offset += frames[i].size();
+  }
+  block.reserve(data_offset);
+  block.append(dictionary);
+  for (const std::string& frame : frames) {
+    block.append(frame);
+  }
+  return block;
+}
+
+absl::Status TestPackWriter::Close() {
+  if (fd_ < 0) {
+    return absl::FailedPreconditionError("Test pack writer already closed.");
+  }
+  RETURN_IF_ERROR(PadToAlignment());
+  const uint64_t directory_offset = offset_;
+  const std::string directory = directory_.SerializeAsString();
+  RETURN_IF_ERROR(Write(directory));
+
+  std::string header(kMagic, sizeof(kMagic));
+  AppendUint64(kVersion, header);
+  AppendUint64(directory_offset, header);
+  AppendUint64(directory.size(), header);
+  if (pwrite(fd_, header.data(), header.size(), 0) !=
+      static_cast<ssize_t>(header.size())) {
+    return ErrnoError("Writing header of", temp_path_);
+  }
+  if (close(std::exchange(fd_, -1)) != 0) {
+    unlink(temp_path_.c_str());
+    return ErrnoError("Closing", temp_path_);
+  }
+  if (rename(temp_path_.c_str(), path_.c_str()) != 0) {
+    return absl::UnknownError(absl::Substitute(
+        "Renaming $0 to $1 failed: errno $2", temp_path_, path_, errno));
+  }
+  return absl::OkStatus();
+}
+
+absl::Status TestPackWriter::Write(absl::string_view bytes) {
+  while (!bytes.empty()) {
+    const ssize_t written = write(fd_, bytes.data(), bytes.size());
+    if (written < 0) {
+      if (errno == EINTR) continue;
+      return ErrnoError("Writing", temp_path_);
+    }
+    bytes.remove_prefix(written);
+    offset_ += written;
+  }
+  return absl::OkStatus();
+}
+
+absl::Status TestPackWriter::PadToAlignment() {
+  const size_t padding =
+      (kTestPackAlignment - offset_ % kTestPackAlignment) % kTestPackAlignment;
+  return Write(std::string(padding, '\0'));
+}
+
+absl::StatusOr<TestPack> TestPack::Open(absl::string_view path) {
+  const std::string path_string(path);
+  const int fd = open(path_string.c_str(), O_RDONLY);
+  if (fd < 0) return ErrnoError("Opening", path);
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    return ErrnoError("Statting", path);
+  }
+  const size_t size = st.st_size;
+  if (size < kTestPackAlignment) {
+    close(fd);
+    return absl::DataLossError(
+        absl::StrCat(path, " is too small to be a test pack."));
+  }
+  void* const data = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) return ErrnoError("Mapping", path);
+  TestPack pack(static_cast<const char*>(data), size);
+
+  const char* const header = pack.data_ + sizeof(kMagic);
+  if (std::memcmp(pack.data_, kMagic, sizeof(kMagic)) != 0 ||
+      LoadUint64(header) != kVersion) {
+    return absl::DataLossError(
+        absl::StrCat(path, " is not a version ", kVersion, " test pack."));
+  }
+  const uint64_t directory_offset = LoadUint64(header + kWord);
+  const uint64_t directory_size = LoadUint64(header + 2 * kWord);
+  if (directory_offset > size || directory_size > size - directory_offset ||
+      !pack.directory_.ParseFromArray(pack.data_ + directory_offset,
+                                      directory_size)) {
+    return absl::DataLossError(
+        absl::StrCat("Invalid directory in test pack ", path));
+  }
+  for (int i = 0; i < pack.directory_.problems_size(); ++i) {
+    const TestPackEntry& entry = pack.directory_.problems(i);
+    if (entry.offset() % kTestPackAlignment != 0 ||
+        entry.offset() > directory_offset ||
+        entry.size() > directory_offset - entry.offset()) {
+      return absl::DataLossError(absl::Substitute(
+          "Invalid block for \"$0\" in test pack $1", entry.name(), path));
+    }
+    pack.entries_.try_emplace(entry.name(), i);
+  }
+  return pack;
+}
+
+TestPack::TestPack(const char* const data, const size_t size)
+    : data_(data), size_(size) {}
+
+TestPack::TestPack(TestPack&& other)
+    : data_(std::exchange(other.data_, nullptr)),
+      size_(std::exchange(other.size_, 0)),
+      directory_(std::move(other.directory_)),
+      entries_(std::move(other.entries_)) {}
+
+TestPack::~TestPack() {
+  if (data_ != nullptr) {
+    munmap(const_cast<char*>(data_), size_);
+  }
+}
+
+absl::StatusOr<const TestPackEntry*> TestPack::FindEntry(
+    const absl::string_view name) const {
+  const auto it = entries_.find(name);
+  if (it == entries_.end()) {
+    return absl::NotFoundError(
+        absl::StrCat("No tests for \"", name, "\" in test pack."));
+  }
+  return &directory_.problems(it->second);
+}
+
+absl::StatusOr<absl::string_view> TestPack::FindBlock(
+    const absl::string_view name) const {
+  ASSIGN_OR_RETURN(const TestPackEntry* const found, FindEntry(name));
+  const TestPackEntry& entry = *found;
+  const char* const block = data_ + entry.offset();
+  // Blocks are page-aligned, so this only touches the pages of this problem.
+  madvise(const_cast<char*>(block), entry.size(), MADV_WILLNEED);
+  return absl::string_view(block, entry.size());
+}
+
+absl::StatusOr<PackedTests> TestPack::Find(const absl::string_view name) const {
+  if (compressed()) {
+    return absl::FailedPreconditionError(
+        "Tests of compressed test packs can only be read with FindData.");
+  }
+  ASSIGN_OR_RETURN(const absl::string_view block_view, FindBlock(name));
+  const char* const block = block_view.data();
+  const uint64_t block_size = block_view.size();
+
+  const absl::Status corrupt = absl::DataLossError(
+      absl::StrCat("Invalid block for \"", name, "\" in test pack."));
+  if (block_size < kNumTiers * kWord) return corrupt;
+  PackedTests tests;
+  uint64_t counts[kNumTiers];
+  uint64_t num_tests = 0;
+  for (int i = 0; i < kNumTiers; ++i) {
+    counts[i] = LoadUint64(block + i * kWord);
+    if (counts[i] > block_size) return corrupt;
+    num_tests += counts[i];
+  }
+  if (num_tests > (block_size / kWord - kNumTiers) / kTestFields) {
+    return corrupt;
+  }
+  tests.num_public_tests = counts[0];
+  tests.num_private_tests = counts[1];
+  tests.num_generated_tests = counts[2];
+  ASSIGN_OR_RETURN(const TestPackEntry* const entry, FindEntry(name));
+  SetLimits(*entry, tests);
+  tests.inputs.reserve(num_tests);
+  tests.outputs.reserve(num_tests);
+  const char* table = block + kNumTiers * kWord;
+  for (uint64_t i = 0; i < num_tests; ++i, table += kTestFields * kWord) {
+    const uint64_t input_offset = LoadUint64(table);
+    const uint64_t input_size = LoadUint64(table + kWord);
+    const uint64_t output_offset = LoadUint64(table + 2 * kWord);
+    const uint64_t output_size = LoadUint64(table + 3 * kWord);
+    if (input_offset > block_size || input_size > block_size - input_offset ||
+        output_offset > block_size ||
+        output_size > block_size - output_offset) {
+      return corrupt;
+    }
+    tests.inputs.push_back(block_view.substr(input_offset, input_size));
+    tests.outputs.push_back(block_view.substr(output_offset, output_size));
+  }
+  return tests;
+}
+
+absl::StatusOr<PackedTestData> TestPack::FindData(
+    const absl::string_view name) const {
+  if (compressed()) {
+    ASSIGN_OR_RETURN(const absl::string_view block, FindBlock(name));
+    return DecodeCompressedBlock(name, block);
+  }
+  ASSIGN_OR_RETURN(const PackedTests tests, Find(name));
+  PackedTestData data{
+      .inputs = std::vector<TestData>(tests.inputs.begin(), tests.inputs.end()),
+      .outputs =
+          std::vector<TestData>(tests.outputs.begin(), tests.outputs.end()),
+      .num_public_tests = tests.num_public_tests,
+      .num_private_tests = tests.num_private_tests,
+      .num_generated_tests = tests.num_generated_tests,
+      .time_limit = tests.time_limit,
+      .memory_limit_bytes = tests.memory_limit_bytes};
+  return data;
+}
+
+absl::StatusOr<PackedTestData> TestPack::DecodeCompressedBlock(
+    const absl::string_view name, const absl::string_view block) const {
+  const absl::Status corrupt = absl::DataLossError(
+      absl::StrCat("Invalid block for \"", name, "\" in test pack."));
+  constexpr int kHeaderWords = kNumTiers + kDictionaryFields;
+  if (block.size() < kHeaderWords * kWord) return corrupt;
+  uint64_t counts[kNumTiers];
+  uint64_t num_tests = 0;
+  for (int i = 0; i < kNumTiers; ++i) {
+    counts[i] = LoadUint64(block.data() + i * kWord);
+    if (counts[i] > block.size()) return corrupt;
+    num_tests += counts[i];
+  }
+  if (num_tests >
+      (block.size() / kWord - kHeaderWords) / kCompressedTestFields) {
+    return corrupt;
+  }
+  const uint64_t dictionary_offset = LoadUint64(block.data() + 3 * kWord);
+  const uint64_t dictionary_size = LoadUint64(block.data() + 4 * kWord);
+  if (dictionary_offset > block.size() ||
+      dictionary_size > block.size() - dictionary_offset) {
+    return corrupt;
+  }
+  // The dictionary is shared by all tests of the problem, and freed once none
+  // of them are needed anymore.
+  std::shared_ptr<const ZSTD_DDict> dictionary;
+  uint64_t dictionary_fingerprint = 0;
+  if (dictionary_size > 0) {
+    dictionary_fingerprint = farmhash::Fingerprint64(
+        block.data() + dictionary_offset, dictionary_size);
+    dictionary.reset(ZSTD_createDDict(block.data() + dictionary_offset,
+                                      dictionary_size),
+                     ZstdDeleter());
+    if (dictionary == nullptr) return corrupt;
+  }
+
+  PackedTestData tests;
+  tests.num_public_tests = counts[0];
+  tests.num_private_tests = counts[1];
+  tests.num_generated_tests = counts[2];
+  ASSIGN_OR_RETURN(const TestPackEntry* const entry, FindEntry(name));
+  SetLimits(*entry, tests);
+  tests.inputs.reserve(num_tests);
+  tests.outputs.reserve(num_tests);
+  const char* table = block.data() + kHeaderWords * kWord;
+  for (uint64_t i = 0; i < 2 * num_tests; ++i, table += 3 * kWord) {
+    const uint64_t frame_offset = LoadUint64(table);
+    const uint64_t frame_size = LoadUint64(table + kWord);
+    const uint64_t size = LoadUint64(table + 2 * kWord);
+    if (frame_offset > block.size() ||
+        frame_size > block.size() - frame_offset) {
+      return corrupt;
+    }
+    // Sizes are only trusted as far as the frames agree, so that a corrupt
+    // pack cannot make decompressing allocate arbitrary amounts of memory.
+    // Frames are always written with their content size.
+    if (ZSTD_getFrameContentSize(block.data() + frame_offset, frame_size) !=
+        size) {
+      return corrupt;
+    }
+    std::vector<TestData>& data = i % 2 == 0 ? tests.inputs : tests.outputs;
+    data.push_back(
+        LazyFrame(block.substr(frame_offset, frame_size), size, dictionary,
+                  dictionary_fingerprint));
+  }
+  return tests;
+}
+
+}  // namespace deepmind::code_contests
@@ -0,0 +1,196 @@
+// Copyright 2022 DeepMind Technologies Limited
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// A flat, memory-mappable file holding the tests of many problems.
+//
+// Evaluating a solution only needs the inputs and outputs of a problem's
+// tests. Getting them from the dataset means parsing the whole ContestProblem
+// and keeping it alive while the tests run. A test pack stores just the tests,
+// laid out so that they can be used straight from a read-only mapping of the
+// file.
+//
+// File layout, with all integers stored as native-endian uint64:
+//
+//   Header, padded to kTestPackAlignment bytes:
+//     magic, version, directory offset, directory size.
+//   One block per problem, each starting at a multiple of kTestPackAlignment:
+//     number of public, private and generated tests;
+//     for every test, in that order: input offset, input size, output offset
+//       and output size, relative to the start of the block;
+//     the bytes of all inputs and outputs.
+//   The directory, a serialized TestPackDirectory.
+//
+// Generated tests are very repetitive within a problem, so packs can instead be
+// written compressed. Every input and output is then its own zstd frame, so
+// that each test is decompressed on its own, only when it runs. Frames share a
+// dictionary trained on the tests of their problem. Blocks of compressed packs
+// hold:
+//     number of public, private and generated tests;
+//     dictionary offset and size, with a size of zero if there is none;
+//     for every test: input offset, compressed and uncompressed input size,
+//       then the same for the output;
+//     the dictionary, then the frames of all inputs and outputs.
+//
+// Build a test pack from dataset shards with build_test_pack.cc.
+//
+// Example usage:
+//
+//   ASSIGN_OR_RETURN(TestPack pack, TestPack::Open(path));
+//   ASSIGN_OR_RETURN(PackedTests tests, pack.Find(name));
+//   tester.Test(code, tests.inputs, options, tests.outputs);
+//
+// or, for packs that may be compressed:
+//
+//   ASSIGN_OR_RETURN(PackedTestData tests, pack.FindData(name));
+//   tester.TestOnData(code, tests.inputs, options, tests.outputs);
+
+#ifndef THIRD_PARTY_DEEPMIND_CODE_CONTESTS_DATASET_TEST_PACK_H_
+#define THIRD_PARTY_DEEPMIND_CODE_CONTESTS_DATASET_TEST_PACK_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "absl/time/time.h"
+#include "dataset/test_pack.pb.h"
+#include "dataset/test_views.h"
+#include "execution/test_data.h"
+
+namespace deepmind::code_contests {
+
+inline constexpr size_t kTestPackAlignment = 4096;
+
+// The tests of one problem, pointing into a TestPack.
+struct PackedTests {
+  // Public, then private, then generated tests, in the same order as in the
+  // ContestProblem.
+  std::vector<absl::string_view> inputs;
+  std::vector<absl::string_view> outputs;
+  int num_public_tests = 0;
+  int num_private_tests = 0;
+  int num_generated_tests = 0;
+  // The problem's limits, if it has any.
+  std::optional<absl::Duration> time_limit;
+  std::optional<int64_t> memory_limit_bytes;
+};
+
+// The tests of one problem, which are decompressed on demand if the pack is
+// compressed. They are valid for the lifetime of the TestPack.
+struct PackedTestData {
+  std::vector<TestData> inputs;
+  std::vector<TestData> outputs;
+  int num_public_tests = 0;
+  int num_private_tests = 0;
+  int num_generated_tests = 0;
+  std::optional<absl::Duration> time_limit;
+  std::optional<int64_t> memory_limit_bytes;
+};
+
+struct TestPackWriterOptions {
+  // Whether to store tests as zstd frames.
+  bool compress = false;
+  // zstd compression level. Higher levels make packs slower to build, but not
+  // slower to read.
+  int compression_level = 9;
+  // Upper bound on the size of each problem's dictionary. Dictionaries are only
+  // kept if they make the problem's block smaller.
+  size_t max_dictionary_size = 112 << 10;
+};
+
+// Writes a test pack. The file only appears at `path` once Close succeeds.
+class TestPackWriter {
+ public:
+  static absl::StatusOr<TestPackWriter> Create(
+      absl::string_view path, TestPackWriterOptions options = {});
+
+  TestPackWriter(TestPackWriter&& other);
+  TestPackWriter& operator=(TestPackWriter&& other) = delete;
+  // Discards the file if it was not closed.
+  ~TestPackWriter();
+
+  // Appends the tests and limits of the problem called `name`. If several
+  // problems have the same name, readers find the first one.
+  absl::Status Add(absl::string_view name, const ProblemTestViews& tests);
+
+  // Writes the directory and header and moves the file into place.
+  absl::Status Close();
+
+ private:
+  TestPackWriter(std::string path, std::string temp_path, int fd,
+                 TestPackWriterOptions options);
+
+  // Returns the contents of the block holding `tests`.
+  std::string PlainBlock(const ProblemTestViews& tests) const;
+  absl::StatusOr<std::string> CompressedBlock(
+      const ProblemTestViews& tests) const;
+  absl::Status Write(absl::string_view bytes);
+  absl::Status PadToAlignment();
+
+  std::string path_;
+  std::string temp_path_;
+  int fd_;
+  TestPackWriterOptions options_;
+  uint64_t offset_ = 0;
+  TestPackDirectory directory_;
+};
+
+// A read-only mapping of a test pack.
+class TestPack {
+ public:
+  static absl::StatusOr<TestPack> Open(absl::string_view path);
+
+  TestPack(TestPack&& other);
+  TestPack& operator=(TestPack&& other) = delete;
+  ~TestPack();
+
+  // Returns the tests of the problem called `name`, which point into the
+  // mapping and are valid for the lifetime of this object. Fails for
+  // compressed packs.
+  absl::StatusOr<PackedTests> Find(absl::string_view name) const;
+  // As Find, but also works for compressed packs.
+  absl::StatusOr<PackedTestData> FindData(absl::string_view name) const;
+
+  bool Contains(absl::string_view name) const {
+    return entries_.contains(name);
+  }
+  int num_problems() const { return directory_.problems_size(); }
+  bool compressed() const { return directory_.compressed(); }
+
+ private:
+  TestPack(const char* data, size_t size);
+
+  // Returns the directory entry of the problem called `name`.
+  absl::StatusOr<const TestPackEntry*> FindEntry(absl::string_view name) const;
+  // Returns the block of the problem called `name`.
+  absl::StatusOr<absl::string_view> FindBlock(absl::string_view name) const;
+  absl::StatusOr<PackedTestData> DecodeCompressedBlock(
+      absl::string_view name, absl::string_view block) const;
+
+  const char* data_;
+  size_t size_;
+  TestPackDirectory directory_;
+  // Index into directory_.problems of the first problem with each name.
+  absl::flat_hash_map<std::string, int> entries_;
+};
+
+}  // namespace deepmind::code_contests
+
+#endif  // THIRD_PARTY_DEEPMIND_CODE_CONTESTS_DATASET_TEST_PACK_H_
@@ -0,0 +1,229 @@
+// Copyright 2022 DeepMind Technologies Limited
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "dataset/test_pack.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "absl/time/time.h"
+#include "dataset/test_views.h"
+#include "execution/test_data.h"
+
+namespace deepmind::code_contests {
+namespace {
+
+using ::testing::ElementsAre;
+
+std::string TestPath(const absl::string_view name) {
+  return absl::StrCat(testing::TempDir(), "/", name);
+}
+
+ProblemTestViews ExampleTests() {
+  ProblemTestViews tests;
+  tests.public_tests = {{"1 2\n", "3"}};
+  tests.private_tests = {{"5 6\n", "11"}, {"7 8\n", "15"}};
+  tests.generated_tests = {{"9 10\n", "19"}};
+  tests.time_limit = absl::Seconds(2);
+  tests.memory_limit_bytes = int64_t{256} << 20;
+  return tests;
+}
+
+TEST(TestPackTest, RoundTrips) {
+  const std::string path = TestPath("round_trip.testpack");
+  {
+    absl::StatusOr<TestPackWriter> writer = TestPackWriter::Create(path);
+    ASSERT_TRUE(writer.ok()) << writer.status();
+    ASSERT_TRUE(writer->Add("adding", ExampleTests()).ok());
+    ASSERT_TRUE(writer->Add("empty", ProblemTestViews()).ok());
+    ASSERT_TRUE(writer->Close().ok());
+  }
+
+  absl::StatusOr<TestPack> pack = TestPack::Open(path);
+  ASSERT_TRUE(pack.ok()) << pack.status();
+  EXPECT_EQ(pack->num_problems(), 2);
+  absl::StatusOr<PackedTests> tests = pack->Find("adding");
+  ASSERT_TRUE(tests.ok()) << tests.status();
+  EXPECT_THAT(tests->inputs, ElementsAre("1 2\n", "5 6\n", "7 8\n", "9 10\n"));
+  EXPECT_THAT(tests->outputs, ElementsAre("3", "11", "15", "19"));
+  EXPECT_EQ(tests->num_public_tests, 1);
+  EXPECT_EQ(tests->num_private_tests, 2);
+  EXPECT_EQ(tests->num_generated_tests, 1);
+  EXPECT_EQ(tests->time_limit, absl::Seconds(2));
+  EXPECT_EQ(tests->memory_limit_bytes, int64_t{256} << 20);
+  // Blocks start on a page boundary of the mapping, and the first input
+  // follows the three test counts and the table of four tests.
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(tests->inputs[0].data()) %
+                kTestPackAlignment,
+            (3 + 4 * 4) * sizeof(uint64_t));
+
+  absl::StatusOr<PackedTests> empty = pack->Find("empty");
+  ASSERT_TRUE(empty.ok()) << empty.status();
+  EXPECT_TRUE(empty->inputs.empty());
+  EXPECT_EQ(empty->time_limit, std::nullopt);
+  EXPECT_EQ(pack->Find("missing").status().code(), absl::StatusCode::kNotFound);
+}
+
+// Returns tests that are only repetitive across tests, as generated tests
+// tend to be, so that they compress much better with a dictionary.
+ProblemTestViews RepetitiveTests(std::vector<std::string>& storage) {
+  std::string shared;
+  uint32_t state = 1;
+  for (int i = 0; i < 600; ++i) {
+    state = state * 1103515245 + 12345;
+    shared.push_back('0' + (state >> 16) % 10);
+  }
+  storage.clear();
+  for (int i = 0; i < 200; ++i) {
+    storage.push_back(absl::StrCat(i, "\n", shared, "\n"));
+    storage.push_back(absl::StrCat(i % 7 == 0 ? "YES" : "NO", "\n"));
+  }
+  ProblemTestViews tests;
+  tests.public_tests = {{storage[0], storage[1]}};
+  for (int i = 2; i < storage.size(); i += 2) {
+    tests.generated_tests.push_back({storage[i], storage[i + 1]});
+  }
+  return tests;
+}
+
+std::vector<std::string> Contents(const std::vector<TestData>& data) {
+  std::vector<std::string> contents;
+  for (const TestData& d : data) {
+    const absl::StatusOr<std::string> bytes = d.ToString();
+    EXPECT_TRUE(bytes.ok()) << bytes.status();
+    contents.push_back(bytes.value_or(""));
+  }
+  return contents;
+}
+
+int64_t FileSize(const std::string& path) {
+  struct stat st;
+  EXPECT_EQ(stat(path.c_str(), &st), 0);
+  return st.st_size;
+}
+
+TEST(TestPackTest, CompressedRoundTrips) {
+  std::vector<std::string> storage;
+  const ProblemTestViews repetitive = RepetitiveTests(storage);
+  const std::string plain_path = TestPath("plain.testpack");
+  const std::string compressed_path = TestPath("compressed.testpack");
+  for (const bool compress : {false, true}) {
+    absl::StatusOr<TestPackWriter> writer = TestPackWriter::Create(
+        compress ? compressed_path : plain_path, {.compress = compress});
+    ASSERT_TRUE(writer.ok()) << writer.status();
+    ASSERT_TRUE(writer->Add("adding", ExampleTests()).ok());
+    ASSERT_TRUE(writer->Add("repetitive", repetitive).ok());
+    ASSERT_TRUE(writer->Close().ok());
+  }
+  EXPECT_LT(FileSize(compressed_path), FileSize(plain_path) / 4);
+
+  absl::StatusOr<TestPack> pack = TestPack::Open(compressed_path);
+  ASSERT_TRUE(pack.ok()) << pack.status();
+  EXPECT_TRUE(pack->compressed());
+  EXPECT_EQ(pack->Find("adding").status().code(),
+            absl::StatusCode::kFailedPrecondition);
+  absl::StatusOr<PackedTestData> tests = pack->FindData("adding");
+  ASSERT_TRUE(tests.ok()) << tests.status();
+  EXPECT_FALSE(tests->inputs[0].bytes().has_value());
+  // Tests can be told apart without decompressing them.
+  ASSERT_TRUE(tests->inputs[0].fingerprint().has_value());
+  EXPECT_NE(tests->inputs[0].fingerprint(), tests->inputs[1].fingerprint());
+  EXPECT_THAT(Contents(tests->inputs),
+              ElementsAre("1 2\n", "5 6\n", "7 8\n", "9 10\n"));
+  EXPECT_THAT(Contents(tests->outputs), ElementsAre("3", "11", "15", "19"));
+  EXPECT_EQ(tests->num_private_tests, 2);
+  EXPECT_EQ(tests->time_limit, absl::Seconds(2));
+
+  tests = pack->FindData("repetitive");
+  ASSERT_TRUE(tests.ok()) << tests.status();
+  EXPECT_EQ(tests->num_public_tests, 1);
+  EXPECT_EQ(tests->num_generated_tests, 199);
+  const std::vector<std::string> inputs = Contents(tests->inputs);
+  const std::vector<std::string> outputs = Contents(tests->outputs);
+  ASSERT_EQ(inputs.size(), 200);
+  for (int i = 0; i < 200; ++i) {
+    EXPECT_EQ(inputs[i], storage[2 * i]);
+    EXPECT_EQ(outputs[i], storage[2 * i + 1]);
+  }
+  EXPECT_EQ(pack->FindData("missing").status().code(),
+            absl::StatusCode::kNotFound);
+}
+
+TEST(TestPackTest, FindsDataInPlainPacks) {
+  const std::string path = TestPath("plain_data.testpack");
+  absl::StatusOr<TestPackWriter> writer = TestPackWriter::Create(path);
+  ASSERT_TRUE(writer.ok()) << writer.status();
+  ASSERT_TRUE(writer->Add("adding", ExampleTests()).ok());
+  ASSERT_TRUE(writer->Close().ok());
+
+  absl::StatusOr<TestPack> pack = TestPack::Open(path);
+  ASSERT_TRUE(pack.ok()) << pack.status();
+  absl::StatusOr<PackedTestData> tests = pack->FindData("adding");
+  ASSERT_TRUE(tests.ok()) << tests.status();
+  // Tests of plain packs stay in the mapping.
+  ASSERT_TRUE(tests->outputs[3].bytes().has_value());
+  EXPECT_EQ(*tests->outputs[3].bytes(), "19");
+}
+
+TEST(TestPackTest, FindsFirstProblemWithName) {
+  const std::string path = TestPath("duplicates.testpack");
+  absl::StatusOr<TestPackWriter> writer = TestPackWriter::Create(path);
+  ASSERT_TRUE(writer.ok()) << writer.status();
+  ASSERT_TRUE(writer->Add("adding", ExampleTests()).ok());
+  ASSERT_TRUE(writer->Add("adding", ProblemTestViews()).ok());
+  ASSERT_TRUE(writer->Close().ok());
+
+  absl::StatusOr<TestPack> pack = TestPack::Open(path);
+  ASSERT_TRUE(pack.ok()) << pack.status();
+  absl::StatusOr<PackedTests> tests = pack->Find("adding");
+  ASSERT_TRUE(tests.ok()) << tests.status();
+  EXPECT_EQ(tests->inputs.size(), 4);
+}
+
+TEST(TestPackTest, UnclosedWriterLeavesNoFile) {
+  const std::string path = TestPath("unclosed.testpack");
+  {
+    absl::StatusOr<TestPackWriter> writer = TestPackWriter::Create(path);
+    ASSERT_TRUE(writer.ok()) << writer.status();
+    ASSERT_TRUE(writer->Add("adding", ExampleTests()).ok());
+  }
+  EXPECT_NE(access(path.c_str(), F_OK), 0);
+  EXPECT_NE(access(absl::StrCat(path, ".tmp").c_str(), F_OK), 0);
+}
+
+TEST(TestPackTest, RejectsOtherFiles) {
+  const std::string path = TestPath("not_a.testpack");
+  const int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  ASSERT_GE(fd, 0);
+  const std::string contents(2 * kTestPackAlignment, 'x');
+  ASSERT_EQ(write(fd, contents.data(), contents.size()), contents.size());
+  close(fd);
+  EXPECT_EQ(TestPack::Open(path).status().code(),
+            absl::StatusCode::kDataLoss);
+  EXPECT_FALSE(TestPack::Open(TestPath("missing.testpack")).ok());
+}
+
+}  // namespace
+}  // namespace deepmind::code_contests
@@ -0,0 +1,152 @@
+// Copyright 2022 DeepMind Technologies Limited
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "dataset/test_views.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "google/protobuf/duration.pb.h"
+#include "google/protobuf/io/coded_stream.h"
+#include "google/protobuf/wire_format_lite.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "absl/time/time.h"
+#include "contest_problem.pb.h"
+#include "dataset/projected_problem.h"
+#include "execution/status_macros.h"
+
+namespace deepmind::code_contests {
+
+namespace {
+
+using ::google::protobuf::internal::WireFormatLite;
+
+// Returns the payload of `field`, a single serialized length-delimited field
+// including its tag.
+absl::StatusOr<absl::string_view> Payload(const absl::string_view field) {
+  google::protobuf::io::CodedInputStream input(
+      reinterpret_cast<const uint8_t*>(field.data()), field.size());
+  uint32_t length;
+  if (WireFormatLite::GetTagWireType(input.ReadTag()) !=
+          WireFormatLite::WIRETYPE_LENGTH_DELIMITED ||
+      !input.ReadVarint32(&length)) {
+    return absl::DataLossError("Expected a length-delimited field.");
+  }
+  return field.substr(input.CurrentPosition(), length);
+}
+
+// Returns the value of `field`, a single serialized varint field including its
+// tag.
+absl::StatusOr<uint64_t> Varint(const absl::string_view field) {
+  google::protobuf::io::CodedInputStream input(
+      reinterpret_cast<const uint8_t*>(field.data()), field.size());
+  uint64_t value;
+  if (WireFormatLite::GetTagWireType(input.ReadTag()) !=
+          WireFormatLite::WIRETYPE_VARINT ||
+      !input.ReadVarint64(&value)) {
+    return absl::DataLossError("Expected a varint field.");
+  }
+  return value;
+}
+
+absl::StatusOr<TestView> ParseTest(const absl::string_view test) {
+  TestView view;
+  absl::Status field_status;
+  RETURN_IF_ERROR(internal::ForEachWireField(
+      test, [&](const int field_number, const size_t begin, const size_t end) {
+        absl::string_view* target = nullptr;
+        if (field_number == ContestProblem::Test::kInputFieldNumber) {
+          target = &view.input;
+        } else if (field_number == ContestProblem::Test::kOutputFieldNumber) {
+          target = &view.output;
+        }
+        if (target == nullptr || !field_status.ok()) return;
+        // As when parsing, the last occurrence of a field wins.
+        absl::StatusOr<absl::string_view> payload =
+            Payload(test.substr(begin, end - begin));
+        if (payload.ok()) {
+          *target = *payload;
+        } else {
+          field_status = payload.status();
+        }
+      }));
+  RETURN_IF_ERROR(field_status);
+  return view;
+}
+
+}  // namespace
+
+absl::StatusOr<ProblemTestViews> ParseTestViews(
+    const absl::string_view record) {
+  ProblemTestViews views;
+  absl::Status field_status;
+  RETURN_IF_ERROR(internal::ForEachWireField(
+      record,
+      [&](const int field_number, const size_t begin, const size_t end) {
+        if (!field_status.ok()) return;
+        const absl::string_view field = record.substr(begin, end - begin);
+        if (field_number == ContestProblem::kMemoryLimitBytesFieldNumber) {
+          absl::StatusOr<uint64_t> value = Varint(field);
+          if (value.ok()) {
+            views.memory_limit_bytes = static_cast<int64_t>(*value);
+          } else {
+            field_status = value.status();
+          }
+          return;
+        }
+        std::vector<TestView>* tests = nullptr;
+        switch (field_number) {
+          case ContestProblem::kNameFieldNumber:
+          case ContestProblem::kTimeLimitFieldNumber:
+            break;
+          case ContestProblem::kPublicTestsFieldNumber:
+            tests = &views.public_tests;
+            break;
+          case ContestProblem::kPrivateTestsFieldNumber:
+            tests = &views.private_tests;
+            break;
+          case ContestProblem::kGeneratedTestsFieldNumber:
+            tests = &views.generated_tests;
+            break;
+          default:
+            return;
+        }
+        absl::StatusOr<absl::string_view> payload = Payload(field);
+        if (!payload.ok()) {
+          field_status = payload.status();
+        } else if (field_number == ContestProblem::kTimeLimitFieldNumber) {
+          google::protobuf::Duration time_limit;
+          if (time_limit.ParseFromArray(payload->data(), payload->size())) {
+            views.time_limit = absl::Seconds(time_limit.seconds()) +
+                               absl::Nanoseconds(time_limit.nanos());
+          } else {
+            field_status = absl::DataLossError("Invalid time limit.");
+          }
+        } else if (tests == nullptr) {
+          views.name = *payload;
+        } else if (absl::StatusOr<TestView> test = ParseTest(*payload);
+                   test.ok()) {
+          tests->push_back(*test);
+        } else {
+          field_status = test.status();
+        }
+      }));
+  RETURN_IF_ERROR(field_status);
+  return views;
+}
+
+}  // namespace deepmind::code_contests
@@ -0,0 +1,55 @@
+// Copyright 2022 DeepMind Technologies Limited
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Zero-copy access to the tests of a serialized ContestProblem.
+//
+// Parsing a ContestProblem copies every test input and output into its own
+// std::string. Tools that only pass tests on, e.g. to a sandbox's stdin, can
+// instead find them in the serialized record and use them in place.
+
+#ifndef THIRD_PARTY_DEEPMIND_CODE_CONTESTS_DATASET_TEST_VIEWS_H_
+#define THIRD_PARTY_DEEPMIND_CODE_CONTESTS_DATASET_TEST_VIEWS_H_
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "absl/time/time.h"
+
+namespace deepmind::code_contests {
+
+struct TestView {
+  absl::string_view input;
+  absl::string_view output;
+};
+
+struct ProblemTestViews {
+  absl::string_view name;
+  std::vector<TestView> public_tests;
+  std::vector<TestView> private_tests;
+  std::vector<TestView> generated_tests;
+  // The problem's limits, if it has any.
+  std::optional<absl::Duration> time_limit;
+  std::optional<int64_t> memory_limit_bytes;
+};
+
+// Finds the name, tests and limits of the serialized ContestProblem `record`,
+// without parsing any other field. The views point into `record`.
+absl::StatusOr<ProblemTestViews> ParseTestViews(absl::string_view record);
+
+}  // namespace deepmind::code_contests
+
+#endif  // THIRD_PARTY_DEEPMIND_CODE_CONTESTS_DATASET_TEST_VIEWS_H_
@@ -0,0 +1,77 @@
+// Copyright 2022 DeepMind Technologies Limited
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "dataset/test_views.h"
+
+#include <cstdint>
+#include <optional>
+#include <string>
+
+#include "gtest/gtest.h"
+#include "absl/time/time.h"
+#include "contest_problem.pb.h"
+
+namespace deepmind::code_contests {
+namespace {
+
+TEST(ParseTestViewsTest, FindsTestsInPlace) {
+  ContestProblem problem;
+  problem.set_name("123_X. Adding integers");
+  problem.set_description("Add integers together to get a sum.");
+  ContestProblem::Test* test = problem.add_public_tests();
+  test->set_input("1 2\n");
+  test->set_output("3");
+  problem.add_private_tests()->set_input("5 6\n");
+  problem.add_generated_tests()->set_output("19");
+  problem.add_generated_tests()->set_output("23");
+  problem.mutable_time_limit()->set_seconds(2);
+  problem.mutable_time_limit()->set_nanos(500000000);
+  problem.set_memory_limit_bytes(int64_t{256} << 20);
+  const std::string record = problem.SerializeAsString();
+
+  absl::StatusOr<ProblemTestViews> views = ParseTestViews(record);
+  ASSERT_TRUE(views.ok()) << views.status();
+  EXPECT_EQ(views->name, "123_X. Adding integers");
+  ASSERT_EQ(views->public_tests.size(), 1);
+  EXPECT_EQ(views->public_tests[0].input, "1 2\n");
+  EXPECT_EQ(views->public_tests[0].output, "3");
+  ASSERT_EQ(views->private_tests.size(), 1);
+  EXPECT_EQ(views->private_tests[0].input, "5 6\n");
+  EXPECT_TRUE(views->private_tests[0].output.empty());
+  ASSERT_EQ(views->generated_tests.size(), 2);
+  EXPECT_EQ(views->generated_tests[1].output, "23");
+  EXPECT_EQ(views->time_limit, absl::Milliseconds(2500));
+  EXPECT_EQ(views->memory_limit_bytes, int64_t{256} << 20);
+  // The views point into the record rather than into copies.
+  EXPECT_GE(views->public_tests[0].input.data(), record.data());
+  EXPECT_LT(views->public_tests[0].input.data(),
+            record.data() + record.size());
+}
+
+TEST(ParseTestViewsTest, LeavesMissingLimitsUnset) {
+  ContestProblem problem;
+  problem.set_name("no limits");
+  absl::StatusOr<ProblemTestViews> views =
+      ParseTestViews(problem.SerializeAsString());
+  ASSERT_TRUE(views.ok()) << views.status();
+  EXPECT_EQ(views->time_limit, std::nullopt);
+  EXPECT_EQ(views->memory_limit_bytes, std::nullopt);
+}
+
+TEST(ParseTestViewsTest, RejectsMalformedRecord) {
+  EXPECT_FALSE(ParseTestViews("\x12\x10truncated").ok());
+}
+
+}  // namespace
+}  // namespace deepmind::code_contests
@@ -0,0 +1,328 @@
+// Copyright 2022 DeepMind Technologies Limited
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "execution/candidate_solutions.h"
+
+#include <stdio.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_set.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/match.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "execution/json.hpp"
+#include "execution/status_macros.h"
+
+namespace deepmind::code_contests {
+
+namespace {
+
+using json = nlohmann::json;
+
+// Adds generations to a CandidateIndex as they are parsed. Generations are
+// either the elements of lists in a top-level object, keyed by path, or the
+// top-level value itself, as on every line of a JSONL file.
+class CandidateSaxHandler : public nlohmann::json_sax<json> {
+ public:
+  // `path` is the path of generations that are not listed under a key.
+  CandidateSaxHandler(CandidateIndex& index, const bool keyed_by_path,
+                      std::string path)
+      : index_(index),
+        generation_depth_(keyed_by_path ? 2 : 0),
+        path_(std::move(path)) {}
+
+  const absl::Status& status() const { return status_; }
+
+  bool null() override { return Scalar(nullptr); }
+  bool boolean(bool) override { return Scalar(nullptr); }
+  bool number_integer(number_integer_t value) override {
+    return Number(value);
+  }
+  bool number_unsigned(number_unsigned_t value) override {
+    return Number(value);
+  }
+  bool number_float(number_float_t value, const string_t&) override {
+    return Number(value);
+  }
+  bool string(string_t& value) override { return Scalar(&value); }
+  bool binary(binary_t&) override { return Scalar(nullptr); }
+
+  bool start_object(std::size_t) override {
+    if (skipping()) return Enter();
+    if (depth_ == generation_depth_) {
+      id_.reset();
+      completions_.clear();
+      has_completions_ = false;
+      scores_.clear();
+      has_scores_ = false;
+      return Enter();
+    }
+    if (depth_ == 0) return Enter();
+    if (depth_ == generation_depth_ + 1) return Skip();
+    return Fail(Unexpected());
+  }
+
+  bool end_object() override {
+    --depth_;
+    if (depth_ == skip_depth_) skip_depth_ = -1;
+    if (skipping() || depth_ != generation_depth_) return true;
+    if (!id_.has_value() || !has_completions_) {
+      return Fail(absl::StrCat(
+          "Generation under ", path_,
+          " needs an \"id\" and a list of \"model_completions\"."));
+    }
+    if (has_scores_ && scores_.size() != completions_.size()) {
+      return Fail(absl::StrCat("Generation for ", *id_, " has ",
+                               completions_.size(), " completions but ",
+                               scores_.size(), " scores."));
+    }
+    for (int i = 0; i < completions_.size(); ++i) {
+      CandidateSolution candidate{.id = *id_,
+                                  .generated = std::move(completions_[i]),
+                                  .path = path_};
+      if (has_scores_) candidate.score = scores_[i];
+      index_.Add(std::move(candidate));
+    }
+    completions_.clear();
+    return true;
+  }
+
+  bool start_array(std::size_t) override {
+    if (skipping()) return Enter();
+    if (depth_ == generation_depth_ - 1 && depth_ > 0) return Enter();
+    if (depth_ == generation_depth_ + 1) {
+      if (key_ == "model_completions") {
+        has_completions_ = true;
+      } else if (key_ == "scores") {
+        has_scores_ = true;
+      } else {
+        return Skip();
+      }
+      return Enter();
+    }
+    return Fail(Unexpected());
+  }
+
+  bool end_array() override {
+    --depth_;
+    if (depth_ == skip_depth_) skip_depth_ = -1;
+    return true;
+  }
+
+  bool key(string_t& key) override {
+    if (skipping()) return true;
+    if (depth_ == 1 && generation_depth_ > 0) {
+      path_ = std::move(key);
+    } else {
+      key_ = std::move(key);
+    }
+    return true;
+  }
+
+  bool parse_error(std::size_t position, const std::string&,
+                   const nlohmann::detail::exception& error) override {
+    return Fail(absl::StrCat("Invalid JSON at byte ", position, ": ",
+                             error.what()));
+  }
+
+ private:
+  bool skipping() const { return skip_depth_ >= 0; }
+
+  bool Enter() {
+    ++depth_;
+    return true;
+  }
+
+  // Skips the structure that starts here, as the value of an unknown field.
+  bool Skip() {
+    skip_depth_ = depth_;
+    return Enter();
+  }
+
+  bool Scalar(string_t* value) {
+    if (skipping()) return true;
+    if (depth_ == generation_depth_ + 1) {
+      if (key_ != "id") return true;
+      if (value == nullptr) return Fail("Generation \"id\" is not a string.");
+      id_ = std::move(*value);
+      return true;
+    }
+    if (depth_ == generation_depth_ + 2) {
+      if (key_ == "scores") {
+        return Fail(absl::StrCat("Score for ", id_.value_or("unknown"),
+                                 " is not a number."));
+      }
+      if (value == nullptr) {
+        return Fail(absl::StrCat("Completion for ", id_.value_or("unknown"),
+                                 " is not a string."));
+      }
+      completions_.push_back(std::move(*value));
+      return true;
+    }
+    return Fail(Unexpected());
+  }
+
+  bool Number(const double value) {
+    if (!skipping() && depth_ == generation_depth_ + 2 && key_ == "scores") {
+      scores_.push_back(value);
+      return true;
+    }
+    return Scalar(nullptr);
+  }
+
+  std::string Unexpected() const {
+    if (depth_ == 0) return "Expected a JSON object.";
+    if (depth_ == generation_depth_ - 1) {
+      return absl::StrCat("Generations for ", path_, " are not a list.");
+    }
+    return absl::StrCat("Unexpected value under ", path_, ".");
+  }
+
+  bool Fail(absl::string_view message) {
+    if (status_.ok()) status_ = absl::InvalidArgumentError(message);
+    return false;
+  }
+
+  CandidateIndex& index_;
+  // The depth of generation objects. Nesting starts at 0 outside any value.
+  const int generation_depth_;
+  std::string path_;
+  int depth_ = 0;
+  // The depth that skipping ends at, or -1 if nothing is being skipped.
+  int skip_depth_ = -1;
+  // The last key within a generation.
+  std::string key_;
+  std::optional<std::string> id_;
+  std::vector<std::string> completions_;
+  bool has_completions_ = false;
+  std::vector<double> scores_;
+  bool has_scores_ = false;
+  absl::Status status_;
+};
+
+absl::Status ParseKeyedJson(const std::string& path, CandidateIndex& index) {
+  FILE* const file = fopen(path.c_str(), "r");
+  if (file == nullptr) {
+    return absl::NotFoundError(absl::StrCat("Unable to open ", path));
+  }
+  // Read in large blocks, as the parser takes a byte at a time.
+  std::vector<char> buffer(1 << 20);
+  setvbuf(file, buffer.data(), _IOFBF, buffer.size());
+  CandidateSaxHandler handler(index, /*keyed_by_path=*/true, "");
+  const bool parsed = json::sax_parse(file, &handler);
+  fclose(file);
+  if (!parsed) {
+    RETURN_IF_ERROR(handler.status());
+    return absl::InvalidArgumentError(absl::StrCat("Unable to parse ", path));
+  }
+  return absl::OkStatus();
+}
+
+absl::Status ParseJsonLines(const std::string& path, CandidateIndex& index) {
+  std::ifstream input(path);
+  if (!input) {
+    return absl::NotFoundError(absl::StrCat("Unable to open ", path));
+  }
+  std::string line;
+  for (int line_number = 1; std::getline(input, line); ++line_number) {
+    if (line.find_first_not_of(" \t\r") == std::string::npos) continue;
+    CandidateSaxHandler handler(index, /*keyed_by_path=*/false, path);
+    if (!json::sax_parse(line, &handler)) {
+      return absl::InvalidArgumentError(
+          absl::StrCat(path, ":", line_number, ": ", handler.status().message()));
+    }
+  }
+  if (input.bad()) {
+    return absl::DataLossError(absl::StrCat("Unable to read ", path));
+  }
+  return absl::OkStatus();
+}
+
+}  // namespace
+
+void CandidateIndex::Add(CandidateSolution candidate) {
+  const auto [it, inserted] =
+      index_by_name_.try_emplace(candidate.id, problems_.size());
+  if (inserted) {
+    problems_.push_back({.name = candidate.id});
+  }
+  problems_[it->second].candidates.push_back(std::move(candidate));
+  ++num_candidates_;
+}
+
+ProblemCandidates* CandidateIndex::Find(const absl::string_view name) {
+  const auto it = index_by_name_.find(name);
+  if (it == index_by_name_.end()) return nullptr;
+  ProblemCandidates& problem = problems_[it->second];
+  problem.found = true;
+  return &problem;
+}
+
+absl::flat_hash_set<std::string> CandidateIndex::Names() const {
+  absl::flat_hash_set<std::string> names;
+  names.reserve(problems_.size());
+  for (const ProblemCandidates& problem : problems_) {
+    names.insert(problem.name);
+  }
+  return names;
+}
+
+std::vector<const ProblemCandidates*> CandidateIndex::Unfound() const {
+  std::vector<const ProblemCandidates*> unfound;
+  for (const ProblemCandidates& problem : problems_) {
+    if (!problem.found) unfound.push_back(&problem);
+  }
+  return unfound;
+}
+
+double CandidateLoadStats::MegabytesPerSecond() const {
+  const double seconds = absl::ToDoubleSeconds(duration);
+  return seconds > 0 ? bytes / seconds / (1 << 20) : 0;
+}
+
+absl::StatusOr<CandidateIndex> LoadCandidates(const absl::string_view path,
+                                              CandidateLoadStats* stats) {
+  const absl::Time start = absl::Now();
+  const std::string path_string(path);
+  CandidateIndex index;
+  if (absl::EndsWith(path, ".jsonl")) {
+    RETURN_IF_ERROR(ParseJsonLines(path_string, index));
+  } else {
+    RETURN_IF_ERROR(ParseKeyedJson(path_string, index));
+  }
+  if (stats != nullptr) {
+    stats->duration = absl::Now() - start;
+    struct stat st;
+    stats->bytes = stat(path_string.c_str(), &st) == 0 ? st.st_size : 0;
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    stats->peak_rss_bytes = int64_t{usage.ru_maxrss} * 1024;
+  }
+  return index;
+}
+
+}  // namespace deepmind::code_contests
@@ -0,0 +1,124 @@
+// Copyright 2022 DeepMind Technologies Limited
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Generated candidate solutions to evaluate, grouped by problem.
+//
+// Evaluation reads the dataset once and looks up the candidates of every
+// problem it reads. Candidates are therefore indexed by problem name when they
+// are loaded, so that each lookup is a single hash probe and candidates are
+// never copied after loading.
+//
+// Files of candidates can be several gigabytes, so they are parsed as a stream
+// of events rather than into a document: only the generation being read is
+// held besides the index itself.
+
+#ifndef THIRD_PARTY_DEEPMIND_CODE_CONTESTS_EXECUTION_CANDIDATE_SOLUTIONS_H_
+#define THIRD_PARTY_DEEPMIND_CODE_CONTESTS_EXECUTION_CANDIDATE_SOLUTIONS_H_
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "absl/time/time.h"
+#include "absl/types/span.h"
+
+namespace deepmind::code_contests {
+
+struct CandidateSolution {
+  // The name of the problem the candidate was generated for.
+  std::string id;
+  std::string generated;
+  // The key of the input file the candidate was listed under.
+  std::string path;
+  // The model's score for the candidate, if the input has one. Higher is
+  // better.
+  std::optional<double> score;
+  bool evaluated = false;
+  bool passed = false;
+};
+
+// The candidates of a single problem.
+struct ProblemCandidates {
+  std::string name;
+  std::vector<CandidateSolution> candidates;
+  // Whether the problem has been found in the dataset.
+  bool found = false;
+};
+
+// Candidates grouped by problem name, in order of first appearance. Move-only,
+// as copying it would copy every candidate.
+class CandidateIndex {
+ public:
+  CandidateIndex() = default;
+  CandidateIndex(CandidateIndex&&) = default;
+  CandidateIndex& operator=(CandidateIndex&&) = default;
+  CandidateIndex(const CandidateIndex&) = delete;
+  CandidateIndex& operator=(const CandidateIndex&) = delete;
+
+  void Add(CandidateSolution candidate);
+
+  // Returns the candidates for the problem called `name` and marks it as found,
+  // or returns nullptr if there are none.
+  ProblemCandidates* Find(absl::string_view name);
+
+  // The problems with candidates, in order of first appearance.
+  absl::Span<ProblemCandidates> problems() { return absl::MakeSpan(problems_); }
+  absl::Span<const ProblemCandidates> problems() const { return problems_; }
+
+  // Returns the names of all problems with candidates.
+  absl::flat_hash_set<std::string> Names() const;
+
+  // Returns the problems that have candidates but were never found.
+  std::vector<const ProblemCandidates*> Unfound() const;
+
+  int num_candidates() const { return num_candidates_; }
+
+ private:
+  std::vector<ProblemCandidates> problems_;
+  absl::flat_hash_map<std::string, int> index_by_name_;
+  int num_candidates_ = 0;
+};
+
+struct CandidateLoadStats {
+  int64_t bytes = 0;
+  absl::Duration duration;
+  // The peak resident set size of the whole process once loading finished.
+  int64_t peak_rss_bytes = 0;
+
+  double MegabytesPerSecond() const;
+};
+
+// Loads candidates from a file of generations of the form
+// {"id": <problem name>, "model_completions": [<solution>, ...]}. A generation
+// may also list "scores", one number per completion, which are kept as the
+// candidates' `score`. Other fields of generations are skipped.
+//
+// Files ending in ".jsonl" hold one generation per line, and their candidates
+// take the file's path as `path`. Other files hold a JSON object that maps
+// keys, such as the paths of the files that generations were read from, to
+// lists of generations.
+//
+// If `stats` is not null, it is set to the size of the file and the time it
+// took to load.
+absl::StatusOr<CandidateIndex> LoadCandidates(
+    absl::string_view path, CandidateLoadStats* stats = nullptr);
+
+}  // namespace deepmind::code_contests
+
+#endif  // THIRD_PARTY_DEEPMIND_CODE_CONTESTS_EXECUTION_CANDIDATE_SOLUTIONS_H_
@@ -0,0 +1,175 @@
+// Copyright 2022 DeepMind Technologies Limited
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "execution/candidate_solutions.h"
+
+#include <fstream>
+#include <optional>
+#include <string>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+
+namespace deepmind::code_contests {
+namespace {
+
+using ::testing::ElementsAre;
+using ::testing::Field;
+using ::testing::Pointee;
+using ::testing::UnorderedElementsAre;
+
+std::string WriteJson(const absl::string_view name,
+                      const absl::string_view contents) {
+  const std::string path = absl::StrCat(testing::TempDir(), "/", name);
+  std::ofstream(path) << contents;
+  return path;
+}
+
+TEST(CandidateIndexTest, GroupsCandidatesByProblem) {
+  CandidateIndex index;
+  index.Add({.id = "b", .generated = "print(1)"});
+  index.Add({.id = "a", .generated = "print(2)"});
+  index.Add({.id = "b", .generated = "print(3)"});
+  EXPECT_EQ(index.num_candidates(), 3);
+  EXPECT_THAT(index.Names(), UnorderedElementsAre("a", "b"));
+  ASSERT_EQ(index.problems().size(), 2);
+  EXPECT_EQ(index.problems()[0].name, "b");
+
+  const ProblemCandidates* b = index.Find("b");
+  ASSERT_NE(b, nullptr);
+  EXPECT_THAT(b->candidates,
+              ElementsAre(Field(&CandidateSolution::generated, "print(1)"),
+                          Field(&CandidateSolution::generated, "print(3)")));
+  EXPECT_EQ(index.Find("c"), nullptr);
+  EXPECT_THAT(index.Unfound(),
+              ElementsAre(Pointee(Field(&ProblemCandidates::name, "a"))));
+}
+
+TEST(CandidateIndexTest, LoadsJson) {
+  const std::string path = WriteJson("candidates.json", R"json({
+    "first.jsonl": [{"id": "a", "model_completions": ["x", "y"]}],
+    "second.jsonl": [{"id": "a", "model_completions": ["z"]},
+                     {"id": "b", "model_completions": []}]
+  })json");
+  absl::StatusOr<CandidateIndex> index = LoadCandidates(path);
+  ASSERT_TRUE(index.ok()) << index.status();
+  EXPECT_EQ(index->num_candidates(), 3);
+  const ProblemCandidates* a = index->Find("a");
+  ASSERT_NE(a, nullptr);
+  EXPECT_THAT(a->candidates,
+              ElementsAre(Field(&CandidateSolution::path, "first.jsonl"),
+                          Field(&CandidateSolution::path, "first.jsonl"),
+                          Field(&CandidateSolution::path, "second.jsonl")));
+  // Problems without completions have nothing to evaluate.
+  EXPECT_EQ(index->Find("b"), nullptr);
+}
+
+TEST(CandidateIndexTest, SkipsOtherFields) {
+  const std::string path = WriteJson("other_fields.json", R"json({
+    "first.jsonl": [{"model_completions": ["x"],
+                     "scores": {"logprob": [-1.5, {"nested": null}]},
+                     "id": "a", "temperature": 0.5}]
+  })json");
+  absl::StatusOr<CandidateIndex> index = LoadCandidates(path);
+  ASSERT_TRUE(index.ok()) << index.status();
+  const ProblemCandidates* a = index->Find("a");
+  ASSERT_NE(a, nullptr);
+  EXPECT_THAT(a->candidates,
+              ElementsAre(Field(&CandidateSolution::generated, "x")));
+}
+
+TEST(CandidateIndexTest, LoadsScores) {
+  const std::string path = WriteJson("scores.jsonl",
+                                     R"({"id": "a", "model_completions": ["x", "y"], "scores": [-0.5, 2]}
+{"id": "a", "model_completions": ["z"]}
+)");
+  absl::StatusOr<CandidateIndex> index = LoadCandidates(path);
+  ASSERT_TRUE(index.ok()) << index.status();
+  const ProblemCandidates* a = index->Find("a");
+  ASSERT_NE(a, nullptr);
+  EXPECT_THAT(a->candidates,
+              ElementsAre(Field(&CandidateSolution::score, -0.5),
+                          Field(&CandidateSolution::score, 2.0),
+                          Field(&CandidateSolution::score, std::nullopt)));
+
+  EXPECT_EQ(LoadCandidates(WriteJson("missing_score.jsonl",
+                                     R"({"id": "a", "model_completions": ["x", "y"], "scores": [1]})"))
+                .status()
+                .code(),
+            absl::StatusCode::kInvalidArgument);
+  EXPECT_EQ(LoadCandidates(WriteJson("string_score.jsonl",
+                                     R"({"id": "a", "model_completions": ["x"], "scores": ["1"]})"))
+                .status()
+                .code(),
+            absl::StatusCode::kInvalidArgument);
+}
+
+TEST(CandidateIndexTest, LoadsJsonLines) {
+  const std::string path = WriteJson("candidates.jsonl",
+                                     R"({"id": "a", "model_completions": ["x"]}
+{"id": "b", "model_completions": ["y", "z"]}
+
+{"id": "a", "model_completions": ["w"]}
+)");
+  CandidateLoadStats stats;
+  absl::StatusOr<CandidateIndex> index = LoadCandidates(path, &stats);
+  ASSERT_TRUE(index.ok()) << index.status();
+  EXPECT_EQ(index->num_candidates(), 4);
+  const ProblemCandidates* a = index->Find("a");
+  ASSERT_NE(a, nullptr);
+  EXPECT_THAT(a->candidates,
+              ElementsAre(Field(&CandidateSolution::generated, "x"),
+                          Field(&CandidateSolution::generated, "w")));
+  EXPECT_EQ(a->candidates[0].path, path);
+  EXPECT_GT(stats.bytes, 0);
+  EXPECT_GT(stats.peak_rss_bytes, 0);
+
+  EXPECT_EQ(LoadCandidates(WriteJson("bad_line.jsonl",
+                                     "{\"id\": \"a\", \"model_completions\": []}\n"
+                                     "[\"a\"]\n"))
+                .status()
+                .code(),
+            absl::StatusCode::kInvalidArgument);
+}
+
+TEST(CandidateIndexTest, RejectsMalformedJson) {
+  EXPECT_EQ(LoadCandidates(WriteJson("truncated.json", R"({"a": [)"))
+                .status()
+                .code(),
+            absl::StatusCode::kInvalidArgument);
+  EXPECT_EQ(LoadCandidates(WriteJson("no_id.json",
+                                     R"({"a": [{"model_completions": []}]})"))
+                .status()
+                .code(),
+            absl::StatusCode::kInvalidArgument);
+  EXPECT_EQ(LoadCandidates(WriteJson("not_a_list.json", R"({"a": {}})"))
+                .status()
+                .code(),
+            absl::StatusCode::kInvalidArgument);
+  EXPECT_EQ(LoadCandidates(WriteJson("not_strings.json",
+                                     R"({"a": [{"id": "b",
+                                               "model_completions": [1]}]})"))
+                .status()
+                .code(),
+            absl::StatusCode::kInvalidArgument);
+  EXPECT_EQ(LoadCandidates("/nonexistent/candidates.json").status().code(),
+            absl::StatusCode::kNotFound);
+}
+
+}  // namespace
+}  // namespace deepmind::code_contests
@@ -0,0 +1,226 @@
+// Copyright 2022 DeepMind Technologies Limited
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "execution/output_collector.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>  // NOLINT(build/c++11)
+#include <utility>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/substitute.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/types/span.h"
+
+namespace deepmind::code_contests {
+
+namespace {
+
+// As large as a pipe's buffer by default, so that a full pipe is drained with
+// a single read.
+constexpr int64_t kReadBufferSize = 64 << 10;
+constexpr int kMaxEvents = 64;
+
+}  // namespace
+
+struct OutputCollector::Collection::State {
+  bool Done() const ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex) {
+    return remaining == 0;
+  }
+
+  // Marks a file descriptor as read, or as failed to be.
+  void Finish(const absl::Status& read_status) {
+    absl::MutexLock l(&mutex);
+    if (status.ok()) status = read_status;
+    --remaining;
+  }
+
+  // Only written by the collector's thread until every file descriptor has
+  // been read.
+  std::vector<std::string> contents;
+  OutputCollector::ChunkCallback on_chunk;
+  absl::Mutex mutex;
+  int remaining ABSL_GUARDED_BY(mutex) = 0;
+  absl::Status status ABSL_GUARDED_BY(mutex);
+  bool awaited ABSL_GUARDED_BY(mutex) = false;
+};
+
+struct OutputCollector::Stream {
+  std::shared_ptr<Collection::State> state;
+  int index;
+  int fd;
+};
+
+OutputCollector::Collection::Collection(std::shared_ptr<State> state)
+    : state_(std::move(state)) {}
+
+OutputCollector::Collection::~Collection() {
+  if (state_ == nullptr) return;
+  absl::MutexLock l(&state_->mutex);
+  if (!state_->awaited) {
+    state_->mutex.Await(absl::Condition(state_.get(), &State::Done));
+  }
+}
+
+absl::StatusOr<std::vector<std::string>> OutputCollector::Collection::Await() {
+  absl::MutexLock l(&state_->mutex);
+  state_->mutex.Await(absl::Condition(state_.get(), &State::Done));
+  state_->awaited = true;
+  if (!state_->status.ok()) return state_->status;
+  return std::move(state_->contents);
+}
+
+OutputCollector::OutputCollector() {
+  epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+  if (epoll_fd_ < 0) {
+    init_status_ = absl::UnknownError(
+        absl::Substitute("epoll_create1 failed with errno $0", errno));
+    return;
+  }
+  wakeup_fd_ = eventfd(0, EFD_CLOEXEC);
+  epoll_event event = {.events = EPOLLIN, .data = {.ptr = nullptr}};
+  if (wakeup_fd_ < 0 ||
+      epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, wakeup_fd_, &event) != 0) {
+    init_status_ = absl::UnknownError(absl::Substitute(
+        "Creating the collector's wakeup fd failed with errno $0", errno));
+    return;
+  }
+  thread_ = std::thread(&OutputCollector::Loop, this);
+}
+
+OutputCollector::~OutputCollector() {
+  if (thread_.joinable()) {
+    const uint64_t one = 1;
+    (void)write(wakeup_fd_, &one, sizeof(one));
+    thread_.join();
+  }
+  if (wakeup_fd_ >= 0) close(wakeup_fd_);
+  if (epoll_fd_ >= 0) close(epoll_fd_);
+}
+
+OutputCollector& OutputCollector::Shared() {
+  static OutputCollector* const collector = new OutputCollector();
+  return *collector;
+}
+
+absl::StatusOr<OutputCollector::Collection> OutputCollector::Collect(
+    absl::Span<const int> fds, ChunkCallback on_chunk) {
+  if (!init_status_.ok()) return init_status_;
+  {
+    absl::MutexLock l(&mutex_);
+    if (!loop_status_.ok()) return loop_status_;
+  }
+  auto state = std::make_shared<Collection::State>();
+  state->contents.resize(fds.size());
+  state->on_chunk = std::move(on_chunk);
+  {
+    absl::MutexLock l(&state->mutex);
+    state->remaining = fds.size();
+  }
+  for (int i = 0; i < fds.size(); ++i) {
+    const int flags = fcntl(fds[i], F_GETFL);
+    if (flags < 0 || fcntl(fds[i], F_SETFL, flags | O_NONBLOCK) != 0) {
+      state->Finish(absl::UnknownError(absl::Substitute(
+          "Making FD $0 non-blocking failed with errno $1", fds[i], errno)));
+      continue;
+    }
+    auto stream = std::make_unique<Stream>(
+        Stream{.state = state, .index = i, .fd = fds[i]});
+    epoll_event event = {.events = EPOLLIN, .data = {.ptr = stream.get()}};
+    // Registered with the lock held, so that the thread cannot finish the
+    // stream before it is recorded, nor fail streams without it.
+    absl::MutexLock l(&mutex_);
+    if (!loop_status_.ok()) {
+      state->Finish(loop_status_);
+      continue;
+    }
+    if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fds[i], &event) != 0) {
+      state->Finish(absl::UnknownError(absl::Substitute(
+          "Adding FD $0 to epoll failed with errno $1", fds[i], errno)));
+      continue;
+    }
+    // Owned by the collector from now on.
+    streams_.insert(stream.release());
+  }
+  return Collection(std::move(state));
+}
+
+void OutputCollector::Loop() {
+  // Every read goes through the same buffer, so reading allocates nothing
+  // beyond the contents themselves.
+  const auto buffer = std::make_unique<char[]>(kReadBufferSize);
+  epoll_event events[kMaxEvents];
+  for (;;) {
+    const int num_events = epoll_wait(epoll_fd_, events, kMaxEvents, -1);
+    if (num_events < 0) {
+      if (errno == EINTR) continue;
+      FailStreams(absl::UnknownError(
+          absl::Substitute("epoll_wait failed with errno $0", errno)));
+      return;
+    }
+    for (int i = 0; i < num_events; ++i) {
+      Stream* const stream = static_cast<Stream*>(events[i].data.ptr);
+      if (stream == nullptr) return;
+      // Streams are level-triggered, so one read per event is enough, and
+      // leaves no stream waiting on a busy one.
+      const ssize_t n = read(stream->fd, buffer.get(), kReadBufferSize);
+      if (n > 0) {
+        stream->state->contents[stream->index].append(buffer.get(), n);
+        if (stream->state->on_chunk == nullptr ||
+            stream->state->on_chunk(stream->index,
+                                    absl::string_view(buffer.get(), n))) {
+          continue;
+        }
+      } else if (n < 0 && (errno == EAGAIN || errno == EINTR)) {
+        continue;
+      }
+      const absl::Status read_status =
+          n >= 0 ? absl::OkStatus()
+                 : absl::UnknownError(absl::Substitute(
+                       "Reading FD $0 failed with errno $1", stream->fd, errno));
+      absl::MutexLock l(&mutex_);
+      streams_.erase(stream);
+      FinishStream(stream, read_status);
+    }
+  }
+}
+
+void OutputCollector::FinishStream(Stream* const stream,
+                                   const absl::Status& read_status) {
+  epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, stream->fd, nullptr);
+  stream->state->Finish(read_status);
+  delete stream;
+}
+
+void OutputCollector::FailStreams(const absl::Status& error) {
+  absl::MutexLock l(&mutex_);
+  loop_status_ = error;
+  for (Stream* const stream : streams_) {
+    FinishStream(stream, error);
+  }
+  streams_.clear();
+}
+
+}  // namespace deepmind::code_contests
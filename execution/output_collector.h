@@ -0,0 +1,116 @@
+// Copyright 2022 DeepMind Technologies Limited
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Reading the outputs of sandboxed programs.
+//
+// A program's stdout and stderr have to be read concurrently, and while it
+// runs, as it blocks once a pipe is full. Rather than reading each of them on
+// a thread of its own, an OutputCollector reads the outputs of all running
+// programs on a single thread, which waits for any of them to be readable
+// with epoll.
+
+#ifndef THIRD_PARTY_DEEPMIND_CODE_CONTESTS_EXECUTION_OUTPUT_COLLECTOR_H_
+#define THIRD_PARTY_DEEPMIND_CODE_CONTESTS_EXECUTION_OUTPUT_COLLECTOR_H_
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>  // NOLINT(build/c++11)
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/types/span.h"
+
+namespace deepmind::code_contests {
+
+class OutputCollector {
+ public:
+  // The outputs being read from a set of file descriptors.
+  class Collection {
+   public:
+    struct State;
+
+    explicit Collection(std::shared_ptr<State> state);
+    Collection(const Collection&) = delete;
+    Collection& operator=(const Collection&) = delete;
+    Collection(Collection&&) = default;
+    Collection& operator=(Collection&&) = default;
+    // Waits for reading to finish, if Await was not called.
+    ~Collection();
+
+    // Waits until every file descriptor has been read to the end of the file,
+    // and returns their contents, in the order they were passed to Collect.
+    // May only be called once.
+    absl::StatusOr<std::vector<std::string>> Await();
+
+   private:
+    std::shared_ptr<State> state_;
+  };
+
+  // Starts the thread that reads outputs.
+  OutputCollector();
+  OutputCollector(const OutputCollector&) = delete;
+  OutputCollector& operator=(const OutputCollector&) = delete;
+  // Stops the thread. Collections must have finished.
+  ~OutputCollector();
+
+  // Called on the collector's thread with each chunk read from the file
+  // descriptor at `index`, after it was added to its contents. Returning false
+  // stops reading that file descriptor, as if it had ended.
+  using ChunkCallback =
+      std::function<bool(int index, absl::string_view chunk)>;
+
+  // A collector shared by the whole process.
+  static OutputCollector& Shared();
+
+  // Starts reading `fds` until the end of the file. The caller keeps ownership
+  // of `fds`, and must not close them until the collection has finished.
+  // `on_chunk` may be null, and must return quickly, as it holds up reading
+  // the outputs of every other program. Fails if the collector's thread has
+  // stopped after an error.
+  absl::StatusOr<Collection> Collect(absl::Span<const int> fds,
+                                     ChunkCallback on_chunk = nullptr);
+
+ private:
+  // A file descriptor that is being read, registered with epoll.
+  struct Stream;
+
+  void Loop();
+  // Stops reading `stream`, which has ended or failed, and deletes it.
+  void FinishStream(Stream* stream, const absl::Status& read_status);
+  // Fails every stream that is still being read, once the thread stops after
+  // `error`.
+  void FailStreams(const absl::Status& error);
+
+  // Set if the epoll or wakeup file descriptors could not be created.
+  absl::Status init_status_;
+  absl::Mutex mutex_;
+  // Set once the thread stopped after an error.
+  absl::Status loop_status_ ABSL_GUARDED_BY(mutex_);
+  // The streams registered with epoll, owned by the collector.
+  absl::flat_hash_set<Stream*> streams_ ABSL_GUARDED_BY(mutex_);
+  int epoll_fd_ = -1;
+  // Written to stop the thread.
+  int wakeup_fd_ = -1;
+  std::thread thread_;
+};
+
+}  // namespace deepmind::code_contests
+
+#endif  // THIRD_PARTY_DEEPMIND_CODE_CONTESTS_EXECUTION_OUTPUT_COLLECTOR_H_
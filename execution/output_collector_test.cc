@@ -0,0 +1,118 @@
+// Copyright 2022 DeepMind Technologies Limited
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "execution/output_collector.h"
+
+#include <unistd.h>
+
+#include <string>
+#include <thread>  // NOLINT(build/c++11)
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+
+namespace deepmind::code_contests {
+namespace {
+
+using ::testing::ElementsAre;
+
+struct Pipe {
+  Pipe() { EXPECT_EQ(pipe(fds), 0); }
+  ~Pipe() {
+    CloseWrite();
+    close(fds[0]);
+  }
+  void Write(const std::string& data) {
+    ASSERT_EQ(write(fds[1], data.data(), data.size()), data.size());
+  }
+  void CloseWrite() {
+    if (fds[1] >= 0) close(fds[1]);
+    fds[1] = -1;
+  }
+  int fds[2];
+};
+
+TEST(OutputCollectorTest, ReadsUntilEndOfFile) {
+  OutputCollector collector;
+  Pipe out, err;
+  absl::StatusOr<OutputCollector::Collection> collection =
+      collector.Collect({out.fds[0], err.fds[0]});
+  ASSERT_TRUE(collection.ok()) << collection.status();
+  // More than fits in a pipe, so the writer blocks until it is read.
+  const std::string large(1 << 20, 'x');
+  std::thread writer([&] {
+    out.Write(large);
+    err.Write("error\n");
+    out.CloseWrite();
+    err.CloseWrite();
+  });
+  absl::StatusOr<std::vector<std::string>> contents = collection->Await();
+  writer.join();
+  ASSERT_TRUE(contents.ok()) << contents.status();
+  EXPECT_THAT(*contents, ElementsAre(large, "error\n"));
+}
+
+TEST(OutputCollectorTest, CollectsConcurrently) {
+  OutputCollector& collector = OutputCollector::Shared();
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 8; ++i) {
+    threads.emplace_back([&collector, i] {
+      Pipe pipe;
+      absl::StatusOr<OutputCollector::Collection> collection =
+          collector.Collect({pipe.fds[0]});
+      ASSERT_TRUE(collection.ok()) << collection.status();
+      const std::string data(1000 * (i + 1), 'a' + i);
+      pipe.Write(data);
+      pipe.CloseWrite();
+      absl::StatusOr<std::vector<std::string>> contents = collection->Await();
+      ASSERT_TRUE(contents.ok()) << contents.status();
+      EXPECT_THAT(*contents, ElementsAre(data));
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+}
+
+TEST(OutputCollectorTest, StopsReadingWhenCallbackReturnsFalse) {
+  OutputCollector collector;
+  Pipe pipe;
+  std::vector<int> indices;
+  absl::StatusOr<OutputCollector::Collection> collection = collector.Collect(
+      {pipe.fds[0]}, [&](const int index, const absl::string_view chunk) {
+        indices.push_back(index);
+        return chunk.find('!') == absl::string_view::npos;
+      });
+  ASSERT_TRUE(collection.ok()) << collection.status();
+  pipe.Write("stop!");
+  // The write end stays open, so this only returns because reading stopped.
+  absl::StatusOr<std::vector<std::string>> contents = collection->Await();
+  ASSERT_TRUE(contents.ok()) << contents.status();
+  EXPECT_THAT(*contents, ElementsAre("stop!"));
+  EXPECT_THAT(indices, ElementsAre(0));
+}
+
+TEST(OutputCollectorTest, FailsOnInvalidFds) {
+  OutputCollector collector;
+  absl::StatusOr<OutputCollector::Collection> collection =
+      collector.Collect({-1});
+  ASSERT_TRUE(collection.ok()) << collection.status();
+  EXPECT_FALSE(collection->Await().ok());
+}
+
+}  // namespace
+}  // namespace deepmind::code_contests
@@ -0,0 +1,414 @@
+// Copyright 2022 DeepMind Technologies Limited
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "execution/persistent_result_cache.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/flags/flag.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "absl/strings/substitute.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "execution/result_cache.h"
+#include "execution/result_cache.pb.h"
+#include "execution/status_macros.h"
+#include "execution/tester_sandboxer.h"
+#include "farmhash.h"
+
+ABSL_FLAG(std::string, result_cache_path, "",
+          "Path to a result cache that persists across runs, and that several "
+          "processes can share. If empty, results are only cached in memory.");
+ABSL_FLAG(int64_t, result_cache_max_bytes, int64_t{4} << 30,
+          "Size that the persistent result cache is compacted at, keeping the "
+          "newest results up to half of it.");
+
+namespace deepmind::code_contests {
+
+namespace {
+
+// Records start with their key size, value size and checksum.
+constexpr int64_t kHeaderSize = 3 * sizeof(uint64_t);
+
+absl::Status ErrnoError(const absl::string_view what,
+                        const absl::string_view path) {
+  return absl::UnknownError(
+      absl::Substitute("$0 $1 failed: errno $2", what, path, errno));
+}
+
+// Holds an flock on a file for as long as it lives.
+class FileLock {
+ public:
+  FileLock(const int fd, const int operation) : fd_(fd) {
+    int result;
+    do {
+      result = flock(fd_, operation);
+    } while (result != 0 && errno == EINTR);
+    locked_ = result == 0;
+  }
+  ~FileLock() {
+    if (locked_) flock(fd_, LOCK_UN);
+  }
+  FileLock(const FileLock&) = delete;
+  FileLock& operator=(const FileLock&) = delete;
+
+  bool locked() const { return locked_; }
+
+ private:
+  const int fd_;
+  bool locked_;
+};
+
+absl::Status PreadFully(const int fd, char* buffer, int64_t size,
+                        int64_t offset, const absl::string_view path) {
+  while (size > 0) {
+    const ssize_t n = pread(fd, buffer, size, offset);
+    if (n < 0 && errno == EINTR) continue;
+    if (n < 0) return ErrnoError("Reading", path);
+    if (n == 0) {
+      return absl::DataLossError(absl::StrCat("Unexpected end of ", path));
+    }
+    buffer += n;
+    size -= n;
+    offset += n;
+  }
+  return absl::OkStatus();
+}
+
+absl::Status PwriteFully(const int fd, absl::string_view bytes, int64_t offset,
+                         const absl::string_view path) {
+  while (!bytes.empty()) {
+    const ssize_t n = pwrite(fd, bytes.data(), bytes.size(), offset);
+    if (n < 0 && errno == EINTR) continue;
+    if (n < 0) return ErrnoError("Writing", path);
+    bytes.remove_prefix(n);
+    offset += n;
+  }
+  return absl::OkStatus();
+}
+
+uint64_t LoadUint64(const char* bytes) {
+  uint64_t value;
+  std::memcpy(&value, bytes, sizeof(value));
+  return value;
+}
+
+void AppendUint64(const uint64_t value, std::string& out) {
+  out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+// Returns whether the checksum of a whole record matches its contents.
+bool IsIntact(const absl::string_view record) {
+  const uint64_t checksum = LoadUint64(record.data() + 2 * sizeof(uint64_t));
+  const absl::string_view contents = record.substr(kHeaderSize);
+  return farmhash::Fingerprint64(contents.data(), contents.size()) == checksum;
+}
+
+CachedResultKey KeyToProto(const ResultCacheKey& key) {
+  CachedResultKey proto;
+  proto.set_problem(key.problem);
+  proto.set_compiler(key.compiler);
+  proto.set_program_hash(key.program_hash);
+  proto.set_tests_hash(key.tests_hash);
+  return proto;
+}
+
+std::string SerializeResults(const std::vector<ExecutionResult>& results) {
+  CachedTestResults proto;
+  for (const ExecutionResult& result : results) {
+    CachedExecutionResult& cached = *proto.add_test_results();
+    cached.set_program_status(static_cast<int>(result.program_status));
+    cached.set_program_hash(result.program_hash);
+    cached.set_stdout(result.stdout);
+    cached.set_stderr(result.stderr);
+    cached.set_execution_duration_nanos(
+        absl::ToInt64Nanoseconds(result.execution_duration));
+    cached.set_sandbox_result(result.sandbox_result);
+    if (result.passed.has_value()) cached.set_passed(*result.passed);
+  }
+  return proto.SerializeAsString();
+}
+
+std::optional<std::vector<ExecutionResult>> ParseResults(
+    const absl::string_view bytes) {
+  CachedTestResults proto;
+  if (!proto.ParseFromArray(bytes.data(), bytes.size())) return std::nullopt;
+  std::vector<ExecutionResult> results;
+  results.reserve(proto.test_results_size());
+  for (const CachedExecutionResult& cached : proto.test_results()) {
+    ExecutionResult& result = results.emplace_back();
+    result.program_status =
+        static_cast<ProgramStatus>(cached.program_status());
+    result.program_hash = cached.program_hash();
+    result.stdout = cached.stdout();
+    result.stderr = cached.stderr();
+    result.execution_duration =
+        absl::Nanoseconds(cached.execution_duration_nanos());
+    result.sandbox_result = cached.sandbox_result();
+    if (cached.has_passed()) result.passed = cached.passed();
+  }
+  return results;
+}
+
+}  // namespace
+
+absl::StatusOr<std::unique_ptr<PersistentResultCache>>
+PersistentResultCache::Open(const absl::string_view path,
+                            PersistentResultCacheOptions options) {
+  const std::string lock_path = absl::StrCat(path, ".lock");
+  const int lock_fd = open(lock_path.c_str(), O_RDWR | O_CREAT, 0644);
+  if (lock_fd < 0) return ErrnoError("Opening", lock_path);
+  std::unique_ptr<PersistentResultCache> cache(
+      new PersistentResultCache(std::string(path), lock_fd,
+                                std::move(options)));
+  absl::MutexLock l(&cache->mutex_);
+  const FileLock lock(lock_fd, LOCK_SH);
+  if (!lock.locked()) return ErrnoError("Locking", lock_path);
+  RETURN_IF_ERROR(cache->CatchUp());
+  return cache;
+}
+
+PersistentResultCache::PersistentResultCache(
+    std::string path, const int lock_fd, PersistentResultCacheOptions options)
+    : path_(std::move(path)), lock_fd_(lock_fd), options_(std::move(options)) {}
+
+PersistentResultCache::~PersistentResultCache() {
+  absl::MutexLock l(&mutex_);
+  if (log_fd_ >= 0) close(log_fd_);
+  close(lock_fd_);
+}
+
+absl::Status PersistentResultCache::CatchUp() {
+  struct stat st;
+  const bool exists = stat(path_.c_str(), &st) == 0;
+  if (log_fd_ < 0 || !exists || st.st_ino != log_inode_) {
+    // The log was replaced by a compaction, or is opened for the first time.
+    if (log_fd_ >= 0) close(log_fd_);
+    log_fd_ = open(path_.c_str(), O_RDWR | O_CREAT, 0644);
+    if (log_fd_ < 0) return ErrnoError("Opening", path_);
+    if (fstat(log_fd_, &st) != 0) return ErrnoError("Stating", path_);
+    log_inode_ = st.st_ino;
+    index_.clear();
+    indexed_end_ = 0;
+  } else if (fstat(log_fd_, &st) != 0) {
+    return ErrnoError("Stating", path_);
+  }
+
+  const int64_t size = st.st_size;
+  char header[kHeaderSize];
+  std::string key_bytes;
+  while (indexed_end_ + kHeaderSize <= size) {
+    RETURN_IF_ERROR(
+        PreadFully(log_fd_, header, kHeaderSize, indexed_end_, path_));
+    const uint64_t key_size = LoadUint64(header);
+    const uint64_t value_size = LoadUint64(header + sizeof(uint64_t));
+    // A record that does not fit was cut short by a crash while appending it.
+    if (key_size > size || value_size > size ||
+        indexed_end_ + kHeaderSize + key_size + value_size > size) {
+      break;
+    }
+    key_bytes.resize(key_size);
+    RETURN_IF_ERROR(PreadFully(log_fd_, key_bytes.data(), key_size,
+                               indexed_end_ + kHeaderSize, path_));
+    CachedResultKey key;
+    if (!key.ParseFromString(key_bytes)) break;
+    const int64_t record_size = kHeaderSize + key_size + value_size;
+    index_.insert_or_assign(
+        ResultCacheKey{.problem = key.problem(),
+                       .compiler = key.compiler(),
+                       .program_hash = key.program_hash(),
+                       .tests_hash = key.tests_hash()},
+        Location{.offset = indexed_end_, .size = record_size});
+    indexed_end_ += record_size;
+  }
+  return absl::OkStatus();
+}
+
+std::optional<std::vector<ExecutionResult>> PersistentResultCache::Lookup(
+    const ResultCacheKey& key) {
+  absl::MutexLock l(&mutex_);
+  std::string record;
+  {
+    const FileLock lock(lock_fd_, LOCK_SH);
+    absl::Status status =
+        lock.locked() ? CatchUp() : ErrnoError("Locking", path_);
+    const auto it = index_.find(key);
+    if (status.ok() && it != index_.end()) {
+      record.resize(it->second.size);
+      status = PreadFully(log_fd_, record.data(), record.size(),
+                          it->second.offset, path_);
+      if (!status.ok()) record.clear();
+    }
+    if (!status.ok()) {
+      std::cerr << "Result cache lookup failed: " << status << std::endl;
+    }
+  }
+  std::optional<std::vector<ExecutionResult>> results;
+  if (!record.empty()) {
+    const uint64_t key_size = LoadUint64(record.data());
+    if (IsIntact(record)) {
+      results = ParseResults(
+          absl::string_view(record).substr(kHeaderSize + key_size));
+    }
+    // Forget a corrupt record, so that the next insertion appends a good copy.
+    if (!results.has_value()) index_.erase(key);
+  }
+  if (results.has_value()) {
+    ++stats_.hits;
+  } else {
+    ++stats_.misses;
+  }
+  return results;
+}
+
+void PersistentResultCache::Insert(
+    const ResultCacheKey& key, const std::vector<ExecutionResult>& test_results) {
+  const std::string value = SerializeResults(test_results);
+  absl::MutexLock l(&mutex_);
+  const FileLock lock(lock_fd_, LOCK_EX);
+  absl::Status status =
+      lock.locked() ? CatchUp() : ErrnoError("Locking", path_);
+  // Another process may have added the same results in the meantime.
+  if (status.ok() && !index_.contains(key)) {
+    status = Append(key, value);
+    if (status.ok() && indexed_end_ > options_.max_bytes) status = Compact();
+  }
+  if (!status.ok()) {
+    std::cerr << "Result cache insertion failed: " << status << std::endl;
+  }
+}
+
+absl::Status PersistentResultCache::Append(const ResultCacheKey& key,
+                                           const absl::string_view value) {
+  const std::string key_bytes = KeyToProto(key).SerializeAsString();
+  std::string contents = absl::StrCat(key_bytes, value);
+  std::string record;
+  record.reserve(kHeaderSize + contents.size());
+  AppendUint64(key_bytes.size(), record);
+  AppendUint64(value.size(), record);
+  AppendUint64(farmhash::Fingerprint64(contents.data(), contents.size()),
+               record);
+  record.append(contents);
+  // Drop whatever a crashed process left after the last complete record.
+  if (ftruncate(log_fd_, indexed_end_) != 0) {
+    return ErrnoError("Truncating", path_);
+  }
+  RETURN_IF_ERROR(PwriteFully(log_fd_, record, indexed_end_, path_));
+  index_.insert_or_assign(
+      key, Location{.offset = indexed_end_,
+                    .size = static_cast<int64_t>(record.size())});
+  indexed_end_ += record.size();
+  return absl::OkStatus();
+}
+
+absl::Status PersistentResultCache::Compact() {
+  std::vector<Location> locations;
+  locations.reserve(index_.size());
+  for (const auto& [key, location] : index_) {
+    locations.push_back(location);
+  }
+  // Keep the newest records, which are the last in the log.
+  std::sort(locations.begin(), locations.end(),
+            [](const Location& a, const Location& b) {
+              return a.offset > b.offset;
+            });
+  int64_t kept_size = 0;
+  int num_kept = 0;
+  while (num_kept < locations.size() &&
+         kept_size + locations[num_kept].size <= options_.max_bytes / 2) {
+    kept_size += locations[num_kept++].size;
+  }
+  locations.resize(num_kept);
+  std::reverse(locations.begin(), locations.end());
+
+  const std::string temp_path = absl::StrCat(path_, ".tmp");
+  const int temp_fd = open(temp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC,
+                           0644);
+  if (temp_fd < 0) return ErrnoError("Opening", temp_path);
+  absl::Status status;
+  int64_t offset = 0;
+  int64_t num_written = 0;
+  std::string record;
+  for (const Location& location : locations) {
+    record.resize(location.size);
+    status = PreadFully(log_fd_, record.data(), record.size(), location.offset,
+                        path_);
+    if (!status.ok()) break;
+    // Drop corrupt records rather than carrying them into the new log.
+    if (!IsIntact(record)) continue;
+    status = PwriteFully(temp_fd, record, offset, temp_path);
+    if (!status.ok()) break;
+    offset += record.size();
+    ++num_written;
+  }
+  if (status.ok() && fsync(temp_fd) != 0) {
+    status = ErrnoError("Syncing", temp_path);
+  }
+  close(temp_fd);
+  if (status.ok() && rename(temp_path.c_str(), path_.c_str()) != 0) {
+    status = ErrnoError("Renaming", temp_path);
+  }
+  if (!status.ok()) {
+    unlink(temp_path.c_str());
+    return status;
+  }
+  stats_.evicted += index_.size() - num_written;
+  // Index the compacted log.
+  return CatchUp();
+}
+
+ResultCacheStats PersistentResultCache::stats() const {
+  absl::MutexLock l(&mutex_);
+  return stats_;
+}
+
+int64_t PersistentResultCache::num_entries() const {
+  absl::MutexLock l(&mutex_);
+  return index_.size();
+}
+
+int64_t PersistentResultCache::size_bytes() const {
+  absl::MutexLock l(&mutex_);
+  return indexed_end_;
+}
+
+absl::StatusOr<std::unique_ptr<ResultCache>> ResultCacheFromFlags() {
+  const std::string path = absl::GetFlag(FLAGS_result_cache_path);
+  if (path.empty()) return std::make_unique<InMemoryResultCache>();
+  ASSIGN_OR_RETURN(
+      std::unique_ptr<PersistentResultCache> cache,
+      PersistentResultCache::Open(
+          path, {.max_bytes = absl::GetFlag(FLAGS_result_cache_max_bytes)}));
+  return cache;
+}
+
+}  // namespace deepmind::code_contests
@@ -0,0 +1,115 @@
+// Copyright 2022 DeepMind Technologies Limited
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// A result cache that persists across runs, and that several processes on the
+// same machine can share.
+//
+// Results are appended to a log file, as records of the form
+//   [key size][value size][checksum][CachedResultKey][CachedTestResults]
+// with sizes and checksum as 64-bit words, and each process keeps an index from
+// keys to the location of their values in memory. Before using the index, a
+// process reads the keys of records that other processes appended since. All
+// access is serialized by an flock on a separate lock file.
+//
+// Once the log grows past its size limit, it is compacted into a new file that
+// only keeps the newest results, up to half the limit, which replaces the log.
+// Processes notice that the log was replaced, and index the new one.
+
+#ifndef THIRD_PARTY_DEEPMIND_CODE_CONTESTS_EXECUTION_PERSISTENT_RESULT_CACHE_H_
+#define THIRD_PARTY_DEEPMIND_CODE_CONTESTS_EXECUTION_PERSISTENT_RESULT_CACHE_H_
+
+#include <sys/types.h>
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "execution/result_cache.h"
+#include "execution/tester_sandboxer.h"
+
+namespace deepmind::code_contests {
+
+struct PersistentResultCacheOptions {
+  // The size the log may grow to before it is compacted.
+  int64_t max_bytes = int64_t{4} << 30;
+};
+
+class PersistentResultCache : public ResultCache {
+ public:
+  // Opens the cache stored at `path`, creating it if it does not exist.
+  static absl::StatusOr<std::unique_ptr<PersistentResultCache>> Open(
+      absl::string_view path, PersistentResultCacheOptions options = {});
+
+  ~PersistentResultCache() override;
+
+  std::optional<std::vector<ExecutionResult>> Lookup(
+      const ResultCacheKey& key) override;
+  // Failures to write are logged and otherwise ignored, as the results are
+  // only lost to the cache.
+  void Insert(const ResultCacheKey& key,
+              const std::vector<ExecutionResult>& test_results) override;
+  ResultCacheStats stats() const override;
+
+  // The number of results and size of the log, as of the last access.
+  int64_t num_entries() const;
+  int64_t size_bytes() const;
+
+ private:
+  // The byte range of a record in the log.
+  struct Location {
+    int64_t offset;
+    int64_t size;
+  };
+
+  PersistentResultCache(std::string path, int lock_fd,
+                        PersistentResultCacheOptions options);
+
+  // Reopens the log if another process replaced it, and indexes any records
+  // appended since the last call. Must hold the file lock.
+  absl::Status CatchUp() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  absl::Status Append(const ResultCacheKey& key, absl::string_view value)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  // Rewrites the log with the newest results, up to half of `max_bytes`. Must
+  // hold the file lock exclusively.
+  absl::Status Compact() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  const std::string path_;
+  const int lock_fd_;
+  const PersistentResultCacheOptions options_;
+
+  mutable absl::Mutex mutex_;
+  int log_fd_ ABSL_GUARDED_BY(mutex_) = -1;
+  ino_t log_inode_ ABSL_GUARDED_BY(mutex_) = 0;
+  // The end of the last complete record that was indexed.
+  int64_t indexed_end_ ABSL_GUARDED_BY(mutex_) = 0;
+  absl::flat_hash_map<ResultCacheKey, Location> index_ ABSL_GUARDED_BY(mutex_);
+  ResultCacheStats stats_ ABSL_GUARDED_BY(mutex_);
+};
+
+// Returns the cache selected by --result_cache_path and
+// --result_cache_max_bytes: a PersistentResultCache if a path is set, and an
+// InMemoryResultCache otherwise.
+absl::StatusOr<std::unique_ptr<ResultCache>> ResultCacheFromFlags();
+
+}  // namespace deepmind::code_contests
+
+#endif  // THIRD_PARTY_DEEPMIND_CODE_CONTESTS_EXECUTION_PERSISTENT_RESULT_CACHE_H_
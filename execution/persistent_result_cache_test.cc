@@ -0,0 +1,192 @@
+// Copyright 2022 DeepMind Technologies Limited
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "execution/persistent_result_cache.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "absl/time/time.h"
+#include "execution/result_cache.h"
+#include "execution/tester_sandboxer.h"
+
+namespace deepmind::code_contests {
+namespace {
+
+using ::testing::ElementsAre;
+using ::testing::Field;
+using ::testing::Optional;
+
+std::string TestPath(const absl::string_view name) {
+  const std::string path = absl::StrCat(testing::TempDir(), "/", name);
+  unlink(path.c_str());
+  return path;
+}
+
+std::unique_ptr<PersistentResultCache> OpenCache(
+    const std::string& path, PersistentResultCacheOptions options = {}) {
+  absl::StatusOr<std::unique_ptr<PersistentResultCache>> cache =
+      PersistentResultCache::Open(path, options);
+  EXPECT_TRUE(cache.ok()) << cache.status();
+  return cache.ok() ? *std::move(cache) : nullptr;
+}
+
+ResultCacheKey Key(const uint64_t program_hash) {
+  return {.problem = "problem",
+          .compiler = "python3",
+          .program_hash = program_hash,
+          .tests_hash = 7};
+}
+
+std::vector<ExecutionResult> Results(const absl::string_view stdout) {
+  ExecutionResult result;
+  result.program_status = ProgramStatus::kSuccess;
+  result.stdout = std::string(stdout);
+  result.execution_duration = absl::Milliseconds(12);
+  result.passed = true;
+  return {result};
+}
+
+TEST(PersistentResultCacheTest, KeepsResultsAcrossRuns) {
+  const std::string path = TestPath("across_runs.cache");
+  {
+    std::unique_ptr<PersistentResultCache> cache = OpenCache(path);
+    ASSERT_NE(cache, nullptr);
+    EXPECT_EQ(cache->Lookup(Key(1)), std::nullopt);
+    cache->Insert(Key(1), Results("42\n"));
+  }
+  std::unique_ptr<PersistentResultCache> cache = OpenCache(path);
+  ASSERT_NE(cache, nullptr);
+  EXPECT_EQ(cache->num_entries(), 1);
+  const std::optional<std::vector<ExecutionResult>> results =
+      cache->Lookup(Key(1));
+  ASSERT_TRUE(results.has_value());
+  ASSERT_EQ(results->size(), 1);
+  EXPECT_EQ((*results)[0].program_status, ProgramStatus::kSuccess);
+  EXPECT_EQ((*results)[0].stdout, "42\n");
+  EXPECT_EQ((*results)[0].execution_duration, absl::Milliseconds(12));
+  EXPECT_THAT((*results)[0].passed, Optional(true));
+  EXPECT_EQ(cache->Lookup(Key(2)), std::nullopt);
+  EXPECT_EQ(cache->stats().hits, 1);
+  EXPECT_EQ(cache->stats().misses, 1);
+}
+
+TEST(PersistentResultCacheTest, SharesResultsBetweenInstances) {
+  const std::string path = TestPath("shared.cache");
+  std::unique_ptr<PersistentResultCache> first = OpenCache(path);
+  std::unique_ptr<PersistentResultCache> second = OpenCache(path);
+  ASSERT_NE(first, nullptr);
+  ASSERT_NE(second, nullptr);
+  first->Insert(Key(1), Results("1\n"));
+  second->Insert(Key(2), Results("2\n"));
+  // Inserting a result the other instance inserted keeps a single copy.
+  second->Insert(Key(1), Results("1\n"));
+  EXPECT_THAT(second->Lookup(Key(1)),
+              Optional(ElementsAre(Field(&ExecutionResult::stdout, "1\n"))));
+  EXPECT_THAT(first->Lookup(Key(2)),
+              Optional(ElementsAre(Field(&ExecutionResult::stdout, "2\n"))));
+  EXPECT_EQ(first->num_entries(), 2);
+  EXPECT_EQ(first->size_bytes(), second->size_bytes());
+}
+
+TEST(PersistentResultCacheTest, IgnoresTornRecords) {
+  const std::string path = TestPath("torn.cache");
+  int64_t complete_size;
+  {
+    std::unique_ptr<PersistentResultCache> cache = OpenCache(path);
+    ASSERT_NE(cache, nullptr);
+    cache->Insert(Key(1), Results("1\n"));
+    complete_size = cache->size_bytes();
+    cache->Insert(Key(2), Results("2\n"));
+  }
+  // Cut the second record short, as a crash while appending it would.
+  ASSERT_EQ(truncate(path.c_str(), complete_size + 30), 0);
+  std::unique_ptr<PersistentResultCache> cache = OpenCache(path);
+  ASSERT_NE(cache, nullptr);
+  EXPECT_EQ(cache->num_entries(), 1);
+  EXPECT_NE(cache->Lookup(Key(1)), std::nullopt);
+  EXPECT_EQ(cache->Lookup(Key(2)), std::nullopt);
+  // The torn record is overwritten by the next one.
+  cache->Insert(Key(3), Results("3\n"));
+  std::unique_ptr<PersistentResultCache> reopened = OpenCache(path);
+  ASSERT_NE(reopened, nullptr);
+  EXPECT_EQ(reopened->num_entries(), 2);
+  EXPECT_NE(reopened->Lookup(Key(3)), std::nullopt);
+}
+
+TEST(PersistentResultCacheTest, ReplacesCorruptRecords) {
+  const std::string path = TestPath("corrupt.cache");
+  {
+    std::unique_ptr<PersistentResultCache> cache = OpenCache(path);
+    ASSERT_NE(cache, nullptr);
+    cache->Insert(Key(1), Results("1\n"));
+  }
+  // Flip the last byte of the stored value.
+  const int fd = open(path.c_str(), O_RDWR);
+  ASSERT_GE(fd, 0);
+  struct stat st;
+  ASSERT_EQ(fstat(fd, &st), 0);
+  char byte;
+  ASSERT_EQ(pread(fd, &byte, 1, st.st_size - 1), 1);
+  byte ^= 1;
+  ASSERT_EQ(pwrite(fd, &byte, 1, st.st_size - 1), 1);
+  close(fd);
+
+  std::unique_ptr<PersistentResultCache> cache = OpenCache(path);
+  ASSERT_NE(cache, nullptr);
+  EXPECT_EQ(cache->Lookup(Key(1)), std::nullopt);
+  cache->Insert(Key(1), Results("1\n"));
+  EXPECT_THAT(cache->Lookup(Key(1)),
+              Optional(ElementsAre(Field(&ExecutionResult::stdout, "1\n"))));
+  EXPECT_EQ(cache->stats().hits, 1);
+}
+
+TEST(PersistentResultCacheTest, CompactsToNewestResults) {
+  const std::string path = TestPath("compacted.cache");
+  std::unique_ptr<PersistentResultCache> other = OpenCache(path);
+  ASSERT_NE(other, nullptr);
+  other->Insert(Key(0), Results(std::string(100, 'x')));
+  const int64_t record_size = other->size_bytes();
+  // Compact once ten records are written, down to the newest five.
+  std::unique_ptr<PersistentResultCache> cache =
+      OpenCache(path, {.max_bytes = 10 * record_size - 1});
+  ASSERT_NE(cache, nullptr);
+  for (int i = 1; i < 10; ++i) {
+    cache->Insert(Key(i), Results(std::string(100, 'x')));
+  }
+  EXPECT_EQ(cache->num_entries(), 4);
+  EXPECT_EQ(cache->stats().evicted, 6);
+  for (int i = 0; i < 10; ++i) {
+    EXPECT_EQ(cache->Lookup(Key(i)).has_value(), i >= 6) << i;
+  }
+  // Other instances index the compacted log.
+  EXPECT_NE(other->Lookup(Key(9)), std::nullopt);
+  EXPECT_EQ(other->Lookup(Key(0)), std::nullopt);
+  EXPECT_EQ(other->size_bytes(), 4 * record_size);
+}
+
+}  // namespace
+}  // namespace deepmind::code_contests
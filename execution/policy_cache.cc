@@ -0,0 +1,78 @@
+// Copyright 2022 DeepMind Technologies Limited
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "execution/policy_cache.h"
+
+#include <memory>
+#include <utility>
+
+#include "absl/status/statusor.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "sandboxed_api/sandbox2/policy.h"
+#include "sandboxed_api/sandbox2/policybuilder.h"
+
+namespace deepmind::code_contests {
+
+absl::StatusOr<std::unique_ptr<sandbox2::Policy>> PolicyCache::Build(
+    const PolicyCacheKey& key, const BuilderFactory& create_builder) {
+  std::shared_ptr<const sandbox2::PolicyBuilder> cached;
+  {
+    absl::MutexLock l(&mutex_);
+    const auto it = builders_.find(key);
+    if (it != builders_.end()) {
+      ++stats_.hits;
+      cached = it->second;
+    } else {
+      ++stats_.misses;
+    }
+  }
+
+  if (cached == nullptr) {
+    // Concurrent misses on the same key both resolve it, rather than one
+    // waiting on the other with the lock held.
+    const absl::Time resolve_start = absl::Now();
+    cached = std::make_shared<const sandbox2::PolicyBuilder>(create_builder());
+    const absl::Duration resolve_time = absl::Now() - resolve_start;
+
+    absl::MutexLock l(&mutex_);
+    stats_.resolve_time += resolve_time;
+    if (builders_.try_emplace(key, cached).second) {
+      insertion_order_.push_back(key);
+      while (insertion_order_.size() > max_entries_) {
+        builders_.erase(insertion_order_.front());
+        insertion_order_.pop_front();
+        ++stats_.evicted;
+      }
+    }
+  }
+
+  // Building consumes the builder, so every policy is built from a copy.
+  const absl::Time build_start = absl::Now();
+  sandbox2::PolicyBuilder builder = *cached;
+  absl::StatusOr<std::unique_ptr<sandbox2::Policy>> policy = builder.TryBuild();
+  const absl::Duration build_time = absl::Now() - build_start;
+
+  absl::MutexLock l(&mutex_);
+  stats_.build_time += build_time;
+  return policy;
+}
+
+PolicyCacheStats PolicyCache::stats() const {
+  absl::MutexLock l(&mutex_);
+  return stats_;
+}
+
+}  // namespace deepmind::code_contests
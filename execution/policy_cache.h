@@ -0,0 +1,105 @@
+// Copyright 2022 DeepMind Technologies Limited
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Caching of sandbox policies across tests.
+//
+// Every test runs in a sandbox of its own, and every sandbox needs a policy
+// of its own, as sandboxes take ownership of their policies. Most of the cost
+// of a policy is in resolving what to mount, such as the libraries that the
+// interpreter links against, which is the same for every test of a program.
+// PolicyCache keeps the configured builders, so that policies for further
+// tests are built from copies of them.
+
+#ifndef THIRD_PARTY_DEEPMIND_CODE_CONTESTS_EXECUTION_POLICY_CACHE_H_
+#define THIRD_PARTY_DEEPMIND_CODE_CONTESTS_EXECUTION_POLICY_CACHE_H_
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/status/statusor.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "sandboxed_api/sandbox2/policy.h"
+#include "sandboxed_api/sandbox2/policybuilder.h"
+
+namespace deepmind::code_contests {
+
+// Everything that a policy is made from.
+struct PolicyCacheKey {
+  std::string binary;
+  std::vector<std::string> ro_files;
+  std::vector<std::string> ro_dirs;
+  std::vector<std::string> rw_dirs;
+  std::vector<std::string> library_paths;
+
+  bool operator==(const PolicyCacheKey& other) const {
+    return binary == other.binary && ro_files == other.ro_files &&
+           ro_dirs == other.ro_dirs && rw_dirs == other.rw_dirs &&
+           library_paths == other.library_paths;
+  }
+
+  template <typename H>
+  friend H AbslHashValue(H h, const PolicyCacheKey& key) {
+    return H::combine(std::move(h), key.binary, key.ro_files, key.ro_dirs,
+                      key.rw_dirs, key.library_paths);
+  }
+};
+
+struct PolicyCacheStats {
+  int64_t hits = 0;
+  int64_t misses = 0;
+  // The number of builders dropped to bound the size of the cache.
+  int64_t evicted = 0;
+  // Time spent configuring builders on misses.
+  absl::Duration resolve_time;
+  // Time spent building policies from builders, on hits and misses.
+  absl::Duration build_time;
+};
+
+// A bounded cache of policy builders. Thread-safe.
+class PolicyCache {
+ public:
+  using BuilderFactory = std::function<sandbox2::PolicyBuilder()>;
+
+  // Keeps the builders of up to `max_entries` keys, dropping the oldest first.
+  explicit PolicyCache(int max_entries = 16) : max_entries_(max_entries) {}
+
+  // Returns a policy built from a copy of the builder for `key`, which is made
+  // by `create_builder` if it is not cached yet.
+  absl::StatusOr<std::unique_ptr<sandbox2::Policy>> Build(
+      const PolicyCacheKey& key, const BuilderFactory& create_builder);
+
+  PolicyCacheStats stats() const;
+
+ private:
+  const int max_entries_;
+  mutable absl::Mutex mutex_;
+  absl::flat_hash_map<PolicyCacheKey,
+                      std::shared_ptr<const sandbox2::PolicyBuilder>>
+      builders_ ABSL_GUARDED_BY(mutex_);
+  // Keys of `builders_`, oldest first.
+  std::deque<PolicyCacheKey> insertion_order_ ABSL_GUARDED_BY(mutex_);
+  PolicyCacheStats stats_ ABSL_GUARDED_BY(mutex_);
+};
+
+}  // namespace deepmind::code_contests
+
+#endif  // THIRD_PARTY_DEEPMIND_CODE_CONTESTS_EXECUTION_POLICY_CACHE_H_
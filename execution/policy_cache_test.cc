@@ -0,0 +1,80 @@
+// Copyright 2022 DeepMind Technologies Limited
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "execution/policy_cache.h"
+
+#include <memory>
+#include <string>
+
+#include "gtest/gtest.h"
+#include "absl/status/statusor.h"
+#include "sandboxed_api/sandbox2/policy.h"
+#include "sandboxed_api/sandbox2/policybuilder.h"
+
+namespace deepmind::code_contests {
+namespace {
+
+PolicyCacheKey Key(const std::string& dir) {
+  return PolicyCacheKey{.binary = "/bin/true", .rw_dirs = {dir}};
+}
+
+class CountingFactory {
+ public:
+  PolicyCache::BuilderFactory factory() {
+    return [this] {
+      ++calls_;
+      sandbox2::PolicyBuilder builder;
+      builder.AllowExit();
+      return builder;
+    };
+  }
+  int calls() const { return calls_; }
+
+ private:
+  int calls_ = 0;
+};
+
+TEST(PolicyCacheTest, BuildsEveryPolicyFromOneBuilder) {
+  PolicyCache cache;
+  CountingFactory factory;
+  for (int i = 0; i < 3; ++i) {
+    absl::StatusOr<std::unique_ptr<sandbox2::Policy>> policy =
+        cache.Build(Key("/tmp/a"), factory.factory());
+    ASSERT_TRUE(policy.ok()) << policy.status();
+    EXPECT_NE(*policy, nullptr);
+  }
+  EXPECT_EQ(factory.calls(), 1);
+
+  ASSERT_TRUE(cache.Build(Key("/tmp/b"), factory.factory()).ok());
+  EXPECT_EQ(factory.calls(), 2);
+  EXPECT_EQ(cache.stats().hits, 2);
+  EXPECT_EQ(cache.stats().misses, 2);
+  EXPECT_EQ(cache.stats().evicted, 0);
+}
+
+TEST(PolicyCacheTest, EvictsOldestBuilders) {
+  PolicyCache cache(/*max_entries=*/2);
+  CountingFactory factory;
+  ASSERT_TRUE(cache.Build(Key("/tmp/a"), factory.factory()).ok());
+  ASSERT_TRUE(cache.Build(Key("/tmp/b"), factory.factory()).ok());
+  ASSERT_TRUE(cache.Build(Key("/tmp/c"), factory.factory()).ok());
+  EXPECT_EQ(cache.stats().evicted, 1);
+  ASSERT_TRUE(cache.Build(Key("/tmp/c"), factory.factory()).ok());
+  EXPECT_EQ(factory.calls(), 3);
+  ASSERT_TRUE(cache.Build(Key("/tmp/a"), factory.factory()).ok());
+  EXPECT_EQ(factory.calls(), 4);
+}
+
+}  // namespace
+}  // namespace deepmind::code_contests
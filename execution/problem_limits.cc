@@ -0,0 +1,166 @@
+// Copyright 2022 DeepMind Technologies Limited
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "execution/problem_limits.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <optional>
+#include <vector>
+
+#include "absl/flags/flag.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "absl/time/time.h"
+#include "contest_problem.pb.h"
+#include "execution/status_macros.h"
+#include "execution/tester_sandboxer.h"
+
+ABSL_FLAG(double, time_limit_multiplier, 2.0,
+          "Factor that problem time limits are multiplied by.");
+ABSL_FLAG(absl::Duration, min_time_limit, absl::Seconds(1),
+          "Lower bound on scaled time limits.");
+ABSL_FLAG(absl::Duration, max_time_limit, absl::Seconds(10),
+          "Upper bound on scaled time limits.");
+ABSL_FLAG(double, time_limit_slowdown, 1.0,
+          "How much slower this machine is than the reference machine. "
+          "Overridden by --calibrate_time_limits.");
+ABSL_FLAG(bool, calibrate_time_limits, false,
+          "Whether to measure how much slower this machine is than the "
+          "reference machine, and scale time limits by that.");
+ABSL_FLAG(absl::Duration, reference_workload_duration, absl::Seconds(1),
+          "Duration of the calibration workload on the reference machine. Set "
+          "it to the duration that --calibrate_time_limits reports on the "
+          "machine that --time_limit_multiplier was tuned on.");
+ABSL_FLAG(double, memory_limit_multiplier, 1.0,
+          "Factor that problem memory limits are multiplied by.");
+ABSL_FLAG(int64_t, min_memory_limit_bytes, int64_t{64} << 20,
+          "Lower bound on scaled memory limits.");
+ABSL_FLAG(int64_t, max_memory_limit_bytes, int64_t{1} << 30,
+          "Upper bound on scaled memory limits.");
+
+namespace deepmind::code_contests {
+
+namespace {
+
+// Sums the primes below three million, which keeps the interpreter loop, big
+// integers and a large buffer busy.
+constexpr absl::string_view kCalibrationWorkload = R"py(
+n = 3000000
+sieve = bytearray([1]) * (n + 1)
+total = 0
+for i in range(2, n + 1):
+    if sieve[i]:
+        total += i
+        for j in range(i * i, n + 1, i):
+            sieve[j] = 0
+print(total)
+)py";
+
+}  // namespace
+
+ProblemLimits LimitsOf(const ContestProblem& problem) {
+  ProblemLimits limits;
+  if (problem.has_time_limit()) {
+    limits.time_limit = absl::Seconds(problem.time_limit().seconds()) +
+                        absl::Nanoseconds(problem.time_limit().nanos());
+  }
+  if (problem.has_memory_limit_bytes()) {
+    limits.memory_limit_bytes = problem.memory_limit_bytes();
+  }
+  return limits;
+}
+
+void ApplyLimits(const ProblemLimits& limits, const LimitScaling& scaling,
+                 TestOptions& options) {
+  // Limits of zero are treated as missing.
+  const absl::Duration time_limit =
+      limits.time_limit.has_value() && *limits.time_limit > absl::ZeroDuration()
+          ? *limits.time_limit * scaling.time_multiplier
+          : scaling.default_time_limit;
+  options.max_execution_duration =
+      std::clamp(time_limit * scaling.slowdown, scaling.min_time_limit,
+                 scaling.max_time_limit);
+  const int64_t memory_limit_bytes =
+      limits.memory_limit_bytes.has_value() && *limits.memory_limit_bytes > 0
+          ? static_cast<int64_t>(*limits.memory_limit_bytes *
+                                 scaling.memory_multiplier)
+          : scaling.default_memory_limit_bytes;
+  options.memory_limit_bytes =
+      std::clamp(memory_limit_bytes, scaling.min_memory_limit_bytes,
+                 scaling.max_memory_limit_bytes);
+}
+
+absl::StatusOr<double> MeasureSlowdown(const TesterSandboxer& tester,
+                                       const absl::Duration reference_duration,
+                                       const int num_runs) {
+  // The runs are sequential, so that they do not compete with each other.
+  TestOptions options;
+  options.max_execution_duration = std::max(absl::Minutes(1),
+                                            10 * reference_duration);
+  options.num_threads = 1;
+  ASSIGN_OR_RETURN(const MultiTestResult result,
+                   tester.Test(kCalibrationWorkload,
+                               std::vector<absl::string_view>(num_runs, ""),
+                               options));
+  std::optional<absl::Duration> fastest;
+  for (const ExecutionResult& run : result.test_results) {
+    if (run.program_status != ProgramStatus::kSuccess) continue;
+    if (!fastest.has_value() || run.execution_duration < *fastest) {
+      fastest = run.execution_duration;
+    }
+  }
+  if (!fastest.has_value()) {
+    return absl::InternalError(absl::StrCat(
+        "Calibration workload failed: ",
+        result.test_results.empty() ? result.compilation_result.stderr
+                                    : result.test_results.front().stderr));
+  }
+  std::cout << "calibration workload took " << *fastest << ", "
+            << reference_duration << " on the reference machine" << std::endl;
+  return absl::FDivDuration(*fastest, reference_duration);
+}
+
+absl::StatusOr<LimitScaling> LimitScalingFromFlags(
+    const TesterSandboxer& tester) {
+  LimitScaling scaling{
+      .time_multiplier = absl::GetFlag(FLAGS_time_limit_multiplier),
+      .slowdown = absl::GetFlag(FLAGS_time_limit_slowdown),
+      .min_time_limit = absl::GetFlag(FLAGS_min_time_limit),
+      .max_time_limit = absl::GetFlag(FLAGS_max_time_limit),
+      .memory_multiplier = absl::GetFlag(FLAGS_memory_limit_multiplier),
+      .min_memory_limit_bytes = absl::GetFlag(FLAGS_min_memory_limit_bytes),
+      .max_memory_limit_bytes = absl::GetFlag(FLAGS_max_memory_limit_bytes)};
+  if (scaling.time_multiplier <= 0 || scaling.slowdown <= 0 ||
+      scaling.memory_multiplier <= 0) {
+    return absl::InvalidArgumentError("Limit multipliers must be positive.");
+  }
+  if (scaling.min_time_limit > scaling.max_time_limit ||
+      scaling.min_memory_limit_bytes > scaling.max_memory_limit_bytes) {
+    return absl::InvalidArgumentError(
+        "Minimum limits must not exceed maximum limits.");
+  }
+  if (absl::GetFlag(FLAGS_calibrate_time_limits)) {
+    ASSIGN_OR_RETURN(
+        scaling.slowdown,
+        MeasureSlowdown(tester,
+                        absl::GetFlag(FLAGS_reference_workload_duration)));
+  }
+  return scaling;
+}
+
+}  // namespace deepmind::code_contests
@@ -0,0 +1,86 @@
+// Copyright 2022 DeepMind Technologies Limited
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Test limits derived from the limits of a problem.
+//
+// Problems state the time and memory limits that their solutions must run in
+// on the judge's machines. TestOptions are derived from them by scaling them,
+// e.g. to leave headroom for interpreters, and clamping them to a sane range.
+//
+// How long a program takes depends on the machine it runs on. With
+// --calibrate_time_limits, a reference workload is run in the sandbox first,
+// and time limits are scaled by how much slower than the reference machine
+// this machine runs it, so that timeouts mean the same across machines.
+
+#ifndef THIRD_PARTY_DEEPMIND_CODE_CONTESTS_EXECUTION_PROBLEM_LIMITS_H_
+#define THIRD_PARTY_DEEPMIND_CODE_CONTESTS_EXECUTION_PROBLEM_LIMITS_H_
+
+#include <cstdint>
+#include <optional>
+
+#include "absl/status/statusor.h"
+#include "absl/time/time.h"
+#include "contest_problem.pb.h"
+#include "execution/tester_sandboxer.h"
+
+namespace deepmind::code_contests {
+
+// The limits of a problem, which are unset if it states none.
+struct ProblemLimits {
+  std::optional<absl::Duration> time_limit;
+  std::optional<int64_t> memory_limit_bytes;
+};
+
+struct LimitScaling {
+  // Time limits are multiplied by `time_multiplier` and `slowdown`, then
+  // clamped to [min_time_limit, max_time_limit].
+  double time_multiplier = 2.0;
+  // How much slower this machine is than the reference machine, see
+  // MeasureSlowdown.
+  double slowdown = 1.0;
+  absl::Duration min_time_limit = absl::Seconds(1);
+  absl::Duration max_time_limit = absl::Seconds(10);
+  // Used, scaled by `slowdown`, for problems without a time limit.
+  absl::Duration default_time_limit = absl::Seconds(5);
+  // Memory limits are multiplied by `memory_multiplier`, then clamped to
+  // [min_memory_limit_bytes, max_memory_limit_bytes].
+  double memory_multiplier = 1.0;
+  int64_t min_memory_limit_bytes = int64_t{64} << 20;
+  int64_t max_memory_limit_bytes = int64_t{1} << 30;
+  // Used for problems without a memory limit.
+  int64_t default_memory_limit_bytes = kDefaultMemoryLimitBytes;
+};
+
+ProblemLimits LimitsOf(const ContestProblem& problem);
+
+// Sets the execution duration and memory limits of `options` from `limits`.
+void ApplyLimits(const ProblemLimits& limits, const LimitScaling& scaling,
+                 TestOptions& options);
+
+// Runs a CPU-bound reference workload `num_runs` times with `tester`, and
+// returns its fastest duration divided by `reference_duration`, the duration
+// of the workload on the reference machine.
+absl::StatusOr<double> MeasureSlowdown(const TesterSandboxer& tester,
+                                       absl::Duration reference_duration,
+                                       int num_runs = 3);
+
+// Returns the scaling set by the flags in problem_limits.cc. With
+// --calibrate_time_limits, the slowdown is measured with `tester`, which
+// should run Python 3.
+absl::StatusOr<LimitScaling> LimitScalingFromFlags(
+    const TesterSandboxer& tester);
+
+}  // namespace deepmind::code_contests
+
+#endif  // THIRD_PARTY_DEEPMIND_CODE_CONTESTS_EXECUTION_PROBLEM_LIMITS_H_
@@ -0,0 +1,80 @@
+// Copyright 2022 DeepMind Technologies Limited
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "execution/problem_limits.h"
+
+#include <cstdint>
+#include <optional>
+
+#include "gtest/gtest.h"
+#include "absl/time/time.h"
+#include "contest_problem.pb.h"
+#include "execution/tester_sandboxer.h"
+
+namespace deepmind::code_contests {
+namespace {
+
+TEST(LimitsOfTest, ReadsProblemLimits) {
+  ContestProblem problem;
+  EXPECT_EQ(LimitsOf(problem).time_limit, std::nullopt);
+  EXPECT_EQ(LimitsOf(problem).memory_limit_bytes, std::nullopt);
+  problem.mutable_time_limit()->set_seconds(1);
+  problem.mutable_time_limit()->set_nanos(500000000);
+  problem.set_memory_limit_bytes(int64_t{256} << 20);
+  EXPECT_EQ(LimitsOf(problem).time_limit, absl::Milliseconds(1500));
+  EXPECT_EQ(LimitsOf(problem).memory_limit_bytes, int64_t{256} << 20);
+}
+
+TEST(ApplyLimitsTest, ScalesAndClampsLimits) {
+  const LimitScaling scaling{.time_multiplier = 2,
+                             .slowdown = 1.5,
+                             .min_time_limit = absl::Seconds(1),
+                             .max_time_limit = absl::Seconds(10),
+                             .memory_multiplier = 2,
+                             .min_memory_limit_bytes = 64 << 20,
+                             .max_memory_limit_bytes = 1 << 30};
+  TestOptions options;
+  ApplyLimits({.time_limit = absl::Seconds(2),
+               .memory_limit_bytes = int64_t{256} << 20},
+              scaling, options);
+  EXPECT_EQ(options.max_execution_duration, absl::Seconds(6));
+  EXPECT_EQ(options.memory_limit_bytes, int64_t{512} << 20);
+
+  ApplyLimits({.time_limit = absl::Milliseconds(100),
+               .memory_limit_bytes = int64_t{16} << 20},
+              scaling, options);
+  EXPECT_EQ(options.max_execution_duration, absl::Seconds(1));
+  EXPECT_EQ(options.memory_limit_bytes, int64_t{64} << 20);
+
+  ApplyLimits({.time_limit = absl::Seconds(20),
+               .memory_limit_bytes = int64_t{1} << 30},
+              scaling, options);
+  EXPECT_EQ(options.max_execution_duration, absl::Seconds(10));
+  EXPECT_EQ(options.memory_limit_bytes, int64_t{1} << 30);
+}
+
+TEST(ApplyLimitsTest, UsesDefaultsForMissingLimits) {
+  const LimitScaling scaling{.slowdown = 1.5};
+  TestOptions options;
+  ApplyLimits({}, scaling, options);
+  EXPECT_EQ(options.max_execution_duration, absl::Milliseconds(7500));
+  EXPECT_EQ(options.memory_limit_bytes, kDefaultMemoryLimitBytes);
+  ApplyLimits({.time_limit = absl::ZeroDuration(), .memory_limit_bytes = 0},
+              scaling, options);
+  EXPECT_EQ(options.max_execution_duration, absl::Milliseconds(7500));
+  EXPECT_EQ(options.memory_limit_bytes, kDefaultMemoryLimitBytes);
+}
+
+}  // namespace
+}  // namespace deepmind::code_contests
@@ -0,0 +1,89 @@
+// Copyright 2022 DeepMind Technologies Limited
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "execution/py_dialect.h"
+
+#include <cstddef>
+
+#include "absl/strings/ascii.h"
+#include "absl/strings/match.h"
+#include "absl/strings/string_view.h"
+
+namespace deepmind::code_contests {
+
+namespace {
+
+// Builtins and methods that Python 3 removed, which Python 2 programs that
+// compile under Python 3 still tend to use.
+constexpr absl::string_view kPython2OnlyNames[] = {
+    "raw_input", "xrange",     "unichr",   "basestring",
+    "iteritems", "itervalues", "iterkeys", "has_key"};
+
+bool IsIdentifierChar(const char c) {
+  return absl::ascii_isalnum(c) || c == '_';
+}
+
+bool IsPython2OnlyName(const absl::string_view name) {
+  for (const absl::string_view python2_name : kPython2OnlyNames) {
+    if (name == python2_name) return true;
+  }
+  return false;
+}
+
+}  // namespace
+
+absl::string_view PyDialectName(const PyDialect dialect) {
+  switch (dialect) {
+    case PyDialect::kPython3:
+      return "python3";
+    case PyDialect::kPython2:
+      return "python2";
+  }
+  return "";
+}
+
+PyDialect GuessPyDialect(const absl::string_view code) {
+  size_t i = 0;
+  while (i < code.size()) {
+    const char c = code[i];
+    if (c == '#') {
+      // Skip the comment.
+      i = code.find('\n', i);
+      if (i == absl::string_view::npos) break;
+    } else if (c == '\'' || c == '"') {
+      // Skip the string literal, which may be triple-quoted.
+      const char triple_quote[] = {c, c, c};
+      const absl::string_view quote =
+          absl::StartsWith(code.substr(i), absl::string_view(triple_quote, 3))
+              ? absl::string_view(triple_quote, 3)
+              : absl::string_view(triple_quote, 1);
+      i += quote.size();
+      while (i < code.size() && !absl::StartsWith(code.substr(i), quote)) {
+        i += code[i] == '\\' ? 2 : 1;
+      }
+      i += quote.size();
+    } else if (IsIdentifierChar(c)) {
+      const size_t begin = i;
+      while (i < code.size() && IsIdentifierChar(code[i])) ++i;
+      if (IsPython2OnlyName(code.substr(begin, i - begin))) {
+        return PyDialect::kPython2;
+      }
+    } else {
+      ++i;
+    }
+  }
+  return PyDialect::kPython3;
+}
+
+}  // namespace deepmind::code_contests
@@ -0,0 +1,40 @@
+// Copyright 2022 DeepMind Technologies Limited
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Guessing the Python dialect that a program is written in.
+//
+// Python 2 programs with print() calls, as is common, compile under Python 3
+// too, but then fail at runtime if they use builtins that Python 3 removed,
+// such as raw_input or xrange. Other programs that compile under Python 3 are
+// taken to be written in it.
+
+#ifndef THIRD_PARTY_DEEPMIND_CODE_CONTESTS_EXECUTION_PY_DIALECT_H_
+#define THIRD_PARTY_DEEPMIND_CODE_CONTESTS_EXECUTION_PY_DIALECT_H_
+
+#include "absl/strings/string_view.h"
+
+namespace deepmind::code_contests {
+
+enum class PyDialect { kPython3, kPython2 };
+
+// Returns "python3" or "python2".
+absl::string_view PyDialectName(PyDialect dialect);
+
+// Returns kPython2 if `code` refers to names that only Python 2 defines,
+// outside of comments and string literals, and kPython3 otherwise.
+PyDialect GuessPyDialect(absl::string_view code);
+
+}  // namespace deepmind::code_contests
+
+#endif  // THIRD_PARTY_DEEPMIND_CODE_CONTESTS_EXECUTION_PY_DIALECT_H_
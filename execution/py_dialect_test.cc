@@ -0,0 +1,56 @@
+// Copyright 2022 DeepMind Technologies Limited
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "execution/py_dialect.h"
+
+#include "gtest/gtest.h"
+
+namespace deepmind::code_contests {
+namespace {
+
+TEST(GuessPyDialectTest, FindsPython2OnlyNames) {
+  EXPECT_EQ(GuessPyDialect("n = int(raw_input())\nprint(n)\n"),
+            PyDialect::kPython2);
+  EXPECT_EQ(GuessPyDialect("for i in xrange(3): print(i)\n"),
+            PyDialect::kPython2);
+  EXPECT_EQ(GuessPyDialect("if d.has_key(1): pass\n"), PyDialect::kPython2);
+}
+
+TEST(GuessPyDialectTest, DefaultsToPython3) {
+  EXPECT_EQ(GuessPyDialect("n = int(input())\nprint(n)\n"),
+            PyDialect::kPython3);
+  EXPECT_EQ(GuessPyDialect(""), PyDialect::kPython3);
+  // Names that merely contain Python 2 names do not count.
+  EXPECT_EQ(GuessPyDialect("my_xrange = range\nprint(my_xrange(3))\n"),
+            PyDialect::kPython3);
+}
+
+TEST(GuessPyDialectTest, IgnoresCommentsAndStrings) {
+  EXPECT_EQ(GuessPyDialect("# no raw_input here\nprint(input())\n"),
+            PyDialect::kPython3);
+  EXPECT_EQ(GuessPyDialect("print('xrange', \"it's raw_input\")\n"),
+            PyDialect::kPython3);
+  EXPECT_EQ(GuessPyDialect("s = '''\nxrange \\' ''' + raw_input()\n"),
+            PyDialect::kPython2);
+  EXPECT_EQ(GuessPyDialect("s = \"\"\"xrange\n\"\"\"\nprint(s)"),
+            PyDialect::kPython3);
+}
+
+TEST(PyDialectNameTest, NamesDialects) {
+  EXPECT_EQ(PyDialectName(PyDialect::kPython3), "python3");
+  EXPECT_EQ(PyDialectName(PyDialect::kPython2), "python2");
+}
+
+}  // namespace
+}  // namespace deepmind::code_contests
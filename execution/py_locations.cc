@@ -23,6 +23,9 @@ ABSL_FLAG(std::string, python3_path, "/usr/bin/python3.9",
           "The path to python3.");
 ABSL_FLAG(std::vector<std::string>, python3_library_paths,
           {"/usr/lib/python3.9"}, "The paths to python3 libraries.");
+ABSL_FLAG(bool, python3_zygote, false,
+          "Whether to fork python3 tests from interpreters that are already "
+          "running, rather than starting an interpreter for every test.");
 ABSL_FLAG(std::string, python2_path, "/usr/bin/python2.7",
           "The path to python2.");
 ABSL_FLAG(std::vector<std::string>, python2_library_paths,
@@ -34,6 +37,7 @@ std::string Py3InterpreterPath() { return absl::GetFlag(FLAGS_python3_path); }
 std::vector<std::string> Py3LibraryPaths() {
   return absl::GetFlag(FLAGS_python3_library_paths);
 }
+bool Py3UseZygote() { return absl::GetFlag(FLAGS_python3_zygote); }
 std::string Py2InterpreterPath() { return absl::GetFlag(FLAGS_python2_path); }
 std::vector<std::string> Py2LibraryPaths() {
   return absl::GetFlag(FLAGS_python2_library_paths);
@@ -22,6 +22,8 @@ namespace deepmind::code_contests {
 
 std::string Py3InterpreterPath();
 std::vector<std::string> Py3LibraryPaths();
+// Whether Python 3 tests are forked from zygotes, see py_zygote.h.
+bool Py3UseZygote();
 std::string Py2InterpreterPath();
 std::vector<std::string> Py2LibraryPaths();
 
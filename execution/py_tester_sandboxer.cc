@@ -16,12 +16,14 @@
 
 #include <asm/unistd_64.h>
 #include <stdio.h>
+#include <sys/stat.h>
 #include <sys/syscall.h>
 
 #include <filesystem>
 #include <fstream>
 #include <memory>
 #include <string>
+#include <system_error>
 #include <type_traits>
 #include <vector>
 
@@ -32,6 +34,8 @@
 #include "absl/strings/string_view.h"
 #include "absl/time/time.h"
 #include "absl/types/span.h"
+#include "execution/policy_cache.h"
+#include "execution/py_zygote.h"
 #include "execution/status_macros.h"
 #include "execution/temp_path.h"
 #include "execution/tester_sandboxer.h"
@@ -46,16 +50,45 @@ namespace deepmind::code_contests {
 namespace {
 constexpr absl::string_view kCodeFile = "code.py";
 constexpr absl::string_view kBinaryFile = "code.pyc";
+
+// Identifies the file at `path`, following symlinks, by its size and
+// modification time, which change when it is upgraded in place.
+std::string FileVersion(const std::string& path) {
+  std::error_code error;
+  const std::filesystem::path resolved =
+      std::filesystem::canonical(path, error);
+  struct stat st;
+  if (error || stat(resolved.c_str(), &st) != 0) return "unknown";
+  return absl::StrCat(resolved.string(), " ", st.st_size, " ",
+                      st.st_mtim.tv_sec, ".", st.st_mtim.tv_nsec);
+}
 }  // namespace
 
+PyTesterSandboxer::PyTesterSandboxer(
+    absl::Span<const std::string> compilation_command,
+    absl::Span<const std::string> execution_command,
+    const std::vector<std::string>& library_paths, std::string code_preamble,
+    const bool use_zygote)
+    : compilation_command_(compilation_command.begin(),
+                           compilation_command.end()),
+      execution_command_(execution_command.begin(), execution_command.end()),
+      library_paths_(library_paths.begin(), library_paths.end()),
+      code_preamble_(std::move(code_preamble)),
+      interpreter_version_(FileVersion(execution_command_.front())) {
+  if (use_zygote) {
+    zygotes_ = std::make_unique<PyZygotePool>(
+        execution_command_.front(), [this] { return CreateZygotePolicy(); });
+  }
+}
+
 Py3TesterSandboxer::Py3TesterSandboxer(
     const std::string& interpreter_path,
-    const std::vector<std::string>& library_paths)
+    const std::vector<std::string>& library_paths, const bool use_zygote)
     : PyTesterSandboxer(
           /*compilation_command=*/{interpreter_path, "-m", "py_compile"},
           /*execution_command=*/{interpreter_path},
           /*library_paths=*/library_paths,
-          /*code_preamble=*/"") {}
+          /*code_preamble=*/"", use_zygote) {}
 
 Py2TesterSandboxer::Py2TesterSandboxer(
     const std::string& interpreter_path,
@@ -66,6 +99,17 @@ Py2TesterSandboxer::Py2TesterSandboxer(
           /*library_paths=*/library_paths,
           /*code_preamble=*/"\xef\xbb\xbf") {}
 
+std::string PyTesterSandboxer::CompilerId() const {
+  // Results depend on the interpreter that ran the bytecode and its libraries
+  // as much as on the one that compiled it. Neither the commands nor program
+  // hashes, which leave out the bytecode's magic number, change when the
+  // interpreter is upgraded in place, so its version is part of the id.
+  return absl::StrCat(absl::StrJoin(compilation_command_, " "), "\n",
+                      absl::StrJoin(execution_command_, " "), "\n",
+                      absl::StrJoin(library_paths_, ":"), "\n",
+                      interpreter_version_);
+}
+
 absl::StatusOr<ExecutionResult> PyTesterSandboxer::CompileCode(
     absl::string_view code, absl::string_view temp_path,
     absl::Duration max_compilation_duration) const {
@@ -80,7 +124,7 @@ absl::StatusOr<ExecutionResult> PyTesterSandboxer::CompileCode(
       SandboxWithOutputFds sandbox_with_fds,
       CreateSandboxWithFds(
           /*command=*/compilation_command,
-          /*stdin_data=*/"",
+          /*stdin_data=*/TestData(""),
           /*ro_files=*/{},
           /*ro_dirs=*/{}, /*rw_dirs=*/{std::string(temp_path)},
           TestOptions{.max_execution_duration = max_compilation_duration}));
@@ -139,7 +183,7 @@ absl::StatusOr<ExecutionResult> PyTesterSandboxer::CompileCode(
 }
 
 absl::StatusOr<SandboxWithOutputFds> PyTesterSandboxer::CreateTestSandbox(
-    absl::string_view test_input, const TestOptions& test_options,
+    const TestData& test_input, const TestOptions& test_options,
     absl::string_view temp_path) const {
   const std::filesystem::path temp_fs_path(temp_path);
   std::vector<std::string> execution_command = execution_command_;
@@ -153,11 +197,50 @@ absl::StatusOr<SandboxWithOutputFds> PyTesterSandboxer::CreateTestSandbox(
       /*ro_dirs=*/{}, /*rw_dirs=*/{std::string(temp_path)}, test_options);
 }
 
+absl::StatusOr<ExecutionResult> PyTesterSandboxer::RunCodeOnInput(
+    const TestData& test_input, const TestOptions& test_options,
+    absl::string_view temp_path, StreamingOutputComparator* comparator,
+    RunningPrograms* running) const {
+  if (zygotes_ == nullptr) {
+    return TesterSandboxer::RunCodeOnInput(test_input, test_options, temp_path,
+                                           comparator, running);
+  }
+  return zygotes_->Run(
+      (std::filesystem::path(temp_path) / kBinaryFile).string(), test_input,
+      test_options, comparator, running);
+}
+
 absl::StatusOr<std::unique_ptr<sandbox2::Policy>>
 PyTesterSandboxer::CreatePolicy(absl::string_view binary_path,
                                 const std::vector<std::string>& ro_files,
                                 const std::vector<std::string>& ro_dirs,
                                 const std::vector<std::string>& rw_dirs) const {
+  return policies_.Build(
+      PolicyCacheKey{.binary = std::string(binary_path),
+                     .ro_files = ro_files,
+                     .ro_dirs = ro_dirs,
+                     .rw_dirs = rw_dirs,
+                     .library_paths = library_paths_},
+      [&] {
+        return CreatePolicyBuilder(binary_path, ro_files, ro_dirs, rw_dirs);
+      });
+}
+
+absl::StatusOr<std::unique_ptr<sandbox2::Policy>>
+PyTesterSandboxer::CreateZygotePolicy() const {
+  // Programs are sent to the zygote, so it needs no access to their
+  // directories.
+  sandbox2::PolicyBuilder builder = CreatePolicyBuilder(
+      execution_command_.front(), /*ro_files=*/{}, /*ro_dirs=*/{},
+      /*rw_dirs=*/{});
+  AllowPyZygote(builder, library_paths_);
+  return builder.TryBuild();
+}
+
+sandbox2::PolicyBuilder PyTesterSandboxer::CreatePolicyBuilder(
+    absl::string_view binary_path, const std::vector<std::string>& ro_files,
+    const std::vector<std::string>& ro_dirs,
+    const std::vector<std::string>& rw_dirs) const {
   sandbox2::PolicyBuilder builder = internal::CreateBasePolicy(
       binary_path,
       internal::Mappings{
@@ -189,7 +272,7 @@ PyTesterSandboxer::CreatePolicy(absl::string_view binary_path,
   // Map the binary so it can be executed with execveat.
   builder.AddFileAt(cwd_path.append(binary_path).string(), "/dev/fd/1022");
 
-  return builder.TryBuild();
+  return builder;
 }
 
 }  // namespace deepmind::code_contests
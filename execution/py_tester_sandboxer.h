@@ -24,48 +24,75 @@
 #include "absl/strings/string_view.h"
 #include "absl/time/time.h"
 #include "absl/types/span.h"
+#include "execution/policy_cache.h"
+#include "execution/py_zygote.h"
 #include "execution/temp_path.h"
+#include "execution/test_data.h"
 #include "execution/tester_sandboxer.h"
 #include "sandboxed_api/sandbox2/policy.h"
+#include "sandboxed_api/sandbox2/policybuilder.h"
 
 namespace deepmind::code_contests {
 
 class PyTesterSandboxer : public TesterSandboxer {
  public:
   // The commands should not include the code/binary filename, which will be
-  // appended automatically.
+  // appended automatically. If `use_zygote` is set, tests are forked from
+  // interpreters that are already running, see py_zygote.h. This requires a
+  // Python 3 interpreter.
   PyTesterSandboxer(absl::Span<const std::string> compilation_command,
                     absl::Span<const std::string> execution_command,
                     const std::vector<std::string>& library_paths,
-                    std::string code_preamble)
-      : compilation_command_(compilation_command.begin(),
-                             compilation_command.end()),
-        execution_command_(execution_command.begin(), execution_command.end()),
-        library_paths_(library_paths.begin(), library_paths.end()),
-        code_preamble_(std::move(code_preamble)) {}
+                    std::string code_preamble, bool use_zygote = false);
+
+  // The zygotes that tests run in, or nullptr if every test runs in a sandbox
+  // of its own.
+  const PyZygotePool* zygotes() const { return zygotes_.get(); }
+
+  // How often policies were built from cached builders, and the time spent
+  // building them.
+  PolicyCacheStats policy_stats() const { return policies_.stats(); }
 
  private:
+  std::string CompilerId() const override;
   absl::StatusOr<ExecutionResult> CompileCode(
       absl::string_view code, absl::string_view temp_path,
       absl::Duration max_compilation_duration) const override;
   absl::StatusOr<SandboxWithOutputFds> CreateTestSandbox(
-      absl::string_view test_input, const TestOptions& test_options,
+      const TestData& test_input, const TestOptions& test_options,
       absl::string_view temp_path) const override;
   absl::StatusOr<std::unique_ptr<sandbox2::Policy>> CreatePolicy(
       absl::string_view binary_path, const std::vector<std::string>& ro_files,
       const std::vector<std::string>& ro_dirs,
       const std::vector<std::string>& rw_dirs) const override;
+  absl::StatusOr<ExecutionResult> RunCodeOnInput(
+      const TestData& test_input, const TestOptions& test_options,
+      absl::string_view temp_path, StreamingOutputComparator* comparator,
+      RunningPrograms* running) const override;
+
+  sandbox2::PolicyBuilder CreatePolicyBuilder(
+      absl::string_view binary_path, const std::vector<std::string>& ro_files,
+      const std::vector<std::string>& ro_dirs,
+      const std::vector<std::string>& rw_dirs) const;
+  // The policy of tests, plus what zygotes need to fork them.
+  absl::StatusOr<std::unique_ptr<sandbox2::Policy>> CreateZygotePolicy() const;
 
   std::vector<std::string> compilation_command_;
   std::vector<std::string> execution_command_;
   std::vector<std::string> library_paths_;
   std::string code_preamble_;
+  // Identifies the installed version of the interpreter, see CompilerId.
+  std::string interpreter_version_;
+  std::unique_ptr<PyZygotePool> zygotes_;
+  // Compilation and every test of a program share their policies' builders.
+  mutable PolicyCache policies_;
 };
 
 class Py3TesterSandboxer : public PyTesterSandboxer {
  public:
   explicit Py3TesterSandboxer(const std::string& interpreter_path,
-                              const std::vector<std::string>& library_paths);
+                              const std::vector<std::string>& library_paths,
+                              bool use_zygote = false);
 };
 
 class Py2TesterSandboxer : public PyTesterSandboxer {
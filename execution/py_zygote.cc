@@ -0,0 +1,589 @@
+// Copyright 2022 DeepMind Technologies Limited
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "execution/py_zygote.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include "absl/memory/memory.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/match.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "absl/strings/substitute.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "absl/types/span.h"
+#include "execution/output_collector.h"
+#include "execution/status_macros.h"
+#include "execution/test_data.h"
+#include "execution/tester_sandboxer.h"
+#include "sandboxed_api/sandbox2/buffer.h"
+#include "sandboxed_api/sandbox2/executor.h"
+#include "sandboxed_api/sandbox2/policy.h"
+#include "sandboxed_api/sandbox2/policybuilder.h"
+#include "sandboxed_api/sandbox2/result.h"
+#include "sandboxed_api/sandbox2/sandbox2.h"
+#include "sandboxed_api/sandbox2/util/bpf_helper.h"
+
+namespace deepmind::code_contests {
+
+namespace {
+
+// The file descriptor of the zygote's end of the socket that tests are sent
+// over.
+constexpr int kControlFd = 3;
+
+// How long a zygote may take to start.
+constexpr absl::Duration kStartTimeout = absl::Seconds(60);
+
+// The zygote itself. It receives tests as a message of the form
+// "<key>\n<path>\n<cpu seconds>\n<memory bytes>" along with the file
+// descriptors of the test's stdin, stdout and stderr and of the compiled
+// program, and replies with the wait status of the child that ran the test.
+// Code objects are kept by key, so that a program is only loaded once.
+constexpr absl::string_view kZygoteScript = R"py(
+import array
+import builtins
+import collections
+import ctypes
+import gc
+import marshal
+import os
+import random
+import resource
+import socket
+import struct
+import sys
+import traceback
+
+# Modules that solutions commonly import are imported once, by the zygote.
+for name in ('bisect', 'collections', 'copy', 'decimal', 'fractions',
+             'functools', 'heapq', 'io', 'itertools', 'math', 'operator',
+             'random', 're', 'string'):
+  try:
+    __import__(name)
+  except ImportError:
+    pass
+
+control = socket.socket(fileno=3)
+
+# A seccomp filter that fails clone unless it creates a thread, so that forked
+# programs cannot fork themselves, and fails the other syscalls that the policy
+# only allows for the zygote.
+CLONE_THREAD = 0x10000
+ZYGOTE_SYSCALLS = (
+    61,  # wait4
+    47,  # recvmsg
+    33,  # dup2
+    292,  # dup3
+    273,  # set_robust_list
+    317,  # seccomp
+    160,  # setrlimit
+    302,  # prlimit64
+)
+filter_ops = [
+    (0x20, 0, 0, 0),  # Load the syscall number.
+    (0x15, 0, 2, 56),  # If it is clone, load the low word of the flags.
+    (0x20, 0, 0, 16),
+    # If they create a thread, allow it, and fail it otherwise.
+    (0x45, len(ZYGOTE_SYSCALLS), len(ZYGOTE_SYSCALLS) + 1, CLONE_THREAD),
+]
+for i, number in enumerate(ZYGOTE_SYSCALLS):
+  # If it is a zygote syscall, fail it.
+  filter_ops.append((0x15, len(ZYGOTE_SYSCALLS) - i, 0, number))
+filter_ops += [
+    (0x06, 0, 0, 0x7fff0000),  # Allow.
+    (0x06, 0, 0, 0x00050001),  # Fail with EPERM.
+]
+filter_code = b''.join(struct.pack('HBBI', *op) for op in filter_ops)
+filter_buffer = ctypes.create_string_buffer(filter_code, len(filter_code))
+
+
+class SockFprog(ctypes.Structure):
+  _fields_ = [('len', ctypes.c_ushort), ('filter', ctypes.c_void_p)]
+
+
+filter_program = SockFprog(len(filter_code) // 8,
+                           ctypes.addressof(filter_buffer))
+syscall = ctypes.CDLL(None, use_errno=True).syscall
+SYS_SECCOMP = 317
+SECCOMP_SET_MODE_FILTER = 1
+
+# The code objects of recently tested programs, by key.
+codes = collections.OrderedDict()
+
+
+def load(key, code_fd):
+  code = codes.pop(key, None)
+  if code is None:
+    with os.fdopen(code_fd, 'rb', closefd=False) as f:
+      # Skip the header of the bytecode file.
+      code = marshal.loads(f.read()[16:])
+  codes[key] = code
+  while len(codes) > 16:
+    codes.popitem(last=False)
+  return code
+
+
+def exit_status(code):
+  if code is None:
+    return 0
+  if isinstance(code, int):
+    return code
+  sys.stderr.write('%s\n' % code)
+  return 1
+
+
+def run(code, path, stdin, stdout, stderr, cpu_seconds, memory_bytes):
+  os.dup2(stdin, 0)
+  os.dup2(stdout, 1)
+  os.dup2(stderr, 2)
+  for fd in (stdin, stdout, stderr):
+    os.close(fd)
+  control.close()
+  # Children would otherwise all draw the same numbers as the zygote. Python
+  # 3.7 and later also reseed after fork, but earlier versions do not.
+  random.seed()
+  resource.setrlimit(resource.RLIMIT_CPU, (cpu_seconds, cpu_seconds))
+  if memory_bytes > 0:
+    resource.setrlimit(resource.RLIMIT_AS, (memory_bytes, memory_bytes))
+  # The filter fails setrlimit and seccomp, so it goes last.
+  if syscall(SYS_SECCOMP, SECCOMP_SET_MODE_FILTER, 0,
+             ctypes.byref(filter_program)) != 0:
+    os._exit(126)
+  sys.argv = [path]
+  status = 0
+  try:
+    exec(code, {'__name__': '__main__', '__file__': path,
+                '__builtins__': builtins})
+  except SystemExit as e:
+    status = exit_status(e.code)
+  except BaseException as e:
+    # Leave this function out of the traceback.
+    traceback.print_exception(type(e), e, e.__traceback__.tb_next)
+    status = 1
+  for stream in (sys.stdout, sys.stderr):
+    try:
+      stream.flush()
+    except Exception:
+      status = status or 120
+  os._exit(status)
+
+
+def serve():
+  while True:
+    fds = array.array('i')
+    message, ancillary, _, _ = control.recvmsg(
+        4096, socket.CMSG_SPACE(4 * fds.itemsize))
+    for level, kind, data in ancillary:
+      if level == socket.SOL_SOCKET and kind == socket.SCM_RIGHTS:
+        fds.frombytes(data[:len(data) - len(data) % fds.itemsize])
+    if not message:
+      return
+    key, path, cpu_seconds, memory_bytes = message.decode().split('\n')
+    stdin, stdout, stderr, code_fd = fds
+    try:
+      code = load(key, code_fd)
+    except Exception:
+      os.write(stderr, traceback.format_exc().encode())
+      status = 1 << 8
+    else:
+      pid = os.fork()
+      if pid == 0:
+        try:
+          run(code, path, stdin, stdout, stderr, int(cpu_seconds),
+              int(memory_bytes))
+        finally:
+          os._exit(127)
+      status = os.waitpid(pid, 0)[1]
+    for fd in fds:
+      os.close(fd)
+    os.write(3, b'%d' % status)
+
+
+gc.freeze()
+os.write(3, b'ready')
+serve()
+)py";
+
+// Owns a file descriptor.
+class ScopedFd {
+ public:
+  explicit ScopedFd(const int fd = -1) : fd_(fd) {}
+  ScopedFd(const ScopedFd&) = delete;
+  ScopedFd& operator=(const ScopedFd&) = delete;
+  ~ScopedFd() { Reset(); }
+
+  int get() const { return fd_; }
+  bool valid() const { return fd_ >= 0; }
+  void Reset(const int fd = -1) {
+    if (fd_ >= 0) close(fd_);
+    fd_ = fd;
+  }
+  int Release() {
+    const int fd = fd_;
+    fd_ = -1;
+    return fd;
+  }
+
+ private:
+  int fd_;
+};
+
+absl::Status MakePipe(ScopedFd& read_end, ScopedFd& write_end) {
+  int fds[2];
+  if (pipe2(fds, O_CLOEXEC) != 0) {
+    return absl::UnavailableError(
+        absl::StrCat("Creating a pipe failed: errno ", errno));
+  }
+  read_end.Reset(fds[0]);
+  write_end.Reset(fds[1]);
+  return absl::OkStatus();
+}
+
+absl::Status SendWithFds(const int socket_fd, const absl::string_view message,
+                         absl::Span<const int> fds) {
+  struct iovec iov;
+  iov.iov_base = const_cast<char*>(message.data());
+  iov.iov_len = message.size();
+  std::vector<char> control(CMSG_SPACE(sizeof(int) * fds.size()));
+  struct msghdr header = {};
+  header.msg_iov = &iov;
+  header.msg_iovlen = 1;
+  header.msg_control = control.data();
+  header.msg_controllen = control.size();
+  struct cmsghdr* const control_header = CMSG_FIRSTHDR(&header);
+  control_header->cmsg_level = SOL_SOCKET;
+  control_header->cmsg_type = SCM_RIGHTS;
+  control_header->cmsg_len = CMSG_LEN(sizeof(int) * fds.size());
+  std::memcpy(CMSG_DATA(control_header), fds.data(), sizeof(int) * fds.size());
+  ssize_t sent;
+  do {
+    sent = sendmsg(socket_fd, &header, MSG_NOSIGNAL);
+  } while (sent < 0 && errno == EINTR);
+  if (sent != message.size()) {
+    return absl::UnavailableError(
+        absl::StrCat("Sending a test to the Python zygote failed: errno ",
+                     errno));
+  }
+  return absl::OkStatus();
+}
+
+// Waits up to `timeout` for a message on `fd`. Returns an empty message if the
+// other end was closed, and DeadlineExceeded if nothing arrived in time.
+absl::StatusOr<std::string> Receive(const int fd,
+                                    const absl::Duration timeout) {
+  const absl::Time deadline = absl::Now() + timeout;
+  struct pollfd poll_fd = {.fd = fd, .events = POLLIN};
+  int ready;
+  do {
+    ready = poll(&poll_fd, 1,
+                 absl::ToInt64Milliseconds(
+                     std::max(deadline - absl::Now(), absl::ZeroDuration())));
+  } while (ready < 0 && errno == EINTR);
+  if (ready == 0) {
+    return absl::DeadlineExceededError("No reply from the Python zygote.");
+  }
+  char buffer[64];
+  const ssize_t size = ready < 0 ? -1 : read(fd, buffer, sizeof(buffer));
+  if (size < 0) {
+    return absl::UnavailableError(absl::StrCat(
+        "Receiving from the Python zygote failed: errno ", errno));
+  }
+  return std::string(buffer, size);
+}
+
+}  // namespace
+
+void AllowPyZygote(sandbox2::PolicyBuilder& builder,
+                   const std::vector<std::string>& library_paths) {
+  // fork() as glibc implements it. Children add a filter that fails this and
+  // the other syscalls below.
+  builder.AddPolicyOnSyscall(
+      __NR_clone, {
+                      ARG_32(0),
+                      JEQ32(CLONE_CHILD_SETTID | CLONE_CHILD_CLEARTID | SIGCHLD,
+                            ALLOW),
+                  });
+  builder.AllowSyscalls({
+      __NR_wait4,
+      __NR_recvmsg,
+      __NR_dup2,
+      __NR_dup3,
+      __NR_set_robust_list,
+      __NR_seccomp,
+      __NR_setrlimit,
+  });
+  // Limits may only be lowered, as the sandbox has no capabilities.
+  builder.AddPolicyOnSyscall(__NR_prlimit64, {
+                                                 ARG(0),
+                                                 JEQ(0, ALLOW),
+                                             });
+  // The zygote adds filters with ctypes, whose libraries are not those of the
+  // interpreter.
+  for (const std::string& path : library_paths) {
+    std::error_code error;
+    for (const std::filesystem::directory_entry& entry :
+         std::filesystem::directory_iterator(
+             std::filesystem::path(path) / "lib-dynload", error)) {
+      if (absl::StartsWith(entry.path().filename().string(), "_ctypes")) {
+        builder.AddLibrariesForBinary(entry.path().string());
+      }
+    }
+  }
+}
+
+absl::StatusOr<std::unique_ptr<PyZygote>> PyZygote::Start(
+    const std::string& interpreter_path, const PolicyFactory& create_policy) {
+  int sockets[2];
+  if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, sockets) != 0) {
+    return absl::UnavailableError(
+        absl::StrCat("Creating a socket for the Python zygote failed: errno ",
+                     errno));
+  }
+  ScopedFd control(sockets[0]);
+
+  auto executor = absl::make_unique<sandbox2::Executor>(
+      interpreter_path,
+      std::vector<std::string>{interpreter_path, "-c",
+                               std::string(kZygoteScript)},
+      CopyEnviron());
+  // Forked children lower these to the limits of their test.
+  executor->set_enable_sandbox_before_exec(true)
+      .limits()
+      ->set_rlimit_as(RLIM64_INFINITY)
+      .set_rlimit_core(0)
+      .set_rlimit_fsize(64ULL << 20)  // 64 MiB
+      .set_rlimit_cpu(RLIM64_INFINITY);
+  executor->ipc()->MapFd(open("/dev/null", O_RDONLY), STDIN_FILENO);
+  executor->ipc()->MapFd(open("/dev/null", O_WRONLY), STDOUT_FILENO);
+  ScopedFd stderr_fd(executor->ipc()->ReceiveFd(STDERR_FILENO));
+  executor->ipc()->MapFd(sockets[1], kControlFd);
+
+  ASSIGN_OR_RETURN(std::unique_ptr<sandbox2::Policy> policy, create_policy());
+  auto sandbox = absl::make_unique<sandbox2::Sandbox2>(std::move(executor),
+                                                       std::move(policy));
+  if (!sandbox->RunAsync()) {
+    return absl::UnknownError("Failed to run the Python zygote's sandbox.");
+  }
+  std::unique_ptr<PyZygote> zygote = absl::WrapUnique(
+      new PyZygote(std::move(sandbox), control.Release()));
+
+  absl::StatusOr<std::string> ready = Receive(zygote->control_fd_,
+                                              kStartTimeout);
+  if (ready.ok() && *ready == "ready") {
+    // The zygote only writes to stderr if it fails.
+    return zygote;
+  }
+  const sandbox2::Result result = zygote->Stop();
+  absl::StatusOr<std::string> stderr_contents =
+      internal::ReadFd(stderr_fd.get());
+  return absl::UnavailableError(absl::StrCat(
+      "The Python zygote failed to start: ", result.ToString(), "\n",
+      stderr_contents.value_or("")));
+}
+
+PyZygote::PyZygote(std::unique_ptr<sandbox2::Sandbox2> sandbox,
+                   const int control_fd)
+    : sandbox_(std::move(sandbox)), control_fd_(control_fd) {}
+
+PyZygote::~PyZygote() {
+  if (alive_) Stop();
+  close(control_fd_);
+}
+
+sandbox2::Result PyZygote::Stop() {
+  alive_ = false;
+  sandbox_->Kill();
+  return sandbox_->AwaitResult();
+}
+
+absl::StatusOr<ExecutionResult> PyZygote::Run(
+    const std::string& binary_path, const TestData& test_input,
+    const TestOptions& test_options, StreamingOutputComparator* comparator,
+    RunningPrograms* running) {
+  if (!alive_) {
+    return absl::FailedPreconditionError("The Python zygote has stopped.");
+  }
+  // Inputs are written to a buffer, as for sandboxes of their own. Empty
+  // inputs are a pipe that is closed straight away.
+  std::unique_ptr<sandbox2::Buffer> input_buffer;
+  ScopedFd stdin_read, stdin_write;
+  if (test_input.size() > 0) {
+    ASSIGN_OR_RETURN(input_buffer,
+                     sandbox2::Buffer::CreateWithSize(test_input.size()));
+    RETURN_IF_ERROR(test_input.CopyTo(absl::MakeSpan(
+        reinterpret_cast<char*>(input_buffer->data()), test_input.size())));
+  } else {
+    RETURN_IF_ERROR(MakePipe(stdin_read, stdin_write));
+    stdin_write.Reset();
+  }
+  ScopedFd stdout_read, stdout_write, stderr_read, stderr_write;
+  RETURN_IF_ERROR(MakePipe(stdout_read, stdout_write));
+  RETURN_IF_ERROR(MakePipe(stderr_read, stderr_write));
+  ScopedFd code(open(binary_path.c_str(), O_RDONLY | O_CLOEXEC));
+  struct stat st;
+  if (!code.valid() || fstat(code.get(), &st) != 0) {
+    return absl::NotFoundError(
+        absl::Substitute("Unable to open $0: errno $1", binary_path, errno));
+  }
+
+  // The key identifies the file rather than just its path, as paths of
+  // temporary directories may be reused.
+  const int64_t cpu_seconds =
+      internal::CpuLimitSeconds(test_options.max_execution_duration);
+  const int64_t memory_bytes =
+      sapi::sanitizers::IsAny() ? 0
+                                : test_options.memory_limit_bytes + (32LL << 20);
+  const std::string request = absl::StrCat(
+      binary_path, ":", st.st_ino, ":", st.st_mtim.tv_sec, ".",
+      st.st_mtim.tv_nsec, "\n", binary_path, "\n", cpu_seconds, "\n",
+      memory_bytes);
+  const int fds[] = {
+      input_buffer != nullptr ? input_buffer->fd() : stdin_read.get(),
+      stdout_write.get(), stderr_write.get(), code.get()};
+  const absl::Time start_time = absl::Now();
+  if (absl::Status sent = SendWithFds(control_fd_, request, fds); !sent.ok()) {
+    Stop();
+    return sent;
+  }
+  // Only the child may hold the write ends, so that reading ends once it has
+  // exited.
+  stdout_write.Reset();
+  stderr_write.Reset();
+
+  OutputCollector::ChunkCallback on_chunk;
+  if (comparator != nullptr) {
+    // Only the whole zygote can be killed from outside its sandbox.
+    on_chunk = [&](const int index, const absl::string_view chunk) {
+      if (index != 0 || comparator->Add(chunk)) return true;
+      sandbox_->Kill();
+      return false;
+    };
+  }
+  absl::StatusOr<OutputCollector::Collection> collection =
+      OutputCollector::Shared().Collect({stdout_read.get(), stderr_read.get()},
+                                        std::move(on_chunk));
+  if (!collection.ok()) {
+    Stop();
+    return collection.status();
+  }
+  RunningPrograms::Registration registration =
+      running != nullptr ? running->Add([this] { sandbox_->Kill(); })
+                         : RunningPrograms::Registration();
+  // Set a wall time limit to guard against code that sleeps forever.
+  const sandbox2::Result result =
+      AwaitChild(test_options.max_execution_duration * 30);
+  const bool killed = registration.Finish();
+  // A child whose wait status arrived exited by itself, and keeps its result
+  // even if the zygote was killed afterwards.
+  const bool cancelled =
+      killed && result.final_status() == sandbox2::Result::EXTERNAL_KILL;
+  ASSIGN_OR_RETURN(std::vector<std::string> contents, collection->Await());
+  // The child may have finished before the zygote was killed.
+  if (((comparator != nullptr && comparator->mismatched()) || killed) &&
+      alive_) {
+    Stop();
+  }
+  const absl::Time end_time = absl::Now();
+  ExecutionResult execution_result =
+      internal::ExecutionResultFromTestSandboxResult(result);
+  if (cancelled) execution_result.program_status = ProgramStatus::kCancelled;
+  execution_result.stdout = std::move(contents[0]);
+  execution_result.stderr = std::move(contents[1]);
+  execution_result.execution_duration = end_time - start_time;
+  return execution_result;
+}
+
+sandbox2::Result PyZygote::AwaitChild(const absl::Duration timeout) {
+  absl::StatusOr<std::string> reply = Receive(control_fd_, timeout);
+  int wait_status;
+  if (reply.ok() && absl::SimpleAtoi(*reply, &wait_status)) {
+    sandbox2::Result result;
+    if (WIFEXITED(wait_status)) {
+      result.SetExitStatusCode(sandbox2::Result::OK, WEXITSTATUS(wait_status));
+    } else {
+      result.SetExitStatusCode(sandbox2::Result::SIGNALED,
+                               WTERMSIG(wait_status));
+    }
+    return result;
+  }
+  if (absl::IsDeadlineExceeded(reply.status())) {
+    // The child cannot be killed from outside the sandbox, so the whole
+    // zygote is.
+    Stop();
+    sandbox2::Result result;
+    result.SetExitStatusCode(sandbox2::Result::TIMEOUT, 0);
+    return result;
+  }
+  // The zygote exited, which ends the sandbox along with the child, e.g.
+  // because the child violated the policy.
+  return Stop();
+}
+
+absl::StatusOr<ExecutionResult> PyZygotePool::Run(
+    const std::string& binary_path, const TestData& test_input,
+    const TestOptions& test_options, StreamingOutputComparator* comparator,
+    RunningPrograms* running) {
+  std::unique_ptr<PyZygote> zygote;
+  {
+    absl::MutexLock l(&mutex_);
+    if (!idle_.empty()) {
+      zygote = std::move(idle_.back());
+      idle_.pop_back();
+    } else {
+      ++num_started_;
+    }
+  }
+  if (zygote == nullptr) {
+    ASSIGN_OR_RETURN(zygote, PyZygote::Start(interpreter_path_, create_policy_));
+  }
+  absl::StatusOr<ExecutionResult> result =
+      zygote->Run(binary_path, test_input, test_options, comparator, running);
+  if (zygote->alive()) {
+    absl::MutexLock l(&mutex_);
+    idle_.push_back(std::move(zygote));
+  }
+  return result;
+}
+
+int PyZygotePool::num_started() const {
+  absl::MutexLock l(&mutex_);
+  return num_started_;
+}
+
+}  // namespace deepmind::code_contests
@@ -0,0 +1,142 @@
+// Copyright 2022 DeepMind Technologies Limited
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Runs compiled Python 3 programs by forking them from a pre-initialized
+// interpreter, a "zygote", rather than starting an interpreter for every test.
+//
+// Starting an interpreter, importing site and loading the standard library
+// takes tens of milliseconds, which is more than most tests take to run. A
+// zygote pays for that once: it is started in a sandbox with the policy of
+// the tests plus what it needs to fork, and then, for every test, receives
+// the test's stdin, stdout and stderr and the compiled program over a socket.
+// It forks a child that runs the program on those, under the limits of the
+// test, and replies with the child's wait status.
+//
+// Forked children cannot fork themselves: before running the program, they add
+// a seccomp filter that only lets clone create threads, as the policy of the
+// tests does, and that fails the other syscalls only the zygote needs, such as
+// wait4 and setrlimit. A zygote runs one test at a time, so tests never share a
+// sandbox with a concurrently running test. A program that outlives its wall
+// time limit, violates the policy, or is killed for its output (see
+// TestOptions::stream_outputs), takes its zygote down with it, and the next
+// test starts a new one.
+
+#ifndef THIRD_PARTY_DEEPMIND_CODE_CONTESTS_EXECUTION_PY_ZYGOTE_H_
+#define THIRD_PARTY_DEEPMIND_CODE_CONTESTS_EXECUTION_PY_ZYGOTE_H_
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "execution/test_data.h"
+#include "execution/tester_sandboxer.h"
+#include "sandboxed_api/sandbox2/policy.h"
+#include "sandboxed_api/sandbox2/policybuilder.h"
+#include "sandboxed_api/sandbox2/result.h"
+#include "sandboxed_api/sandbox2/sandbox2.h"
+
+namespace deepmind::code_contests {
+
+// Allows what a zygote needs on top of the policy that tests run under:
+// forking and waiting for children, receiving file descriptors, lowering
+// resource limits and adding seccomp filters. `library_paths` are those of the
+// interpreter, whose ctypes module the zygote uses to add filters.
+void AllowPyZygote(sandbox2::PolicyBuilder& builder,
+                   const std::vector<std::string>& library_paths);
+
+using PolicyFactory =
+    std::function<absl::StatusOr<std::unique_ptr<sandbox2::Policy>>()>;
+
+// A single zygote. Not thread-safe: it runs one test at a time.
+class PyZygote {
+ public:
+  // Starts a zygote running `interpreter_path` in a sandbox with the policy
+  // made by `create_policy`, and waits until it is ready to fork tests.
+  static absl::StatusOr<std::unique_ptr<PyZygote>> Start(
+      const std::string& interpreter_path, const PolicyFactory& create_policy);
+
+  PyZygote(const PyZygote&) = delete;
+  PyZygote& operator=(const PyZygote&) = delete;
+  // Stops the zygote.
+  ~PyZygote();
+
+  // Runs the compiled program at `binary_path` on `test_input`, under the time
+  // and memory limits of `test_options`. Results are as for a test run in a
+  // sandbox of its own. A non-OK status is returned if the test could not be
+  // run. If `comparator` is not null, stdout is added to it as it is read, and
+  // the zygote is stopped once it mismatches. If `running` is not null, the
+  // test is registered there while it runs, and killing it stops the zygote.
+  absl::StatusOr<ExecutionResult> Run(
+      const std::string& binary_path, const TestData& test_input,
+      const TestOptions& test_options,
+      StreamingOutputComparator* comparator = nullptr,
+      RunningPrograms* running = nullptr);
+
+  // Whether the zygote can run further tests.
+  bool alive() const { return alive_; }
+
+ private:
+  PyZygote(std::unique_ptr<sandbox2::Sandbox2> sandbox, int control_fd);
+
+  // Waits up to `timeout` for the wait status of the forked child, and returns
+  // the equivalent result of a sandbox. Stops the zygote if the child did not
+  // finish in time.
+  sandbox2::Result AwaitChild(absl::Duration timeout);
+
+  // Stops the zygote and returns the result of its sandbox.
+  sandbox2::Result Stop();
+
+  std::unique_ptr<sandbox2::Sandbox2> sandbox_;
+  // The host's end of the socket that tests are sent over.
+  int control_fd_;
+  bool alive_ = true;
+};
+
+// Zygotes for running tests on any number of threads. Every test takes an idle
+// zygote, or starts a new one if there is none, so there are as many zygotes
+// as tests have run concurrently. Thread-safe.
+class PyZygotePool {
+ public:
+  PyZygotePool(std::string interpreter_path, PolicyFactory create_policy)
+      : interpreter_path_(std::move(interpreter_path)),
+        create_policy_(std::move(create_policy)) {}
+
+  // As PyZygote::Run.
+  absl::StatusOr<ExecutionResult> Run(
+      const std::string& binary_path, const TestData& test_input,
+      const TestOptions& test_options,
+      StreamingOutputComparator* comparator = nullptr,
+      RunningPrograms* running = nullptr);
+
+  // The number of zygotes started so far.
+  int num_started() const;
+
+ private:
+  const std::string interpreter_path_;
+  const PolicyFactory create_policy_;
+  mutable absl::Mutex mutex_;
+  std::vector<std::unique_ptr<PyZygote>> idle_ ABSL_GUARDED_BY(mutex_);
+  int num_started_ ABSL_GUARDED_BY(mutex_) = 0;
+};
+
+}  // namespace deepmind::code_contests
+
+#endif  // THIRD_PARTY_DEEPMIND_CODE_CONTESTS_EXECUTION_PY_ZYGOTE_H_
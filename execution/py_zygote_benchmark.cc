@@ -0,0 +1,133 @@
+// Copyright 2022 DeepMind Technologies Limited
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Measures the latency of running Python 3 tests in sandboxes of their own,
+// which start an interpreter for every test, and in zygotes, which fork every
+// test from an interpreter that is already running (see py_zygote.h).
+//
+// Every benchmark tests a few small programs, typical of solutions, on
+// --num_tests tests each, and reports the wall time per test as well as the
+// mean of the tests' own execution durations. The first repetition of the
+// zygote benchmark includes starting the zygotes.
+//
+// Example usage:
+//
+//   py_zygote_benchmark --num_tests=200 --num_threads=4
+
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_format.h"
+#include "absl/strings/string_view.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "execution/py_locations.h"
+#include "execution/py_tester_sandboxer.h"
+#include "execution/status_macros.h"
+#include "execution/tester_sandboxer.h"
+
+ABSL_FLAG(int, num_tests, 100, "Number of tests to run each program on.");
+ABSL_FLAG(int, num_threads, 1, "Number of tests to run concurrently.");
+ABSL_FLAG(int, repetitions, 3, "Number of times to run every benchmark.");
+
+namespace {
+
+using ::deepmind::code_contests::ExecutionResult;
+using ::deepmind::code_contests::MultiTestResult;
+using ::deepmind::code_contests::ProgramStatus;
+using ::deepmind::code_contests::Py3InterpreterPath;
+using ::deepmind::code_contests::Py3LibraryPaths;
+using ::deepmind::code_contests::Py3TesterSandboxer;
+using ::deepmind::code_contests::TestOptions;
+
+// Programs that run for far less time than it takes to start an interpreter.
+constexpr absl::string_view kPrograms[] = {
+    "print(sum(map(int, input().split())))",
+    R"py(
+import sys
+from collections import Counter
+words = sys.stdin.read().split()
+print(Counter(words).most_common(1)[0][0])
+)py",
+    R"py(
+import heapq, math
+n = int(input().split()[0])
+print(math.isqrt(n), heapq.nsmallest(2, [n, n // 2, n // 3]))
+)py",
+};
+
+absl::Status Benchmark(const absl::string_view name, const bool use_zygote) {
+  const Py3TesterSandboxer tester(Py3InterpreterPath(), Py3LibraryPaths(),
+                                  use_zygote);
+  TestOptions options;
+  options.num_threads = absl::GetFlag(FLAGS_num_threads);
+  std::vector<std::string> input_storage;
+  for (int i = 0; i < absl::GetFlag(FLAGS_num_tests); ++i) {
+    input_storage.push_back(absl::StrCat(i + 1, " ", i + 2, "\n"));
+  }
+  const std::vector<absl::string_view> inputs(input_storage.begin(),
+                                              input_storage.end());
+
+  for (int r = 0; r < absl::GetFlag(FLAGS_repetitions); ++r) {
+    int num_tests = 0;
+    absl::Duration wall_time;
+    absl::Duration execution_time;
+    for (const absl::string_view program : kPrograms) {
+      const absl::Time start = absl::Now();
+      ASSIGN_OR_RETURN(const MultiTestResult result,
+                       tester.Test(program, inputs, options));
+      wall_time += absl::Now() - start;
+      for (const ExecutionResult& test : result.test_results) {
+        if (test.program_status != ProgramStatus::kSuccess) {
+          return absl::InternalError(
+              absl::StrCat("A test of ", name, " failed: ", test.stderr));
+        }
+        execution_time += test.execution_duration;
+        ++num_tests;
+      }
+    }
+    const double per_test = num_tests == 0 ? 1 : num_tests;
+    std::cout << absl::StrFormat(
+        "%-8s %6d tests %8.3fs %8.2f ms/test wall %8.2f ms/test executing",
+        name, num_tests, absl::ToDoubleSeconds(wall_time),
+        absl::ToDoubleMilliseconds(wall_time) / per_test,
+        absl::ToDoubleMilliseconds(execution_time) / per_test);
+    if (tester.zygotes() != nullptr) {
+      std::cout << absl::StrFormat(" %4d zygotes started",
+                                   tester.zygotes()->num_started());
+    }
+    std::cout << std::endl;
+  }
+  return absl::OkStatus();
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  absl::ParseCommandLine(argc, argv);
+  for (const auto& [name, use_zygote] :
+       {std::pair<absl::string_view, bool>{"exec", false}, {"zygote", true}}) {
+    if (const absl::Status status = Benchmark(name, use_zygote); !status.ok()) {
+      std::cerr << name << " failed: " << status << std::endl;
+      return 1;
+    }
+  }
+}
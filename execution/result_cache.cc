@@ -0,0 +1,110 @@
+// Copyright 2022 DeepMind Technologies Limited
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "execution/result_cache.h"
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "absl/status/statusor.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "execution/status_macros.h"
+#include "execution/test_data.h"
+#include "execution/tester_sandboxer.h"
+#include "farmhash.h"
+
+namespace deepmind::code_contests {
+
+namespace {
+
+void AppendUint64(const uint64_t value, std::string& out) {
+  out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+absl::Status AppendFingerprints(const std::vector<TestData>& tests,
+                                std::string& out) {
+  AppendUint64(tests.size(), out);
+  for (const TestData& test : tests) {
+    if (test.bytes().has_value()) {
+      AppendUint64(farmhash::Fingerprint64(test.bytes()->data(),
+                                           test.bytes()->size()),
+                   out);
+    } else if (test.fingerprint().has_value()) {
+      // Tests that are not in memory are only produced if they have to be.
+      AppendUint64(*test.fingerprint(), out);
+    } else {
+      ASSIGN_OR_RETURN(const std::string contents, test.ToString());
+      AppendUint64(farmhash::Fingerprint64(contents.data(), contents.size()),
+                   out);
+    }
+  }
+  return absl::OkStatus();
+}
+
+}  // namespace
+
+std::optional<std::vector<ExecutionResult>> InMemoryResultCache::Lookup(
+    const ResultCacheKey& key) {
+  absl::MutexLock l(&mutex_);
+  const auto it = results_.find(key);
+  if (it == results_.end()) {
+    ++stats_.misses;
+    return std::nullopt;
+  }
+  ++stats_.hits;
+  return it->second;
+}
+
+void InMemoryResultCache::Insert(
+    const ResultCacheKey& key,
+    const std::vector<ExecutionResult>& test_results) {
+  absl::MutexLock l(&mutex_);
+  results_.insert_or_assign(key, test_results);
+}
+
+ResultCacheStats InMemoryResultCache::stats() const {
+  absl::MutexLock l(&mutex_);
+  return stats_;
+}
+
+absl::StatusOr<uint64_t> HashTests(
+    const std::vector<TestData>& test_inputs,
+    const std::vector<TestData>& expected_test_outputs,
+    const TestOptions& test_options) {
+  std::string fingerprints;
+  fingerprints.reserve(
+      (test_inputs.size() + expected_test_outputs.size() +
+       test_options.test_tiers.size() + 6) *
+      sizeof(uint64_t));
+  RETURN_IF_ERROR(AppendFingerprints(test_inputs, fingerprints));
+  RETURN_IF_ERROR(AppendFingerprints(expected_test_outputs, fingerprints));
+  AppendUint64(absl::ToInt64Nanoseconds(test_options.max_execution_duration),
+               fingerprints);
+  AppendUint64(test_options.memory_limit_bytes, fingerprints);
+  AppendUint64(test_options.stop_on_first_failure, fingerprints);
+  // Tests in tiers that do not run have no results.
+  AppendUint64(test_options.test_tiers.size(), fingerprints);
+  for (const int tier_size : test_options.test_tiers) {
+    AppendUint64(tier_size, fingerprints);
+  }
+  // Programs killed for their output report less of it. Only marked if set,
+  // so that other fingerprints stay the same.
+  if (test_options.stream_outputs) AppendUint64(1, fingerprints);
+  return farmhash::Fingerprint64(fingerprints.data(), fingerprints.size());
+}
+
+}  // namespace deepmind::code_contests
@@ -0,0 +1,110 @@
+// Copyright 2022 DeepMind Technologies Limited
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Caching of test results by program hash.
+//
+// Sampled programs often only differ in whitespace or comments, which
+// compilation discards. Such programs compile to the same program hash (see
+// ExecutionResult::program_hash), and behave the same on every test, so only
+// one of them needs to be run.
+
+#ifndef THIRD_PARTY_DEEPMIND_CODE_CONTESTS_EXECUTION_RESULT_CACHE_H_
+#define THIRD_PARTY_DEEPMIND_CODE_CONTESTS_EXECUTION_RESULT_CACHE_H_
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/status/statusor.h"
+#include "absl/synchronization/mutex.h"
+#include "execution/test_data.h"
+#include "execution/tester_sandboxer.h"
+
+namespace deepmind::code_contests {
+
+struct ResultCacheKey {
+  // Identifies the problem, see TestOptions::problem_id.
+  std::string problem;
+  // Identifies the compiler or interpreter that produced `program_hash`, see
+  // TesterSandboxer::CompilerId.
+  std::string compiler;
+  uint64_t program_hash = 0;
+  // A fingerprint of the tests, and of the options that affect their results.
+  uint64_t tests_hash = 0;
+
+  bool operator==(const ResultCacheKey& other) const {
+    return problem == other.problem && compiler == other.compiler &&
+           program_hash == other.program_hash && tests_hash == other.tests_hash;
+  }
+
+  template <typename H>
+  friend H AbslHashValue(H h, const ResultCacheKey& key) {
+    return H::combine(std::move(h), key.problem, key.compiler,
+                      key.program_hash, key.tests_hash);
+  }
+};
+
+struct ResultCacheStats {
+  int64_t hits = 0;
+  int64_t misses = 0;
+  // The number of results dropped to bound the size of the cache.
+  int64_t evicted = 0;
+};
+
+// A cache of the test results of compiled programs. Implementations must be
+// thread-safe.
+class ResultCache {
+ public:
+  virtual ~ResultCache() = default;
+
+  // Returns the results of the tests for `key`, if there are any.
+  virtual std::optional<std::vector<ExecutionResult>> Lookup(
+      const ResultCacheKey& key) = 0;
+  virtual void Insert(const ResultCacheKey& key,
+                      const std::vector<ExecutionResult>& test_results) = 0;
+
+  virtual ResultCacheStats stats() const = 0;
+};
+
+// A cache that holds results in memory, for as long as it lives.
+class InMemoryResultCache : public ResultCache {
+ public:
+  std::optional<std::vector<ExecutionResult>> Lookup(
+      const ResultCacheKey& key) override;
+  void Insert(const ResultCacheKey& key,
+              const std::vector<ExecutionResult>& test_results) override;
+  ResultCacheStats stats() const override;
+
+ private:
+  mutable absl::Mutex mutex_;
+  absl::flat_hash_map<ResultCacheKey, std::vector<ExecutionResult>> results_
+      ABSL_GUARDED_BY(mutex_);
+  ResultCacheStats stats_ ABSL_GUARDED_BY(mutex_);
+};
+
+// Returns a fingerprint of `test_inputs`, `expected_test_outputs` and the
+// options in `test_options` that may change test results. Tests that are not
+// in memory are produced to be hashed.
+absl::StatusOr<uint64_t> HashTests(
+    const std::vector<TestData>& test_inputs,
+    const std::vector<TestData>& expected_test_outputs,
+    const TestOptions& test_options);
+
+}  // namespace deepmind::code_contests
+
+#endif  // THIRD_PARTY_DEEPMIND_CODE_CONTESTS_EXECUTION_RESULT_CACHE_H_
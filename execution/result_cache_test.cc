@@ -0,0 +1,98 @@
+// Copyright 2022 DeepMind Technologies Limited
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "execution/result_cache.h"
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/time/time.h"
+#include "absl/types/span.h"
+#include "execution/test_data.h"
+#include "execution/tester_sandboxer.h"
+
+namespace deepmind::code_contests {
+namespace {
+
+using ::testing::ElementsAre;
+using ::testing::Field;
+using ::testing::Optional;
+
+ResultCacheKey Key(const uint64_t program_hash) {
+  return {.problem = "problem",
+          .compiler = "python3",
+          .program_hash = program_hash,
+          .tests_hash = 7};
+}
+
+TEST(InMemoryResultCacheTest, ReturnsInsertedResults) {
+  InMemoryResultCache cache;
+  EXPECT_EQ(cache.Lookup(Key(1)), std::nullopt);
+  ExecutionResult result;
+  result.stdout = "42\n";
+  result.passed = true;
+  cache.Insert(Key(1), {result});
+  EXPECT_THAT(cache.Lookup(Key(1)),
+              Optional(ElementsAre(Field(&ExecutionResult::stdout, "42\n"))));
+  ResultCacheKey other_problem = Key(1);
+  other_problem.problem = "other";
+  EXPECT_EQ(cache.Lookup(other_problem), std::nullopt);
+  EXPECT_EQ(cache.stats().hits, 1);
+  EXPECT_EQ(cache.stats().misses, 2);
+}
+
+uint64_t Hash(const std::vector<TestData>& inputs,
+              const std::vector<TestData>& outputs,
+              const TestOptions& options = {}) {
+  const absl::StatusOr<uint64_t> hash = HashTests(inputs, outputs, options);
+  EXPECT_TRUE(hash.ok()) << hash.status();
+  return hash.value_or(0);
+}
+
+TEST(HashTestsTest, DependsOnTestsAndOptions) {
+  const std::vector<TestData> inputs = {TestData("1\n"), TestData("2\n")};
+  const std::vector<TestData> outputs = {TestData("1"), TestData("4")};
+  const uint64_t hash = Hash(inputs, outputs);
+  EXPECT_NE(hash, Hash(inputs, {TestData("1"), TestData("5")}));
+  EXPECT_NE(hash, Hash({TestData("1\n2\n")}, {TestData("14")}));
+  EXPECT_NE(hash, Hash(inputs, outputs,
+                       {.max_execution_duration = absl::Seconds(1)}));
+  // Tests that are produced lazily hash the same as the tests they produce.
+  const std::vector<TestData> lazy_outputs = {
+      TestData(1, [](absl::Span<char> out) {
+        out[0] = '1';
+        return absl::OkStatus();
+      }),
+      TestData(1, [](absl::Span<char> out) {
+        out[0] = '4';
+        return absl::OkStatus();
+      })};
+  EXPECT_EQ(hash, Hash(inputs, lazy_outputs));
+}
+
+TEST(HashTestsTest, UsesFingerprintsOfLazyTests) {
+  const TestData::Fill fail = [](absl::Span<char> out) {
+    return absl::DataLossError("Should not be produced.");
+  };
+  const uint64_t hash = Hash({TestData(1, fail, 1)}, {TestData(1, fail, 2)});
+  EXPECT_NE(hash, Hash({TestData(1, fail, 1)}, {TestData(1, fail, 3)}));
+}
+
+}  // namespace
+}  // namespace deepmind::code_contests
@@ -0,0 +1,194 @@
+// Copyright 2022 DeepMind Technologies Limited
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "execution/result_writer.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <utility>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "absl/strings/substitute.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "execution/json.hpp"
+#include "execution/status_macros.h"
+
+namespace deepmind::code_contests {
+
+namespace {
+
+using json = nlohmann::json;
+
+absl::Status ErrnoError(const absl::string_view what,
+                        const absl::string_view path) {
+  return absl::UnknownError(
+      absl::Substitute("$0 $1 failed: errno $2", what, path, errno));
+}
+
+// Returns the key of `result`, or an error if it has none.
+absl::StatusOr<std::pair<std::string, int>> ResultKey(const json& result) {
+  const auto id = result.find("id");
+  const auto index = result.find("index");
+  if (id == result.end() || !id->is_string() || index == result.end() ||
+      !index->is_number_integer()) {
+    return absl::InvalidArgumentError(
+        "Results need a string \"id\" and an integer \"index\".");
+  }
+  return std::make_pair(id->get<std::string>(), index->get<int>());
+}
+
+bool ResultPassed(const json& result) {
+  const auto passed = result.find("passed");
+  return passed != result.end() && passed->is_boolean() && passed->get<bool>();
+}
+
+// Reads the keys of the results in the file at `path` into `passed`, along with
+// whether they passed, and returns the size of its complete lines. A last line
+// that is incomplete or does not parse is ignored, as a crash may have
+// interrupted writing it.
+absl::StatusOr<int64_t> ReadExistingResults(
+    const std::string& path,
+    absl::flat_hash_map<std::pair<std::string, int>, bool>& passed) {
+  std::ifstream input(path);
+  if (!input) return 0;
+  int64_t valid_size = 0;
+  std::string line;
+  for (int line_number = 1; std::getline(input, line); ++line_number) {
+    const bool complete = !input.eof();
+    const json result = json::parse(line, /*cb=*/nullptr,
+                                    /*allow_exceptions=*/false);
+    absl::StatusOr<std::pair<std::string, int>> key =
+        result.is_discarded() ? absl::InvalidArgumentError("Invalid JSON.")
+                              : ResultKey(result);
+    if (!complete || !key.ok()) {
+      if (input.peek() == std::ifstream::traits_type::eof()) break;
+      return absl::DataLossError(absl::StrCat(
+          path, ":", line_number, ": ", key.status().message()));
+    }
+    passed[*std::move(key)] = ResultPassed(result);
+    valid_size += line.size() + 1;
+  }
+  if (input.bad()) return ErrnoError("Reading", path);
+  return valid_size;
+}
+
+}  // namespace
+
+absl::StatusOr<ResultWriter> ResultWriter::Open(const absl::string_view path,
+                                                ResultWriterOptions options) {
+  std::string path_string(path);
+  absl::flat_hash_map<Key, bool> existing;
+  int flags = O_WRONLY | O_CREAT | O_APPEND;
+  if (options.resume) {
+    ASSIGN_OR_RETURN(const int64_t valid_size,
+                     ReadExistingResults(path_string, existing));
+    if (valid_size > 0 && truncate(path_string.c_str(), valid_size) != 0) {
+      return ErrnoError("Truncating", path);
+    }
+    if (valid_size == 0) flags |= O_TRUNC;
+  } else {
+    flags |= O_TRUNC;
+  }
+  const int fd = open(path_string.c_str(), flags, 0644);
+  if (fd < 0) return ErrnoError("Opening", path);
+  ResultWriter writer(std::move(path_string), fd, std::move(options));
+  writer.num_resumed_ = existing.size();
+  writer.written_ = std::move(existing);
+  return writer;
+}
+
+ResultWriter::ResultWriter(std::string path, const int fd,
+                           ResultWriterOptions options)
+    : path_(std::move(path)),
+      fd_(fd),
+      options_(std::move(options)),
+      last_sync_(absl::Now()) {}
+
+ResultWriter::ResultWriter(ResultWriter&& other)
+    : path_(std::move(other.path_)),
+      fd_(std::exchange(other.fd_, -1)),
+      options_(std::move(other.options_)),
+      written_(std::move(other.written_)),
+      num_resumed_(other.num_resumed_),
+      writes_since_sync_(other.writes_since_sync_),
+      last_sync_(other.last_sync_) {}
+
+ResultWriter::~ResultWriter() {
+  if (fd_ >= 0) {
+    fsync(fd_);
+    close(fd_);
+  }
+}
+
+bool ResultWriter::Contains(const absl::string_view id, const int index) const {
+  return written_.contains(Key(std::string(id), index));
+}
+
+bool ResultWriter::Passed(const absl::string_view id, const int index) const {
+  const auto it = written_.find(Key(std::string(id), index));
+  return it != written_.end() && it->second;
+}
+
+absl::Status ResultWriter::Write(const json& result) {
+  if (fd_ < 0) {
+    return absl::FailedPreconditionError("Result writer already closed.");
+  }
+  ASSIGN_OR_RETURN(Key key, ResultKey(result));
+  // Lines are written with a single append, so that they can only be cut short
+  // by a crash, never interleaved.
+  const std::string line = absl::StrCat(result.dump(), "\n");
+  absl::string_view remaining = line;
+  while (!remaining.empty()) {
+    const ssize_t written = write(fd_, remaining.data(), remaining.size());
+    if (written < 0) {
+      if (errno == EINTR) continue;
+      return ErrnoError("Writing", path_);
+    }
+    remaining.remove_prefix(written);
+  }
+  written_[std::move(key)] = ResultPassed(result);
+  if (++writes_since_sync_ >= options_.sync_every ||
+      absl::Now() - last_sync_ >= options_.sync_interval) {
+    return Sync();
+  }
+  return absl::OkStatus();
+}
+
+absl::Status ResultWriter::Sync() {
+  if (fsync(fd_) != 0) return ErrnoError("Syncing", path_);
+  writes_since_sync_ = 0;
+  last_sync_ = absl::Now();
+  return absl::OkStatus();
+}
+
+absl::Status ResultWriter::Close() {
+  if (fd_ < 0) {
+    return absl::FailedPreconditionError("Result writer already closed.");
+  }
+  const absl::Status synced = Sync();
+  close(std::exchange(fd_, -1));
+  return synced;
+}
+
+}  // namespace deepmind::code_contests
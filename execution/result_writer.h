@@ -0,0 +1,98 @@
+// Copyright 2022 DeepMind Technologies Limited
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Crash-safe output of evaluation results.
+//
+// Results are appended to a JSONL file as soon as each candidate has been
+// evaluated, and synced to disk periodically, so that a crash loses at most the
+// last few results. A restarted evaluation can resume from the file, skipping
+// every candidate that already has a result.
+
+#ifndef THIRD_PARTY_DEEPMIND_CODE_CONTESTS_EXECUTION_RESULT_WRITER_H_
+#define THIRD_PARTY_DEEPMIND_CODE_CONTESTS_EXECUTION_RESULT_WRITER_H_
+
+#include <string>
+#include <utility>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "absl/time/time.h"
+#include "execution/json.hpp"
+
+namespace deepmind::code_contests {
+
+struct ResultWriterOptions {
+  // Whether to keep the results already in the file, rather than truncating it.
+  bool resume = false;
+  // Results are synced to disk after this many writes, or once this long has
+  // passed since the last sync, whichever comes first.
+  int sync_every = 100;
+  absl::Duration sync_interval = absl::Seconds(10);
+};
+
+// Appends results to a JSONL file, one JSON object per line. Every result is
+// keyed by its "id", the name of the problem, and its "index", the index of the
+// candidate among those for the problem.
+class ResultWriter {
+ public:
+  // Opens the file at `path`. If `options.resume` is set, the keys of the
+  // results already in the file, and whether they passed, are read, and a
+  // partially written last line, as left by a crash, is truncated.
+  static absl::StatusOr<ResultWriter> Open(absl::string_view path,
+                                           ResultWriterOptions options = {});
+
+  ResultWriter(ResultWriter&& other);
+  ResultWriter& operator=(ResultWriter&& other) = delete;
+  // Syncs and closes the file if it was not closed.
+  ~ResultWriter();
+
+  // Returns whether there already is a result for candidate `index` of the
+  // problem called `id`.
+  bool Contains(absl::string_view id, int index) const;
+
+  // Returns whether there is a result for candidate `index` of the problem
+  // called `id` whose "passed" is true.
+  bool Passed(absl::string_view id, int index) const;
+
+  // Appends `result`, which must have a string "id" and an integer "index".
+  absl::Status Write(const nlohmann::json& result);
+
+  // Syncs the results written so far to disk.
+  absl::Status Sync();
+
+  absl::Status Close();
+
+  // The number of results that were in the file when it was opened.
+  int num_resumed() const { return num_resumed_; }
+
+ private:
+  using Key = std::pair<std::string, int>;
+
+  ResultWriter(std::string path, int fd, ResultWriterOptions options);
+
+  std::string path_;
+  int fd_;
+  ResultWriterOptions options_;
+  // Whether each result that was written passed.
+  absl::flat_hash_map<Key, bool> written_;
+  int num_resumed_ = 0;
+  int writes_since_sync_ = 0;
+  absl::Time last_sync_;
+};
+
+}  // namespace deepmind::code_contests
+
+#endif  // THIRD_PARTY_DEEPMIND_CODE_CONTESTS_EXECUTION_RESULT_WRITER_H_
@@ -0,0 +1,103 @@
+// Copyright 2022 DeepMind Technologies Limited
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "execution/result_writer.h"
+
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include "gtest/gtest.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "execution/json.hpp"
+
+namespace deepmind::code_contests {
+namespace {
+
+using json = nlohmann::json;
+
+std::string TestPath(const absl::string_view name) {
+  return absl::StrCat(testing::TempDir(), "/", name);
+}
+
+std::string ReadFile(const std::string& path) {
+  std::stringstream contents;
+  contents << std::ifstream(path).rdbuf();
+  return contents.str();
+}
+
+json Result(const absl::string_view id, const int index) {
+  return {{"id", id}, {"index", index}, {"passed", true}};
+}
+
+TEST(ResultWriterTest, WritesOneResultPerLine) {
+  const std::string path = TestPath("results.jsonl");
+  absl::StatusOr<ResultWriter> writer = ResultWriter::Open(path);
+  ASSERT_TRUE(writer.ok()) << writer.status();
+  ASSERT_TRUE(writer->Write(Result("a", 0)).ok());
+  ASSERT_TRUE(writer->Write(Result("a", 1)).ok());
+  EXPECT_TRUE(writer->Contains("a", 1));
+  EXPECT_FALSE(writer->Contains("b", 0));
+  EXPECT_EQ(writer->Write({{"id", "a"}}).code(),
+            absl::StatusCode::kInvalidArgument);
+  ASSERT_TRUE(writer->Close().ok());
+  EXPECT_EQ(ReadFile(path),
+            "{\"id\":\"a\",\"index\":0,\"passed\":true}\n"
+            "{\"id\":\"a\",\"index\":1,\"passed\":true}\n");
+
+  // Without resuming, earlier results are discarded.
+  absl::StatusOr<ResultWriter> rewriter = ResultWriter::Open(path);
+  ASSERT_TRUE(rewriter.ok()) << rewriter.status();
+  EXPECT_FALSE(rewriter->Contains("a", 0));
+  ASSERT_TRUE(rewriter->Close().ok());
+  EXPECT_EQ(ReadFile(path), "");
+}
+
+TEST(ResultWriterTest, ResumesAfterPartialLine) {
+  const std::string path = TestPath("crashed.jsonl");
+  std::ofstream(path) << "{\"id\":\"a\",\"index\":0}\n"
+                      << "{\"id\":\"b\",\"index\":3,\"passed\":true}\n"
+                      << "{\"id\":\"b\",\"ind";
+  absl::StatusOr<ResultWriter> writer =
+      ResultWriter::Open(path, {.resume = true});
+  ASSERT_TRUE(writer.ok()) << writer.status();
+  EXPECT_EQ(writer->num_resumed(), 2);
+  EXPECT_TRUE(writer->Contains("a", 0));
+  EXPECT_TRUE(writer->Contains("b", 3));
+  EXPECT_FALSE(writer->Contains("b", 4));
+  EXPECT_FALSE(writer->Passed("a", 0));
+  EXPECT_TRUE(writer->Passed("b", 3));
+  ASSERT_TRUE(writer->Write(Result("b", 4)).ok());
+  EXPECT_TRUE(writer->Passed("b", 4));
+  ASSERT_TRUE(writer->Close().ok());
+  EXPECT_EQ(ReadFile(path),
+            "{\"id\":\"a\",\"index\":0}\n"
+            "{\"id\":\"b\",\"index\":3,\"passed\":true}\n"
+            "{\"id\":\"b\",\"index\":4,\"passed\":true}\n");
+}
+
+TEST(ResultWriterTest, RejectsCorruptResults) {
+  const std::string path = TestPath("corrupt.jsonl");
+  std::ofstream(path) << "{\"id\":\"a\",\"index\":0}\n"
+                      << "not json\n"
+                      << "{\"id\":\"b\",\"index\":3}\n";
+  EXPECT_EQ(ResultWriter::Open(path, {.resume = true}).status().code(),
+            absl::StatusCode::kDataLoss);
+}
+
+}  // namespace
+}  // namespace deepmind::code_contests
@@ -17,13 +17,19 @@
 
 #include <fcntl.h>
 
+#include <algorithm>
+#include <cmath>
 #include <functional>
 #include <iostream>
-#include <fstream>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <optional>
 #include <string>
 #include <tuple>
 #include <vector>
 
+#include "absl/container/flat_hash_set.h"
 #include "absl/flags/parse.h"
 #include "absl/flags/flag.h"
 #include "absl/status/status.h"
@@ -32,18 +38,57 @@
 #include "absl/strings/str_format.h"
 #include "absl/types/span.h"
 #include "contest_problem.pb.h"
+#include "dataset/problem_filter.h"
+#include "dataset/problem_index.h"
+#include "dataset/shard_reader.h"
+#include "dataset/sharded_problem_reader.h"
+#include "dataset/test_pack.h"
+#include "execution/candidate_solutions.h"
+#include "execution/persistent_result_cache.h"
+#include "execution/policy_cache.h"
+#include "execution/problem_limits.h"
+#include "execution/py_dialect.h"
 #include "execution/py_locations.h"
 #include "execution/py_tester_sandboxer.h"
+#include "execution/result_cache.h"
+#include "execution/result_writer.h"
 #include "execution/status_macros.h"
+#include "execution/test_data.h"
 #include "execution/tester_sandboxer.h"
-#include "riegeli/bytes/fd_reader.h"
-#include "riegeli/records/record_reader.h"
 #include "execution/json.hpp"
 
 ABSL_FLAG(std::string, data_path, "", "Path to folder with dataset.");
 ABSL_FLAG(std::string, valid_path, "", "Path to validation dataset.");
-ABSL_FLAG(std::string, input_path, "", "Path to input dataset.");
-ABSL_FLAG(std::string, output_path, "", "Path to output file.");
+ABSL_FLAG(std::string, input_path, "",
+          "Path to the generations to evaluate, as a JSON object of lists of "
+          "generations, or as JSONL with one generation per line if it ends "
+          "in .jsonl.");
+ABSL_FLAG(std::string, output_path, "",
+          "Path to the JSONL file that results are appended to as they are "
+          "evaluated.");
+ABSL_FLAG(bool, resume, false,
+          "Whether to keep the results already in --output_path and only "
+          "evaluate generations that have none, e.g. after a crash.");
+ABSL_FLAG(std::string, index_path, "",
+          "Optional path to a problem index for the dataset, as written by "
+          "dataset/build_problem_index.");
+ABSL_FLAG(std::string, test_pack_path, "",
+          "Optional path to a test pack for the dataset, as written by "
+          "dataset/build_test_pack. If set, tests are read from it instead of "
+          "from the dataset.");
+ABSL_FLAG(int, pass_at_k, 0,
+          "If positive, generations of a problem are evaluated in rounds, in "
+          "order of their score, only until k of them have passed or the rest "
+          "can no longer make k pass. The others are written as not "
+          "evaluated. 0 evaluates every generation.");
+ABSL_FLAG(int, pass_at_k_round_size, 8,
+          "Number of generations evaluated together in each round with "
+          "--pass_at_k.");
+ABSL_FLAG(int, reader_threads, 4,
+          "Number of dataset shards to read concurrently.");
+ABSL_FLAG(int, arena_batch_size, 64,
+          "Number of dataset records parsed onto each protobuf arena, or 0 "
+          "to parse onto the heap.");
 
 using json = nlohmann::json;
 using namespace std;
@@ -75,15 +120,20 @@ while t:
     constexpr absl::string_view kInvalidSolution = ")";
 
     absl::StatusOr<ContestProblem> FindGregorAndCryptography(
-        const absl::string_view filename)
+        const absl::string_view filename, const absl::string_view index_path)
     {
-      riegeli::RecordReader<riegeli::FdReader<>> reader(
-          std::forward_as_tuple(filename));
-      ContestProblem problem;
-      while (reader.ReadRecord(problem))
+      std::optional<ContestProblem> found;
+      RETURN_IF_ERROR(ForEachNamedProblem(
+          {std::string(filename)}, index_path,
+          {"1549_A. Gregor and Cryptography"},
+          [&](const ContestProblem &problem)
+          {
+            found = problem;
+            return absl::OkStatus();
+          }));
+      if (found.has_value())
       {
-        if (problem.name() == "1549_A. Gregor and Cryptography")
-          return problem;
+        return *std::move(found);
       }
       return absl::NotFoundError(
           "Gregor and Cryptography problem not found. Did you pass the "
@@ -213,139 +263,452 @@ while t:
       return true;
     }
 
-    struct CandidateSolution
+    // tests run in tiers: public tests first, then private ones, then
+    // generated ones, each only if the previous tier passed
+    constexpr absl::string_view kTierNames[] = {"public", "private",
+                                                "generated"};
+
+    // how many programs ran a tier of tests, how long that took in total, and
+    // how many of them failed it
+    struct TierStats
+    {
+      int programs = 0;
+      int rejected = 0;
+      absl::Duration duration;
+    };
+
+    void RecordTiers(const MultiTestResult &multi_result, bool passed,
+                     vector<TierStats> &stats)
+    {
+      const vector<absl::Duration> &durations = multi_result.tier_durations;
+      for (int t = 0; t < durations.size() && t < stats.size(); ++t)
+      {
+        ++stats[t].programs;
+        stats[t].duration += durations[t];
+      }
+      // a program that failed was rejected by the last tier it ran
+      if (!passed && !durations.empty() && durations.size() <= stats.size())
+      {
+        ++stats[durations.size() - 1].rejected;
+      }
+    }
+
+    // how many sandbox policies a tester built from cached builders, and how
+    // long building them took
+    void PrintPolicyStats(absl::string_view interpreter,
+                          const PolicyCacheStats &stats)
     {
-      string id;
-      string generated;
-      string path;
-      bool evaluated;
-      bool passed;
+      cout << interpreter << " sandbox policies: " << stats.hits
+           << " from cached builders, " << stats.misses << " resolved in "
+           << stats.resolve_time << ", " << stats.build_time
+           << " building in total" << endl;
+    }
 
-      CandidateSolution(string id, string generated, string path, bool evaluated, bool passed) : id(id), generated(generated), path(path), evaluated(evaluated), passed(passed) {}
+    // the outcome of testing a program under the python dialect it compiled
+    // under
+    struct DialectTestResult
+    {
+      // unset if the program compiled under neither dialect, in which case
+      // `result` is from the first dialect that was tried
+      std::optional<PyDialect> dialect;
+      MultiTestResult result;
     };
 
-    absl::Status SolveAll(vector<string> filenames,
+    // tests every program under the dialect in `guesses`, and again under the
+    // other dialect only if it did not compile. a program that compiles but
+    // fails its tests is wrong in either dialect, so it is only tested once
+    absl::StatusOr<vector<DialectTestResult>> TestInDialects(
+        const TesterSandboxer &tester3, const TesterSandboxer &tester2,
+        const vector<absl::string_view> &codes, const vector<PyDialect> &guesses,
+        const vector<TestData> &inputs, const TestOptions &options,
+        const vector<TestData> &outputs)
+    {
+      vector<DialectTestResult> results(codes.size());
+      vector<int> todo(codes.size());
+      for (int i = 0; i < codes.size(); ++i)
+      {
+        todo[i] = i;
+      }
+      for (int attempt = 0; attempt < 2 && !todo.empty(); ++attempt)
+      {
+        vector<int> retry;
+        for (const PyDialect dialect : {PyDialect::kPython3, PyDialect::kPython2})
+        {
+          // the first attempt tries the guessed dialect, the second the other
+          vector<int> batch;
+          vector<absl::string_view> batch_codes;
+          for (const int i : todo)
+          {
+            if ((guesses[i] == dialect) == (attempt == 0))
+            {
+              batch.push_back(i);
+              batch_codes.push_back(codes[i]);
+            }
+          }
+          if (batch.empty())
+          {
+            continue;
+          }
+          const TesterSandboxer &tester =
+              dialect == PyDialect::kPython3 ? tester3 : tester2;
+          ASSIGN_OR_RETURN(
+              vector<MultiTestResult> batch_results,
+              tester.TestMany(batch_codes, inputs, options, outputs));
+          for (int k = 0; k < batch.size(); ++k)
+          {
+            DialectTestResult &result = results[batch[k]];
+            if (batch_results[k].compilation_result.program_status ==
+                ProgramStatus::kSuccess)
+            {
+              result.dialect = dialect;
+              result.result = std::move(batch_results[k]);
+            }
+            else if (attempt == 0)
+            {
+              result.result = std::move(batch_results[k]);
+              retry.push_back(batch[k]);
+            }
+          }
+        }
+        todo = std::move(retry);
+      }
+      return results;
+    }
+
+    absl::Status SolveAll(vector<string> filenames, const std::string index_path,
+                          const std::string test_pack_path,
                           const std::string input_path, const std::string output_path)
     {
       // set up evaluation environment
-      Py3TesterSandboxer tester3(Py3InterpreterPath(), Py3LibraryPaths());
+      Py3TesterSandboxer tester3(Py3InterpreterPath(), Py3LibraryPaths(),
+                                 Py3UseZygote());
       Py2TesterSandboxer tester2(Py2InterpreterPath(), Py2LibraryPaths());
+      // time and memory limits are derived from each problem's own limits
+      ASSIGN_OR_RETURN(const LimitScaling limit_scaling,
+                       LimitScalingFromFlags(tester3));
       TestOptions options;
-      options.max_execution_duration = absl::Seconds(5);
       options.num_threads = 12;
       options.stop_on_first_failure = true;
+      // generated tests often repeat other tests, which only need to run once
+      options.deduplicate_tests = true;
+      // wrong generations are killed as soon as their output goes wrong,
+      // rather than running to the end or until they time out
+      options.stream_outputs = true;
+      int launches_saved = 0;
+      // generations often compile to the same program as another one, which
+      // then only needs to be tested once. with --result_cache_path, results
+      // are also kept for later runs, and shared with concurrent ones
+      ASSIGN_OR_RETURN(std::unique_ptr<ResultCache> result_cache,
+                       ResultCacheFromFlags());
+      options.result_cache = result_cache.get();
+      int programs_reused = 0;
+      vector<TierStats> tier_stats(std::size(kTierNames));
+      // how many generations compiled under each python dialect
+      map<string, int> programs_by_dialect;
+      // with --pass_at_k, generations are only evaluated until each problem's
+      // result is decided
+      const int pass_at_k = absl::GetFlag(FLAGS_pass_at_k);
+      const int round_size = max(1, absl::GetFlag(FLAGS_pass_at_k_round_size));
+      int problems_passed_at_k = 0;
+      int generations_skipped = 0;
+
+      // only generations for problems that pass the filter are evaluated. test
+      // packs hold no metadata to filter on
+      ASSIGN_OR_RETURN(const ProblemFilter filter, ProblemFilterFromFlags());
+      if (!filter.MatchesAll() && !test_pack_path.empty())
+      {
+        return absl::InvalidArgumentError(
+            "Problem filters cannot be combined with --test_pack_path.");
+      }
 
-      // parse JSON inputs
-      std::ifstream input_file(input_path);
-      json data = json::parse(input_file);
-      input_file.close();
-      vector<CandidateSolution> generated_solutions;
+      // stream the JSON (or JSONL) inputs, grouping the generations by problem
+      CandidateLoadStats load_stats;
+      ASSIGN_OR_RETURN(CandidateIndex candidates,
+                       LoadCandidates(input_path, &load_stats));
+      cout << "parsed " << candidates.num_candidates() << " generations for "
+           << candidates.problems().size() << " problems in "
+           << load_stats.duration << " ("
+           << absl::StrFormat("%.1f", load_stats.MegabytesPerSecond())
+           << " MiB/s), peak memory "
+           << load_stats.peak_rss_bytes / (1 << 20) << " MiB" << endl;
+
+      // results are appended to the output as they come in, keyed by problem
+      // and index of the generation, so that a crashed run can be resumed
+      ASSIGN_OR_RETURN(
+          ResultWriter results,
+          ResultWriter::Open(output_path,
+                             {.resume = absl::GetFlag(FLAGS_resume)}));
+      cout << "writing output to: " << output_path << endl;
 
-      for (auto entry : data.items())
+      // generations that passed in an earlier run count towards k
+      const auto num_resumed_passed = [&](const ProblemCandidates &problem)
       {
-        string path = entry.key();
-        cout << path << endl;
-        vector<json> generations = entry.value();
-        for (const auto &g : generations)
+        int num_passed = 0;
+        for (int i = 0; i < problem.candidates.size(); ++i)
         {
-          string id = g["id"];
-          for (const auto &solution : g["model_completions"])
-          {
-            // string solution = g["generated"];
-            CandidateSolution cs(id, solution, path, false, false);
-            generated_solutions.push_back(cs);
-          }
+          num_passed += results.Passed(problem.name, i);
         }
-      }
-      cout << "parsed the input json" << endl;
-
-      // we will write the output json to this
-      vector<json> test_results;
+        return num_passed;
+      };
 
-      // go through all the riegeli files in this dataset
-      for (const auto &filename : filenames)
+      // problems whose generations all have results already need not be read
+      absl::flat_hash_set<string> wanted_names;
+      int num_resumed_problems = 0;
+      for (auto &problem : candidates.problems())
       {
-        // iterate through problems
-        riegeli::RecordReader<riegeli::FdReader<>> reader(
-            std::forward_as_tuple(filename));
-        ContestProblem problem;
-        vector<tuple<int, int>> passes_and_fails;
-        while (reader.ReadRecord(problem))
+        bool done = true;
+        for (int i = 0; i < problem.candidates.size() && done; ++i)
         {
-          vector<CandidateSolution> generated_for_this_problem;
-          bool found = false;
-          for (const auto &s : generated_solutions)
-          {
-            if (s.id == problem.name())
-            {
-              generated_for_this_problem.push_back(s);
-              found = true;
-            }
-          }
-          if (found)
+          done = results.Contains(problem.name, i);
+        }
+        if (done)
+        {
+          problem.found = true;
+          ++num_resumed_problems;
+          if (pass_at_k > 0 && num_resumed_passed(problem) >= pass_at_k)
           {
-            cout << "found a generation" << endl;
+            ++problems_passed_at_k;
           }
-          else
-          {
-            continue;
-          }
-
-          const std::vector<absl::string_view> inputs =
-              GetInputs(problem,
-                        /*max_size=*/-1); // -1 for no resizing
-          const std::vector<absl::string_view> outputs =
-              GetOutputs(problem,
-                         /*max_size=*/-1);
+          continue;
+        }
+        wanted_names.insert(problem.name);
+      }
+      if (results.num_resumed() > 0)
+      {
+        cout << "resuming after " << results.num_resumed() << " results, "
+             << num_resumed_problems << " problems are done" << endl;
+      }
 
-          std::vector<int> passorfail;
-          for (const auto &g : generated_for_this_problem)
+      // evaluates all generations for `problem` on its tests
+      const auto evaluate_problem =
+          [&](ProblemCandidates &problem, const std::vector<TestData> &inputs,
+              const std::vector<TestData> &outputs,
+              const std::vector<int> &tiers,
+              const ProblemLimits &limits) -> absl::Status
           {
-            std::string solution = g.generated;
-
-            ASSIGN_OR_RETURN(MultiTestResult result3,
-                             tester3.Test(solution, inputs, options, outputs));
-            // ReportResults(result);
-            bool passed3 = DidItPass(result3);
-            bool passed2 = false;
-            if (!passed3)
+            cout << "found " << problem.candidates.size()
+                 << " generations for " << problem.name << endl;
+            // all generations without a result are compiled and tested
+            // together, so that the tests of one keep the workers busy while
+            // others are compiling
+            vector<int> pending;
+            for (int i = 0; i < problem.candidates.size(); ++i)
             {
-              ASSIGN_OR_RETURN(MultiTestResult result2,
-                               tester2.Test(solution, inputs, options, outputs));
-              // ReportResults(result);
-              passed2 = DidItPass(result2);
+              if (!results.Contains(problem.name, i))
+              {
+                pending.push_back(i);
+              }
+            }
+            if (pending.empty())
+            {
+              return absl::OkStatus();
+            }
+            if (pass_at_k > 0)
+            {
+              // the best scored generations go first, as they are the most
+              // likely to pass. unscored ones keep their order, after them
+              stable_sort(pending.begin(), pending.end(), [&](int a, int b)
+                          { return problem.candidates[a].score.value_or(-HUGE_VAL) >
+                                   problem.candidates[b].score.value_or(-HUGE_VAL); });
             }
 
-            bool passed = passed3 || passed2;
+            TestOptions problem_options = options;
+            problem_options.problem_id = problem.name;
+            problem_options.test_tiers = tiers;
+            ApplyLimits(limits, limit_scaling, problem_options);
 
-            json res;
-            res["id"] = g.id;
-            res["generated"] = g.generated;
-            res["passed"] = passed;
-            test_results.push_back(res);
+            int num_passed = num_resumed_passed(problem);
+            int next = 0;
+            while (next < pending.size())
+            {
+              // once k generations passed, or too few are left for k to pass,
+              // the result of the problem cannot change any more
+              const int remaining = pending.size() - next;
+              if (pass_at_k > 0 &&
+                  (num_passed >= pass_at_k || num_passed + remaining < pass_at_k))
+              {
+                break;
+              }
+              const int end =
+                  pass_at_k > 0 ? min<int>(pending.size(), next + round_size)
+                                : pending.size();
+              vector<absl::string_view> codes;
+              // generations are tested under python 3, unless they use python
+              // 2 builtins, and under the other dialect if they do not compile
+              vector<PyDialect> guesses;
+              for (int j = next; j < end; ++j)
+              {
+                codes.push_back(problem.candidates[pending[j]].generated);
+                guesses.push_back(GuessPyDialect(codes.back()));
+              }
+              ASSIGN_OR_RETURN(
+                  vector<DialectTestResult> tested,
+                  TestInDialects(tester3, tester2, codes, guesses, inputs,
+                                 problem_options, outputs));
+              for (int j = 0; j < tested.size(); ++j)
+              {
+                const MultiTestResult &result = tested[j].result;
+                const bool passed = DidItPass(result);
+                RecordTiers(result, passed, tier_stats);
+                launches_saved += result.num_duplicate_tests;
+                programs_reused += result.from_cache;
+                ++programs_by_dialect[string(
+                    tested[j].dialect.has_value()
+                        ? PyDialectName(*tested[j].dialect)
+                        : "neither")];
+
+                const int index = pending[next + j];
+                auto &g = problem.candidates[index];
+                g.evaluated = true;
+                g.passed = passed;
+                num_passed += passed;
+
+                json res;
+                res["id"] = g.id;
+                res["index"] = index;
+                res["generated"] = g.generated;
+                res["evaluated"] = true;
+                res["passed"] = g.passed;
+                if (tested[j].dialect.has_value())
+                {
+                  res["language"] = string(PyDialectName(*tested[j].dialect));
+                }
+                else
+                {
+                  res["language"] = nullptr;
+                }
+                RETURN_IF_ERROR(results.Write(res));
+
+                if (g.passed)
+                {
+                  std::cout << "passed" << std::endl;
+                }
+                else
+                {
+                  std::cout << "failed" << std::endl;
+                }
+              }
+              next = end;
+            }
 
-            if (passed)
+            if (pass_at_k > 0 && num_passed >= pass_at_k)
             {
-              std::cout << "passed" << std::endl;
+              ++problems_passed_at_k;
             }
-            else
+            // the rest are written as well, so that a resumed run does not
+            // evaluate them, but neither as passed nor as failed
+            for (int j = next; j < pending.size(); ++j)
             {
-              std::cout << "failed" << std::endl;
+              const auto &g = problem.candidates[pending[j]];
+              json res;
+              res["id"] = g.id;
+              res["index"] = pending[j];
+              res["generated"] = g.generated;
+              res["evaluated"] = false;
+              res["passed"] = nullptr;
+              res["language"] = nullptr;
+              RETURN_IF_ERROR(results.Write(res));
+              ++generations_skipped;
             }
+            return absl::OkStatus();
+          };
+
+      if (!test_pack_path.empty())
+      {
+        // the tests are read straight from the mapped test pack, so the
+        // dataset itself is not needed at all. tests of compressed packs are
+        // only decompressed as they run, into the sandbox's stdin.
+        ASSIGN_OR_RETURN(const TestPack test_pack, TestPack::Open(test_pack_path));
+        for (auto &problem : candidates.problems())
+        {
+          if (!wanted_names.contains(problem.name))
+          {
+            continue;
           }
+          absl::StatusOr<PackedTestData> tests = test_pack.FindData(problem.name);
+          if (absl::IsNotFound(tests.status()))
+          {
+            continue;
+          }
+          RETURN_IF_ERROR(tests.status());
+          problem.found = true;
+          RETURN_IF_ERROR(evaluate_problem(
+              problem, tests->inputs, tests->outputs,
+              {tests->num_public_tests, tests->num_private_tests,
+               tests->num_generated_tests},
+              {tests->time_limit, tests->memory_limit_bytes}));
         }
       }
+      else
+      {
+        // go through all the riegeli files in this dataset, seeking straight to
+        // the problems we have generations for if an index is available. Shards
+        // that have to be scanned are read in the background while we evaluate.
+        ShardedProblemReaderOptions reader_options;
+        reader_options.num_threads = absl::GetFlag(FLAGS_reader_threads);
+        reader_options.arena_batch_size = absl::GetFlag(FLAGS_arena_batch_size);
+        reader_options.read_mode = ShardReadModeFromFlags();
+        filter.ApplyTo(reader_options);
+        RETURN_IF_ERROR(ForEachNamedProblem(
+            filenames, index_path, wanted_names,
+            [&](const ContestProblem &problem) -> absl::Status
+            {
+              ProblemCandidates *generated = candidates.Find(problem.name());
+              if (generated == nullptr)
+              {
+                return absl::OkStatus();
+              }
+              const std::vector<absl::string_view> inputs =
+                  GetInputs(problem, /*max_size=*/-1);
+              const std::vector<absl::string_view> outputs =
+                  GetOutputs(problem, /*max_size=*/-1);
+              return evaluate_problem(
+                  *generated,
+                  std::vector<TestData>(inputs.begin(), inputs.end()),
+                  std::vector<TestData>(outputs.begin(), outputs.end()),
+                  {problem.public_tests_size(), problem.private_tests_size(),
+                   problem.generated_tests_size()},
+                  LimitsOf(problem));
+            },
+            reader_options));
+      }
 
-      json final_output;
-      final_output["results"] = test_results;
-
-      cout << "writing output to: " << output_path << endl;
-      std::ofstream output_file(output_path);
-      output_file << final_output.dump();
-      output_file.flush();
-      output_file.close();
+      // generations for problems that are missing from the dataset, or that the
+      // filter rejected, were never evaluated
+      for (const ProblemCandidates *problem : candidates.Unfound())
+      {
+        cout << "problem not found, skipped " << problem->candidates.size()
+             << " generations: " << problem->name << endl;
+      }
 
-      return absl::OkStatus();
+      cout << "test deduplication saved " << launches_saved
+           << " sandbox launches" << endl;
+      cout << "reused the results of " << programs_reused
+           << " identical programs" << endl;
+      for (const auto &[dialect, count] : programs_by_dialect)
+      {
+        cout << count << " generations compiled as " << dialect << endl;
+      }
+      for (int t = 0; t < tier_stats.size(); ++t)
+      {
+        cout << kTierNames[t] << " tests: " << tier_stats[t].programs
+             << " programs ran them in " << tier_stats[t].duration
+             << " in total, " << tier_stats[t].rejected << " failed" << endl;
+      }
+      if (pass_at_k > 0)
+      {
+        cout << problems_passed_at_k << " problems had " << pass_at_k
+             << " passing generations, " << generations_skipped
+             << " generations were not evaluated" << endl;
+      }
+      const ResultCacheStats cache_stats = result_cache->stats();
+      cout << "result cache: " << cache_stats.hits << " hits, "
+           << cache_stats.misses << " misses, " << cache_stats.evicted
+           << " evicted" << endl;
+      PrintPolicyStats("python3", tester3.policy_stats());
+      PrintPolicyStats("python2", tester2.policy_stats());
+
+      return results.Close();
     }
 
     // this method iterates through a dataset and evaluates the reference solutions against the given tests
@@ -353,36 +716,44 @@ while t:
     {
 
       // set up evaluation environment
-      Py3TesterSandboxer tester3(Py3InterpreterPath(), Py3LibraryPaths());
+      Py3TesterSandboxer tester3(Py3InterpreterPath(), Py3LibraryPaths(),
+                                 Py3UseZygote());
       Py2TesterSandboxer tester2(Py2InterpreterPath(), Py2LibraryPaths());
+      ASSIGN_OR_RETURN(const LimitScaling limit_scaling,
+                       LimitScalingFromFlags(tester3));
       TestOptions options;
-      options.max_execution_duration = absl::Seconds(5);
       options.num_threads = 2;
       options.stop_on_first_failure = true;
+      options.deduplicate_tests = true;
+      int launches_saved = 0;
+
+      // which problems to evaluate, by default a few that exercise different
+      // parts of the sandbox
+      ASSIGN_OR_RETURN(ProblemFilter filter, ProblemFilterFromFlags());
+      if (filter.MatchesAll())
+      {
+        filter.names = {"1569_A. Balanced Substring",
+                        "1551_D2. Domino (hard version)",
+                        "1552_E. Colors and Intervals",
+                        "1557_E. Assiut Chess"};
+      }
 
       // the problem descriptions are split over multiple riegeli files
       for (const auto &filename : filenames)
       {
 
-        // iterate through problems
-        riegeli::RecordReader<riegeli::FdReader<>> reader(
-            std::forward_as_tuple(filename));
+        // iterate through the problems that pass the filter. records of other
+        // problems are only partially decoded
+        ShardedProblemReaderOptions reader_options;
+        reader_options.num_threads = 1;
+        reader_options.read_mode = ShardReadModeFromFlags();
+        filter.ApplyTo(reader_options);
+        ShardedProblemReader reader({filename}, std::move(reader_options));
         ContestProblem problem;
         vector<tuple<int, int>> passes_and_fails;
-        while (reader.ReadRecord(problem))
+        while (reader.ReadProblem(problem))
         {
-          // const auto name = "1091_G. New Year and the Factorisation Collaboration";
-          // const auto name = "1575_A. Another Sorting Problem";
           const auto name = problem.name();
-          // cout<<name<<endl;
-          if (
-              !((name == "1569_A. Balanced Substring") ||
-                (name == "1551_D2. Domino (hard version)") ||
-                (name == "1552_E. Colors and Intervals") ||
-                (name == "1557_E. Assiut Chess")))
-          {
-            continue;
-          }
           std::cout << "found the problem" << std::endl;
           cout << name << endl;
           cout << "-----------------" << endl;
@@ -395,13 +766,21 @@ while t:
               GetOutputs(problem,
                          /*max_size=*/-1);
 
-          // get solutions for python2 and 3 and concatenate them into one vector
+          const std::vector<TestData> input_data(inputs.begin(), inputs.end());
+          const std::vector<TestData> output_data(outputs.begin(), outputs.end());
+          TestOptions problem_options = options;
+          ApplyLimits(LimitsOf(problem), limit_scaling, problem_options);
+
+          // get solutions for python2 and 3 and concatenate them into one
+          // vector. each is tested under the dialect it is labelled with
           const std::vector<absl::string_view> py2_solutions =
               GetLangSolutions(problem,
                                /*max_size=*/-1, deepmind::code_contests::ContestProblem_Solution::Language::ContestProblem_Solution_Language_PYTHON);
           std::vector<absl::string_view> solutions = GetLangSolutions(problem,
                                                                       /*max_size=*/-1, deepmind::code_contests::ContestProblem_Solution::Language::ContestProblem_Solution_Language_PYTHON3);
+          std::vector<PyDialect> dialects(solutions.size(), PyDialect::kPython3);
           copy(begin(py2_solutions), end(py2_solutions), back_inserter(solutions));
+          dialects.resize(solutions.size(), PyDialect::kPython2);
 
           int num_passed = 0;
           int num_failed = 0;
@@ -409,22 +788,19 @@ while t:
           // how many solutions do we want to evaluate at most:
           int max_per_problem = 50;
           std::vector<bool> passorfail;
-          for (const auto &solution : solutions)
+          for (int s = 0; s < solutions.size(); ++s)
           {
-            ASSIGN_OR_RETURN(MultiTestResult result3,
-                             tester3.Test(solution, inputs, options, outputs));
-            // ReportResults(result);
-            bool passed3 = DidItPass(result3);
-            bool passed2 = false;
-            if (!passed3)
-            {
-              ASSIGN_OR_RETURN(MultiTestResult result2,
-                               tester2.Test(solution, inputs, options, outputs));
-              // ReportResults(result);
-              passed2 = DidItPass(result2);
-            }
-
-            bool passed = passed3 || passed2;
+            const absl::string_view solution = solutions[s];
+            // the other dialect is only tried if the solution does not
+            // compile, e.g. because it is labelled wrongly
+            ASSIGN_OR_RETURN(
+                vector<DialectTestResult> tested,
+                TestInDialects(tester3, tester2, {solution}, {dialects[s]},
+                               input_data, problem_options, output_data));
+            // ReportResults(tested[0].result);
+            launches_saved += tested[0].result.num_duplicate_tests;
+
+            bool passed = DidItPass(tested[0].result);
             passorfail.push_back(passed);
             if (passed)
             {
@@ -459,16 +835,20 @@ while t:
 
           std::cout << std::get<0>(p_and_f) << "," << std::get<1>(p_and_f) << std::endl;
         }
+        RETURN_IF_ERROR(reader.Close());
       }
+      std::cout << "test deduplication saved " << launches_saved
+                << " sandbox launches" << std::endl;
 
       return absl::OkStatus();
     }
 
     absl::Status SolveGregorAndCryptography(
-        const absl::string_view valid_filename)
+        const absl::string_view valid_filename,
+        const absl::string_view index_path)
     {
       ASSIGN_OR_RETURN(ContestProblem gregor_and_cryptography,
-                       FindGregorAndCryptography(valid_filename));
+                       FindGregorAndCryptography(valid_filename, index_path));
       const std::vector<absl::string_view> inputs =
           GetInputs(gregor_and_cryptography,
                     /*max_size=*/10);
@@ -540,7 +920,7 @@ int main(int argc, char *argv[])
   vector<string> problem_filenames;
   problem_filenames.push_back(data_path + "dm-code_contests/code_contests_test.riegeli");
   problem_filenames.push_back(data_path + "dm-code_contests/code_contests_valid.riegeli");
-  for (int i = 0; i <= 128; i++)
+  for (int i = 0; i < 128; i++)
   {
     const auto str = absl::StrFormat("%0*d", 5, i);
     const auto complete_path = data_path + "dm-code_contests/code_contests_train.riegeli-" + str + "-of-00128";
@@ -549,6 +929,8 @@ int main(int argc, char *argv[])
 
   if (absl::Status status = deepmind::code_contests::SolveAll(
           problem_filenames,
+          absl::GetFlag(FLAGS_index_path),
+          absl::GetFlag(FLAGS_test_pack_path),
           absl::GetFlag(FLAGS_input_path),
           absl::GetFlag(FLAGS_output_path));
       !status.ok())
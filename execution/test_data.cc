@@ -0,0 +1,47 @@
+// Copyright 2022 DeepMind Technologies Limited
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "execution/test_data.h"
+
+#include <string>
+
+#include "absl/algorithm/container.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/substitute.h"
+#include "absl/types/span.h"
+#include "execution/status_macros.h"
+
+namespace deepmind::code_contests {
+
+absl::Status TestData::CopyTo(absl::Span<char> out) const {
+  if (out.size() != size_) {
+    return absl::InvalidArgumentError(absl::Substitute(
+        "Test data has $0 bytes, but $1 were requested.", size_, out.size()));
+  }
+  if (bytes_.has_value()) {
+    absl::c_copy(*bytes_, out.data());
+    return absl::OkStatus();
+  }
+  return fill_(out);
+}
+
+absl::StatusOr<std::string> TestData::ToString() const {
+  if (bytes_.has_value()) return std::string(*bytes_);
+  std::string result(size_, '\0');
+  RETURN_IF_ERROR(CopyTo(absl::MakeSpan(result)));
+  return result;
+}
+
+}  // namespace deepmind::code_contests
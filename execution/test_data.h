@@ -0,0 +1,66 @@
+// Copyright 2022 DeepMind Technologies Limited
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef THIRD_PARTY_DEEPMIND_CODE_CONTESTS_EXECUTION_TEST_DATA_H_
+#define THIRD_PARTY_DEEPMIND_CODE_CONTESTS_EXECUTION_TEST_DATA_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+#include <utility>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "absl/types/span.h"
+
+namespace deepmind::code_contests {
+
+// The bytes of a test input or expected output. They are either in memory, or
+// produced on demand (e.g. by decompressing them) when the test runs, so that
+// the tests of a problem need not all be held in memory at once.
+class TestData {
+ public:
+  // Fills `out`, which has exactly `size()` bytes.
+  using Fill = std::function<absl::Status(absl::Span<char> out)>;
+
+  explicit TestData(absl::string_view bytes)
+      : size_(bytes.size()), bytes_(bytes) {}
+  // `fingerprint`, if set, identifies the bytes that `fill` produces, without
+  // having to produce them, e.g. by fingerprinting their compressed form.
+  TestData(size_t size, Fill fill,
+           std::optional<uint64_t> fingerprint = std::nullopt)
+      : size_(size), fill_(std::move(fill)), fingerprint_(fingerprint) {}
+
+  size_t size() const { return size_; }
+  // The bytes, if they are in memory.
+  std::optional<absl::string_view> bytes() const { return bytes_; }
+  // Identifies bytes that are not in memory, if they were given one.
+  std::optional<uint64_t> fingerprint() const { return fingerprint_; }
+
+  absl::Status CopyTo(absl::Span<char> out) const;
+  absl::StatusOr<std::string> ToString() const;
+
+ private:
+  size_t size_;
+  std::optional<absl::string_view> bytes_;
+  Fill fill_;
+  std::optional<uint64_t> fingerprint_;
+};
+
+}  // namespace deepmind::code_contests
+
+#endif  // THIRD_PARTY_DEEPMIND_CODE_CONTESTS_EXECUTION_TEST_DATA_H_
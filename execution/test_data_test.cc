@@ -0,0 +1,58 @@
+// Copyright 2022 DeepMind Technologies Limited
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "execution/test_data.h"
+
+#include <string>
+
+#include "gtest/gtest.h"
+#include "absl/status/status.h"
+#include "absl/types/span.h"
+
+namespace deepmind::code_contests {
+namespace {
+
+TEST(TestDataTest, CopiesBytesInMemory) {
+  const TestData data("1 2\n");
+  ASSERT_TRUE(data.bytes().has_value());
+  EXPECT_EQ(*data.bytes(), "1 2\n");
+  std::string out(data.size(), '\0');
+  ASSERT_TRUE(data.CopyTo(absl::MakeSpan(out)).ok());
+  EXPECT_EQ(out, "1 2\n");
+}
+
+TEST(TestDataTest, FillsOnDemand) {
+  int fills = 0;
+  const TestData data(3, [&fills](absl::Span<char> out) {
+    ++fills;
+    for (char& c : out) c = 'x';
+    return absl::OkStatus();
+  });
+  EXPECT_FALSE(data.bytes().has_value());
+  EXPECT_EQ(fills, 0);
+  const absl::StatusOr<std::string> contents = data.ToString();
+  ASSERT_TRUE(contents.ok());
+  EXPECT_EQ(*contents, "xxx");
+  EXPECT_EQ(fills, 1);
+}
+
+TEST(TestDataTest, RejectsWrongSize) {
+  const TestData data("abc");
+  std::string out(2, '\0');
+  EXPECT_EQ(data.CopyTo(absl::MakeSpan(out)).code(),
+            absl::StatusCode::kInvalidArgument);
+}
+
+}  // namespace
+}  // namespace deepmind::code_contests
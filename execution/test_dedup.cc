@@ -0,0 +1,66 @@
+// Copyright 2022 DeepMind Technologies Limited
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "execution/test_dedup.h"
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/inlined_vector.h"
+#include "absl/strings/string_view.h"
+#include "farmhash.h"
+
+namespace deepmind::code_contests {
+
+DedupedTests DedupTests(
+    const std::vector<absl::string_view>& inputs,
+    const std::vector<absl::string_view>& expected_outputs) {
+  const bool has_outputs = !expected_outputs.empty();
+  DedupedTests deduped;
+  deduped.distinct_index.reserve(inputs.size());
+  // Distinct tests by the fingerprints of their input and output. Almost
+  // always a single test per key, but collisions are possible.
+  absl::flat_hash_map<std::pair<uint64_t, uint64_t>,
+                      absl::InlinedVector<int, 1>>
+      distinct_by_hash;
+  for (int i = 0; i < inputs.size(); ++i) {
+    const absl::string_view input = inputs[i];
+    const absl::string_view output =
+        has_outputs ? expected_outputs[i] : absl::string_view();
+    const std::pair<uint64_t, uint64_t> key = {
+        farmhash::Fingerprint64(input.data(), input.size()),
+        farmhash::Fingerprint64(output.data(), output.size())};
+    absl::InlinedVector<int, 1>& candidates = distinct_by_hash[key];
+    int distinct = -1;
+    for (const int candidate : candidates) {
+      if (deduped.inputs[candidate] == input &&
+          (!has_outputs || deduped.outputs[candidate] == output)) {
+        distinct = candidate;
+        break;
+      }
+    }
+    if (distinct < 0) {
+      distinct = deduped.inputs.size();
+      candidates.push_back(distinct);
+      deduped.inputs.push_back(input);
+      if (has_outputs) deduped.outputs.push_back(output);
+    }
+    deduped.distinct_index.push_back(distinct);
+  }
+  return deduped;
+}
+
+}  // namespace deepmind::code_contests
@@ -0,0 +1,63 @@
+// Copyright 2022 DeepMind Technologies Limited
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Deduplication of test cases.
+//
+// Generated tests often repeat a public or private test, or each other,
+// byte for byte. Running a program on a duplicate test cannot give a different
+// result, so each distinct (input, expected output) pair only needs one
+// sandbox launch, with its result copied to every test that shares it.
+
+#ifndef THIRD_PARTY_DEEPMIND_CODE_CONTESTS_EXECUTION_TEST_DEDUP_H_
+#define THIRD_PARTY_DEEPMIND_CODE_CONTESTS_EXECUTION_TEST_DEDUP_H_
+
+#include <vector>
+
+#include "absl/strings/string_view.h"
+
+namespace deepmind::code_contests {
+
+struct DedupedTests {
+  // The distinct tests, in order of first occurrence. `outputs` is empty if no
+  // expected outputs were given.
+  std::vector<absl::string_view> inputs;
+  std::vector<absl::string_view> outputs;
+  // For every original test, the index of its distinct test.
+  std::vector<int> distinct_index;
+
+  int num_duplicates() const { return distinct_index.size() - inputs.size(); }
+};
+
+// Finds the distinct tests among `inputs` and `expected_outputs`, which must
+// either be empty or have the same length as `inputs`. Tests are hashed with
+// farmhash, and tests with equal hashes are compared byte for byte.
+DedupedTests DedupTests(const std::vector<absl::string_view>& inputs,
+                        const std::vector<absl::string_view>& expected_outputs);
+
+// Returns the result of every original test, given `distinct_results`, the
+// results of the distinct tests in `deduped`.
+template <typename Result>
+std::vector<Result> FanOutResults(const std::vector<Result>& distinct_results,
+                                  const DedupedTests& deduped) {
+  std::vector<Result> results;
+  results.reserve(deduped.distinct_index.size());
+  for (const int i : deduped.distinct_index) {
+    results.push_back(distinct_results[i]);
+  }
+  return results;
+}
+
+}  // namespace deepmind::code_contests
+
+#endif  // THIRD_PARTY_DEEPMIND_CODE_CONTESTS_EXECUTION_TEST_DEDUP_H_
@@ -0,0 +1,64 @@
+// Copyright 2022 DeepMind Technologies Limited
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "execution/test_dedup.h"
+
+#include <string>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/strings/string_view.h"
+
+namespace deepmind::code_contests {
+namespace {
+
+using ::testing::ElementsAre;
+using ::testing::IsEmpty;
+
+TEST(DedupTestsTest, MergesIdenticalPairs) {
+  const std::vector<absl::string_view> inputs = {"1 2\n", "3 4\n", "1 2\n",
+                                                 "1 2\n"};
+  const std::vector<absl::string_view> outputs = {"3", "7", "3", "4"};
+  const DedupedTests deduped = DedupTests(inputs, outputs);
+  EXPECT_THAT(deduped.inputs, ElementsAre("1 2\n", "3 4\n", "1 2\n"));
+  EXPECT_THAT(deduped.outputs, ElementsAre("3", "7", "4"));
+  EXPECT_THAT(deduped.distinct_index, ElementsAre(0, 1, 0, 2));
+  EXPECT_EQ(deduped.num_duplicates(), 1);
+}
+
+TEST(DedupTestsTest, UsesInputsAloneWithoutOutputs) {
+  const std::vector<absl::string_view> inputs = {"a", "b", "a", "", ""};
+  const DedupedTests deduped = DedupTests(inputs, {});
+  EXPECT_THAT(deduped.inputs, ElementsAre("a", "b", ""));
+  EXPECT_THAT(deduped.outputs, IsEmpty());
+  EXPECT_THAT(deduped.distinct_index, ElementsAre(0, 1, 0, 2, 2));
+  EXPECT_EQ(deduped.num_duplicates(), 2);
+}
+
+TEST(DedupTestsTest, ComparesContentsNotAddresses) {
+  const std::string first = "same input";
+  const std::string second = "same input";
+  const DedupedTests deduped = DedupTests({first, second}, {"x", "x"});
+  EXPECT_THAT(deduped.distinct_index, ElementsAre(0, 0));
+}
+
+TEST(FanOutResultsTest, CopiesResultsToEveryTest) {
+  const DedupedTests deduped = DedupTests({"a", "b", "a"}, {});
+  EXPECT_THAT(FanOutResults(std::vector<int>{10, 20}, deduped),
+              ElementsAre(10, 20, 10));
+}
+
+}  // namespace
+}  // namespace deepmind::code_contests
@@ -37,11 +37,13 @@
 #include <vector>
 
 #include "absl/algorithm/container.h"
+#include "absl/container/flat_hash_map.h"
 #include "absl/memory/memory.h"
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
 #include "absl/strings/ascii.h"
 #include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
 #include "absl/strings/str_split.h"
 #include "absl/strings/string_view.h"
 #include "absl/strings/substitute.h"
@@ -49,8 +51,12 @@
 #include "absl/time/clock.h"
 #include "absl/time/time.h"
 #include "absl/types/span.h"
+#include "execution/output_collector.h"
+#include "execution/result_cache.h"
 #include "execution/status_macros.h"
 #include "execution/temp_path.h"
+#include "execution/test_data.h"
+#include "execution/test_dedup.h"
 #include "sandboxed_api/sandbox2/buffer.h"
 #include "sandboxed_api/sandbox2/executor.h"
 #include "sandboxed_api/sandbox2/policy.h"
@@ -100,24 +106,6 @@ ssize_t BlockingReadIgnoringInterruptions(int fd, char* buf, size_t count) {
   return bytes_read;
 }
 
-absl::StatusOr<std::string> ReadFd(int fd) {
-  std::string contents;
-  constexpr int64_t buffer_size = 4096;
-  const auto buffer = std::make_unique<char[]>(buffer_size);
-  for (;;) {
-    const ssize_t n =
-        BlockingReadIgnoringInterruptions(fd, buffer.get(), buffer_size);
-    if (n < 0) {
-      return absl::UnknownError(
-          absl::Substitute("Reading FD $0 failed with errno $1", fd, errno));
-    }
-    if (n == 0) {
-      return contents;
-    }
-    contents.append(buffer.get(), n);
-  }
-}
-
 absl::StatusOr<std::string> UseCacheOrReadAndClose(
     int& fd, std::optional<absl::StatusOr<std::string>>& cache) {
   if (cache.has_value()) {
@@ -126,15 +114,18 @@ absl::StatusOr<std::string> UseCacheOrReadAndClose(
   if (fd == SandboxWithOutputFds::kInvalidFd) {
     return absl::FailedPreconditionError("File descriptor not set.");
   }
-  cache = ReadFd(fd);
+  cache = internal::ReadFd(fd);
   close(fd);
   fd = SandboxWithOutputFds::kInvalidFd;
   return *cache;
 }
 
+// The characters that separate tokens of outputs.
+constexpr absl::string_view kWhitespace = " \n\t\r\v";
+
 std::vector<std::string> SplitAndLowercase(absl::string_view s) {
   std::vector<std::string> parts =
-      absl::StrSplit(s, absl::ByAnyChar(" \n\t\r\v"), absl::SkipEmpty());
+      absl::StrSplit(s, absl::ByAnyChar(kWhitespace), absl::SkipEmpty());
   std::vector<std::string> lower;
   std::transform(parts.begin(), parts.end(), std::back_inserter(lower),
                  [](const std::string& s) -> std::string {
@@ -164,6 +155,15 @@ bool ValuesMatch(absl::string_view a, absl::string_view b) {
   return ai == bi;
 }
 
+// Returns the contents of `data`, producing them into `storage` if they are not
+// in memory.
+absl::StatusOr<absl::string_view> ContentsOf(const TestData& data,
+                                             std::string& storage) {
+  if (data.bytes().has_value()) return *data.bytes();
+  ASSIGN_OR_RETURN(storage, data.ToString());
+  return storage;
+}
+
 }  // namespace
 
 absl::Status ExecutionResult::SandboxResultStatus() const {
@@ -176,6 +176,8 @@ absl::Status ExecutionResult::SandboxResultStatus() const {
       return absl::DeadlineExceededError(sandbox_result);
     case ProgramStatus::kFailed:
       return absl::InternalError(sandbox_result);
+    case ProgramStatus::kCancelled:
+      return absl::CancelledError(sandbox_result);
   }
 }
 
@@ -249,6 +251,29 @@ absl::StatusOr<std::string> SandboxWithOutputFds::Stderr() {
   return UseCacheOrReadAndClose(stderr_fd_, stderr_cache_);
 }
 
+absl::Status SandboxWithOutputFds::CollectOutputs(
+    OutputCollector& collector, OutputCollector::ChunkCallback on_chunk) {
+  if (stdout_fd_ == kInvalidFd || stderr_fd_ == kInvalidFd) {
+    return absl::FailedPreconditionError("File descriptor not set.");
+  }
+  ASSIGN_OR_RETURN(
+      OutputCollector::Collection collection,
+      collector.Collect({stdout_fd_, stderr_fd_}, std::move(on_chunk)));
+  absl::StatusOr<std::vector<std::string>> contents = collection.Await();
+  close(stdout_fd_);
+  close(stderr_fd_);
+  stdout_fd_ = kInvalidFd;
+  stderr_fd_ = kInvalidFd;
+  if (!contents.ok()) {
+    stdout_cache_ = contents.status();
+    stderr_cache_ = contents.status();
+    return contents.status();
+  }
+  stdout_cache_ = std::move((*contents)[0]);
+  stderr_cache_ = std::move((*contents)[1]);
+  return absl::OkStatus();
+}
+
 std::vector<std::string> CopyEnviron() {
   return sandbox2::util::CharPtrArray(environ).ToStringVector();
 }
@@ -263,6 +288,71 @@ bool OutputsMatch(absl::string_view output, absl::string_view expected) {
                                std::logical_and<>(), ValuesMatch);
 }
 
+StreamingOutputComparator::StreamingOutputComparator(absl::string_view expected)
+    : expected_tokens_(SplitAndLowercase(expected)) {}
+
+bool StreamingOutputComparator::Add(absl::string_view chunk) {
+  while (!mismatched_ && !chunk.empty()) {
+    const size_t end = chunk.find_first_of(kWhitespace);
+    if (end == absl::string_view::npos) {
+      absl::StrAppend(&partial_token_, absl::AsciiStrToLower(chunk));
+      break;
+    }
+    if (end > 0 || !partial_token_.empty()) {
+      absl::StrAppend(&partial_token_,
+                      absl::AsciiStrToLower(chunk.substr(0, end)));
+      mismatched_ = !AddToken(partial_token_);
+      partial_token_.clear();
+    }
+    chunk.remove_prefix(end + 1);
+  }
+  return !mismatched_;
+}
+
+bool StreamingOutputComparator::AddToken(absl::string_view token) {
+  if (next_token_ == expected_tokens_.size()) return false;
+  // As in OutputsMatch, outputs match if all tokens are equal, or all values
+  // match, so a token that does neither rules out a match.
+  const std::string& expected = expected_tokens_[next_token_++];
+  return token == expected || ValuesMatch(token, expected);
+}
+
+RunningPrograms::Registration::Registration(Registration&& other)
+    : programs_(other.programs_), id_(other.id_) {
+  other.programs_ = nullptr;
+}
+
+bool RunningPrograms::Registration::Finish() {
+  if (programs_ == nullptr) return false;
+  // Kills run with the lock held, so none is running once this returns.
+  RunningPrograms* const programs = std::exchange(programs_, nullptr);
+  absl::MutexLock l(&programs->mutex_);
+  const auto it = programs->programs_.find(id_);
+  const bool killed = it->second.killed;
+  programs->programs_.erase(it);
+  return killed;
+}
+
+RunningPrograms::Registration RunningPrograms::Add(
+    std::function<void()> kill) {
+  absl::MutexLock l(&mutex_);
+  Program program{.kill = std::move(kill), .killed = killed_};
+  if (program.killed) program.kill();
+  const int64_t id = next_id_++;
+  programs_.emplace(id, std::move(program));
+  return Registration(this, id);
+}
+
+void RunningPrograms::KillAll() {
+  absl::MutexLock l(&mutex_);
+  killed_ = true;
+  for (auto& [id, program] : programs_) {
+    if (program.killed) continue;
+    program.kill();
+    program.killed = true;
+  }
+}
+
 TesterSandboxer::TesterSandboxer() {
   // It's important that we ignore SIGPIPE, which can be caused when the sandbox
   // is terminated (e.g. due to a violation).
@@ -271,7 +361,7 @@ TesterSandboxer::TesterSandboxer() {
 }
 
 absl::StatusOr<SandboxWithOutputFds> TesterSandboxer::CreateSandboxWithFds(
-    const std::vector<std::string>& command, absl::string_view stdin_data,
+    const std::vector<std::string>& command, const TestData& stdin_data,
     const std::vector<std::string>& ro_files,
     const std::vector<std::string>& ro_dirs,
     const std::vector<std::string>& rw_dirs, const TestOptions& test_options,
@@ -298,15 +388,17 @@ absl::StatusOr<SandboxWithOutputFds> TesterSandboxer::CreateSandboxWithFds(
       // Kill sandboxed processes with a signal (SIGXFSZ) if it writes more than
       // these many bytes to the file-system
       .set_rlimit_fsize(64ULL << 20)  // 64 MiB
-      .set_rlimit_cpu(std::max<int64_t>(
-          1, absl::ToInt64Seconds(test_options.max_execution_duration)));
+      .set_rlimit_cpu(
+          internal::CpuLimitSeconds(test_options.max_execution_duration));
 
-  if (!stdin_data.empty()) {
+  if (stdin_data.size() > 0) {
     // We must only create the buffer if there is data, as buffers of size zero
     // are not supported.
     ASSIGN_OR_RETURN(std::unique_ptr<sandbox2::Buffer> input_buffer,
                      sandbox2::Buffer::CreateWithSize(stdin_data.size()));
-    absl::c_copy(stdin_data, input_buffer->data());
+    // Data that is not in memory yet is produced straight into the buffer.
+    RETURN_IF_ERROR(stdin_data.CopyTo(absl::MakeSpan(
+        reinterpret_cast<char*>(input_buffer->data()), stdin_data.size())));
     // The dup here is very important. MapFd takes ownership of the FD in its
     // first argument. But buffer expects to retain ownership. We get around
     // this by duplicating the file descriptor.
@@ -338,6 +430,32 @@ absl::StatusOr<MultiTestResult> TesterSandboxer::Test(
     const std::vector<absl::string_view>& expected_test_outputs,
     std::function<bool(std::string_view a, std::string_view b)> compare_outputs)
     const {
+  return TestOnData(
+      code, std::vector<TestData>(test_inputs.begin(), test_inputs.end()),
+      test_options,
+      std::vector<TestData>(expected_test_outputs.begin(),
+                            expected_test_outputs.end()),
+      std::move(compare_outputs));
+}
+
+absl::StatusOr<MultiTestResult> TesterSandboxer::TestOnData(
+    absl::string_view code, const std::vector<TestData>& test_inputs,
+    const TestOptions& test_options,
+    const std::vector<TestData>& expected_test_outputs,
+    std::function<bool(std::string_view a, std::string_view b)> compare_outputs)
+    const {
+  ASSIGN_OR_RETURN(std::vector<MultiTestResult> results,
+                   TestMany({code}, test_inputs, test_options,
+                            expected_test_outputs, std::move(compare_outputs)));
+  return std::move(results.front());
+}
+
+absl::StatusOr<std::vector<MultiTestResult>> TesterSandboxer::TestMany(
+    const std::vector<absl::string_view>& codes,
+    const std::vector<TestData>& test_inputs, const TestOptions& test_options,
+    const std::vector<TestData>& expected_test_outputs,
+    std::function<bool(std::string_view a, std::string_view b)> compare_outputs)
+    const {
   const bool checking_outputs = !expected_test_outputs.empty();
   if (checking_outputs) {
     if (test_inputs.size() != expected_test_outputs.size()) {
@@ -352,76 +470,327 @@ absl::StatusOr<MultiTestResult> TesterSandboxer::Test(
         "stop_on_first_failure does not work if expected outputs are not "
         "provided.");
   }
-  MultiTestResult multi_test_result;
-  std::unique_ptr<TempPath> temp_path = absl::make_unique<TempPath>();
-  if (!temp_path) {
-    return absl::UnknownError("Unable to create temporary directory for code.");
+  if (test_options.num_threads < 1) {
+    return absl::InvalidArgumentError(absl::StrCat(
+        "num_threads must be at least 1, got ", test_options.num_threads, "."));
+  }
+  // The index of the first test of every tier, followed by the number of
+  // tests.
+  std::vector<int> tier_begins = {0};
+  for (const int tier_size : test_options.test_tiers) {
+    if (tier_size < 0) {
+      return absl::InvalidArgumentError("Test tiers must not be negative.");
+    }
+    tier_begins.push_back(tier_begins.back() + tier_size);
   }
-  // Compile and return if unsuccessful.
-  ASSIGN_OR_RETURN(multi_test_result.compilation_result, RetryIfFail([&] {
-                     return CompileCode(code, temp_path->path(),
-                                        kMaxCompilationDuration);
-                   }));
-  if (multi_test_result.compilation_result.program_status !=
-      ProgramStatus::kSuccess) {
-    return multi_test_result;
+  if (test_options.test_tiers.empty()) {
+    tier_begins.push_back(test_inputs.size());
+  } else if (tier_begins.back() != test_inputs.size()) {
+    return absl::InvalidArgumentError(absl::Substitute(
+        "Test tiers must add up to the number of tests. Actual sizes: $0 v $1.",
+        tier_begins.back(), test_inputs.size()));
+  }
+  const int num_tiers = tier_begins.size() - 1;
+  std::vector<absl::string_view> input_bytes;
+  std::vector<absl::string_view> output_bytes;
+  if (test_options.deduplicate_tests) {
+    // Tests are only compared if they are all in memory already.
+    for (const TestData& input : test_inputs) {
+      if (input.bytes().has_value()) input_bytes.push_back(*input.bytes());
+    }
+    for (const TestData& output : expected_test_outputs) {
+      if (output.bytes().has_value()) output_bytes.push_back(*output.bytes());
+    }
+  }
+  if (test_options.deduplicate_tests &&
+      input_bytes.size() == test_inputs.size() &&
+      output_bytes.size() == expected_test_outputs.size()) {
+    const DedupedTests deduped = DedupTests(input_bytes, output_bytes);
+    TestOptions distinct_options = test_options;
+    distinct_options.deduplicate_tests = false;
+    // Distinct tests keep the order of their first occurrence, so each one
+    // belongs to the tier it first occurs in.
+    if (!test_options.test_tiers.empty()) {
+      int num_distinct = 0;
+      for (int t = 0; t < num_tiers; ++t) {
+        int& tier_size = distinct_options.test_tiers[t];
+        tier_size = 0;
+        for (int i = tier_begins[t]; i < tier_begins[t + 1]; ++i) {
+          if (deduped.distinct_index[i] == num_distinct) {
+            ++tier_size;
+            ++num_distinct;
+          }
+        }
+      }
+    }
+    ASSIGN_OR_RETURN(
+        std::vector<MultiTestResult> multi_test_results,
+        TestMany(codes,
+                 std::vector<TestData>(deduped.inputs.begin(),
+                                       deduped.inputs.end()),
+                 distinct_options,
+                 std::vector<TestData>(deduped.outputs.begin(),
+                                       deduped.outputs.end()),
+                 std::move(compare_outputs)));
+    for (MultiTestResult& multi_test_result : multi_test_results) {
+      if (!multi_test_result.test_results.empty()) {
+        multi_test_result.test_results =
+            FanOutResults(multi_test_result.test_results, deduped);
+        multi_test_result.num_duplicate_tests = deduped.num_duplicates();
+      }
+    }
+    return multi_test_results;
+  }
+
+  // Whether outputs are compared with OutputsMatch, rather than a function
+  // that is only known by its address.
+  const auto* const compare_function =
+      compare_outputs.target<decltype(&OutputsMatch)>();
+  const bool compares_tokens =
+      compare_function != nullptr && *compare_function == &OutputsMatch;
+
+  // Results are only cached if program hashes can be compared, and whether
+  // they passed does not depend on a comparison the cache's keys leave out.
+  ResultCache* const cache =
+      CompilerId().empty() || (checking_outputs && !compares_tokens)
+          ? nullptr
+          : test_options.result_cache;
+  uint64_t tests_hash = 0;
+  if (cache != nullptr) {
+    ASSIGN_OR_RETURN(tests_hash, HashTests(test_inputs, expected_test_outputs,
+                                           test_options));
   }
 
-  multi_test_result.test_results.resize(test_inputs.size());
+  // The state of testing a single program.
+  struct ProgramRun {
+    std::unique_ptr<TempPath> temp_path;
+    MultiTestResult result;
+    // If we should stop on first failure, we set this on failures, and kill
+    // the tests that are running.
+    bool should_stop = false;
+    RunningPrograms running;
+    // The tier whose tests are running, the number of them that have not
+    // finished, when they started, and whether all that finished passed.
+    int tier = 0;
+    int tier_tests_pending = 0;
+    absl::Time tier_start;
+    bool tier_passed = true;
+    // The key of the program's results, if they are cached.
+    std::optional<ResultCacheKey> cache_key;
+    // An earlier program of this call with the same key, whose results are
+    // copied rather than running the same tests twice.
+    const ProgramRun* same_as = nullptr;
+  };
+  std::vector<ProgramRun> runs(codes.size());
   absl::Status overall_status;
   absl::Mutex output_mutex;
-  // If we should stop on first failure, we set this on failures. We always set
-  // it on failures to execute.
-  bool should_stop = false;
-
-  {
-    ThreadPool pool(test_options.num_threads);
-    pool.StartWorkers();
-    for (int i = 0; i < test_inputs.size(); ++i) {
-      pool.Schedule([&, i] {
-        absl::StatusOr<ExecutionResult> test_result =
-            RetryIfFail([&]() -> absl::StatusOr<ExecutionResult> {
-              {
-                absl::ReaderMutexLock l(&output_mutex);
-                if (should_stop) {
-                  return absl::CancelledError("should_stop");
-                }
-              }
-              return RunCodeOnInput(test_inputs[i], test_options,
-                                    temp_path->path());
-            });
-        if (test_result.status().code() == absl::StatusCode::kCancelled) {
-          return;
-        }
-        absl::MutexLock l(&output_mutex);
-        overall_status.Update(test_result.status());
-        if (!test_result.ok()) {
-          // If we see a not-OK status, we are not going to return any results,
-          // so should stop immediately.
-          should_stop = true;
-        } else if (checking_outputs) {
-          const bool matches =
-              compare_outputs(test_result->stdout, expected_test_outputs[i]);
-          if (test_options.stop_on_first_failure && !matches) {
-            should_stop = true;
+  absl::flat_hash_map<ResultCacheKey, const ProgramRun*> run_by_cache_key;
+  // Tasks that have been scheduled but not finished. Running tasks schedule
+  // further tasks, so the pool may only be destroyed once there are none.
+  int pending_tasks = 0;
+  ThreadPool pool(test_options.num_threads);
+  pool.StartWorkers();
+  // Schedules `task` on the pool. Must be called with `output_mutex` held.
+  const auto schedule = [&](std::function<void()> task) {
+    ++pending_tasks;
+    pool.Schedule([&, task = std::move(task)] {
+      task();
+      absl::MutexLock l(&output_mutex);
+      --pending_tasks;
+    });
+  };
+
+  // Schedules the tests of the current tier of `run`, skipping empty tiers.
+  // Must be called with `output_mutex` held.
+  std::function<void(ProgramRun&)> start_tier;
+  // Records that a test of `run` finished, and starts the next tier once the
+  // current one passed. Must be called with `output_mutex` held.
+  const auto finish_test = [&](ProgramRun& run) {
+    if (--run.tier_tests_pending > 0) return;
+    run.result.tier_durations.push_back(absl::Now() - run.tier_start);
+    if (run.tier_passed && !run.should_stop && overall_status.ok()) {
+      ++run.tier;
+      start_tier(run);
+    }
+  };
+
+  // Outputs can only be compared as they are produced if they are compared
+  // token by token.
+  const bool stream_outputs =
+      test_options.stream_outputs && checking_outputs && compares_tokens;
+
+  const auto run_test = [&](ProgramRun& run, const int i) {
+    // Expected outputs that are not in memory are only produced once they are
+    // needed, which is before running if outputs are streamed.
+    std::string expected_output_storage;
+    absl::StatusOr<absl::string_view> expected_output = absl::string_view();
+    if (stream_outputs) {
+      expected_output =
+          ContentsOf(expected_test_outputs[i], expected_output_storage);
+    }
+    std::optional<StreamingOutputComparator> comparator;
+    absl::StatusOr<ExecutionResult> test_result = expected_output.status();
+    if (test_result.ok()) {
+      test_result = RetryIfFail([&]() -> absl::StatusOr<ExecutionResult> {
+        {
+          absl::ReaderMutexLock l(&output_mutex);
+          // We always stop every program on failures to execute.
+          if (run.should_stop || !overall_status.ok()) {
+            return absl::CancelledError("should_stop");
           }
-          test_result->passed = matches;
-        }
-        if (test_result.ok()) {
-          multi_test_result.test_results[i] = *std::move(test_result);
         }
+        if (stream_outputs) comparator.emplace(*expected_output);
+        return RunCodeOnInput(test_inputs[i], test_options,
+                              run.temp_path->path(),
+                              comparator.has_value() ? &*comparator : nullptr,
+                              &run.running);
+      });
+    }
+    if (test_result.status().code() == absl::StatusCode::kCancelled) {
+      absl::MutexLock l(&output_mutex);
+      finish_test(run);
+      return;
+    }
+    if (test_result.ok() && comparator.has_value() &&
+        comparator->mismatched()) {
+      // The program was killed for its output, which fails the test whatever
+      // it would have done next.
+      test_result->program_status = ProgramStatus::kSuccess;
+      test_result->sandbox_result = absl::StrCat(
+          "Killed on output mismatch: ", test_result->sandbox_result);
+    }
+    // Tests that were killed because others failed have no output to compare.
+    const bool cancelled =
+        test_result.ok() &&
+        test_result->program_status == ProgramStatus::kCancelled;
+    if (test_result.ok() && checking_outputs && !stream_outputs && !cancelled) {
+      expected_output =
+          ContentsOf(expected_test_outputs[i], expected_output_storage);
+      if (!expected_output.ok()) test_result = expected_output.status();
+    }
+    absl::MutexLock l(&output_mutex);
+    // If we see a not-OK status, we are not going to return any results, so
+    // every program stops immediately.
+    if (overall_status.ok() && !test_result.ok()) {
+      for (ProgramRun& other_run : runs) {
+        other_run.running.KillAll();
+      }
+    }
+    overall_status.Update(test_result.status());
+    if (test_result.ok() && checking_outputs && !cancelled) {
+      const bool matches =
+          compare_outputs(test_result->stdout, *expected_output);
+      if (test_options.stop_on_first_failure && !matches) {
+        run.should_stop = true;
+        run.running.KillAll();
+      }
+      if (!matches) run.tier_passed = false;
+      test_result->passed = matches;
+    }
+    if (test_result.ok()) {
+      run.result.test_results[i] = *std::move(test_result);
+    }
+    finish_test(run);
+  };
+
+  start_tier = [&](ProgramRun& run) {
+    while (run.tier < num_tiers &&
+           tier_begins[run.tier] == tier_begins[run.tier + 1]) {
+      run.result.tier_durations.push_back(absl::ZeroDuration());
+      ++run.tier;
+    }
+    if (run.tier == num_tiers) return;
+    run.tier_tests_pending = tier_begins[run.tier + 1] - tier_begins[run.tier];
+    run.tier_start = absl::Now();
+    for (int i = tier_begins[run.tier]; i < tier_begins[run.tier + 1]; ++i) {
+      schedule([&, i] { run_test(run, i); });
+    }
+  };
+
+  const auto compile = [&](ProgramRun& run, const absl::string_view code) {
+    {
+      absl::ReaderMutexLock l(&output_mutex);
+      if (!overall_status.ok()) return;
+    }
+    absl::StatusOr<ExecutionResult> compilation_result =
+        absl::UnknownError("Unable to create temporary directory for code.");
+    run.temp_path = absl::make_unique<TempPath>();
+    if (run.temp_path) {
+      compilation_result = RetryIfFail([&] {
+        return CompileCode(code, run.temp_path->path(),
+                           kMaxCompilationDuration);
       });
     }
+    std::optional<std::vector<ExecutionResult>> cached_results;
+    if (cache != nullptr && compilation_result.ok() &&
+        compilation_result->program_status == ProgramStatus::kSuccess) {
+      run.cache_key = ResultCacheKey{
+          .problem = test_options.problem_id,
+          .compiler = CompilerId(),
+          .program_hash = compilation_result->program_hash,
+          .tests_hash = tests_hash};
+      cached_results = cache->Lookup(*run.cache_key);
+    }
+    absl::MutexLock l(&output_mutex);
+    overall_status.Update(compilation_result.status());
+    if (!compilation_result.ok()) return;
+    run.result.compilation_result = *std::move(compilation_result);
+    if (run.result.compilation_result.program_status !=
+        ProgramStatus::kSuccess) {
+      return;
+    }
+    if (cached_results.has_value()) {
+      run.result.test_results = *std::move(cached_results);
+      run.result.from_cache = true;
+      return;
+    }
+    if (run.cache_key.has_value()) {
+      const auto [it, inserted] =
+          run_by_cache_key.try_emplace(*run.cache_key, &run);
+      if (!inserted) {
+        run.same_as = it->second;
+        return;
+      }
+    }
+    // Tests of programs that compiled first are queued first, behind the
+    // compilations that have not started yet.
+    run.result.test_results.resize(test_inputs.size());
+    start_tier(run);
+  };
+
+  {
+    absl::MutexLock l(&output_mutex);
+    for (int c = 0; c < codes.size(); ++c) {
+      schedule([&, c] { compile(runs[c], codes[c]); });
+    }
+    output_mutex.Await(absl::Condition(
+        +[](int* pending_tasks) { return *pending_tasks == 0; },
+        &pending_tasks));
   }
 
   RETURN_IF_ERROR(overall_status);
 
-  return multi_test_result;
+  for (ProgramRun& run : runs) {
+    if (run.same_as != nullptr) {
+      run.result.test_results = run.same_as->result.test_results;
+      run.result.from_cache = true;
+    } else if (run.cache_key.has_value() && !run.result.from_cache) {
+      cache->Insert(*run.cache_key, run.result.test_results);
+    }
+  }
+
+  std::vector<MultiTestResult> multi_test_results;
+  multi_test_results.reserve(runs.size());
+  for (ProgramRun& run : runs) {
+    multi_test_results.push_back(std::move(run.result));
+  }
+  return multi_test_results;
 }
 
 absl::StatusOr<ExecutionResult> TesterSandboxer::RunCodeOnInput(
-    absl::string_view test_input, const TestOptions& test_options,
-    absl::string_view temp_path) const {
+    const TestData& test_input, const TestOptions& test_options,
+    absl::string_view temp_path, StreamingOutputComparator* comparator,
+    RunningPrograms* running) const {
   ASSIGN_OR_RETURN(SandboxWithOutputFds sandbox_with_fds,
                    CreateTestSandbox(test_input, test_options, temp_path));
   const absl::Time start_time = absl::Now();
@@ -431,28 +800,58 @@ absl::StatusOr<ExecutionResult> TesterSandboxer::RunCodeOnInput(
   // Set a wall time limit to guard against code that sleeps forever.
   sandbox_with_fds.Sandbox().set_walltime_limit(
       test_options.max_execution_duration * 30);
-  absl::StatusOr<std::string> stdout_contents;
-  absl::StatusOr<std::string> stderr_contents;
-  {
-    ThreadPool pool(2);
-    pool.StartWorkers();
-    pool.Schedule([&] { stdout_contents = sandbox_with_fds.Stdout(); });
-    pool.Schedule([&] { stderr_contents = sandbox_with_fds.Stderr(); });
+  RunningPrograms::Registration registration =
+      running != nullptr ? running->Add([&sandbox_with_fds] {
+        sandbox_with_fds.Sandbox().Kill();
+      })
+                         : RunningPrograms::Registration();
+  OutputCollector::ChunkCallback on_chunk;
+  if (comparator != nullptr) {
+    on_chunk = [&](const int index, const absl::string_view chunk) {
+      if (index != 0 || comparator->Add(chunk)) return true;
+      sandbox_with_fds.Sandbox().Kill();
+      return false;
+    };
   }
-  RETURN_IF_ERROR(stdout_contents.status());
-  RETURN_IF_ERROR(stderr_contents.status());
+  RETURN_IF_ERROR(sandbox_with_fds.CollectOutputs(OutputCollector::Shared(),
+                                                  std::move(on_chunk)));
+  ASSIGN_OR_RETURN(std::string stdout_contents, sandbox_with_fds.Stdout());
+  ASSIGN_OR_RETURN(std::string stderr_contents, sandbox_with_fds.Stderr());
   sandbox2::Result result = sandbox_with_fds.Sandbox().AwaitResult();
   const absl::Time end_time = absl::Now();
+  // A program that exited by itself before it was killed keeps its result.
+  const bool cancelled =
+      registration.Finish() &&
+      result.final_status() == sandbox2::Result::EXTERNAL_KILL;
   ExecutionResult execution_result =
       internal::ExecutionResultFromTestSandboxResult(result);
-  execution_result.stdout = *std::move(stdout_contents);
-  execution_result.stderr = *std::move(stderr_contents);
+  if (cancelled) execution_result.program_status = ProgramStatus::kCancelled;
+  execution_result.stdout = std::move(stdout_contents);
+  execution_result.stderr = std::move(stderr_contents);
   execution_result.execution_duration = end_time - start_time;
   return execution_result;
 }
 
 namespace internal {
 
+absl::StatusOr<std::string> ReadFd(const int fd) {
+  std::string contents;
+  constexpr int64_t buffer_size = 4096;
+  const auto buffer = std::make_unique<char[]>(buffer_size);
+  for (;;) {
+    const ssize_t n =
+        BlockingReadIgnoringInterruptions(fd, buffer.get(), buffer_size);
+    if (n < 0) {
+      return absl::UnknownError(
+          absl::Substitute("Reading FD $0 failed with errno $1", fd, errno));
+    }
+    if (n == 0) {
+      return contents;
+    }
+    contents.append(buffer.get(), n);
+  }
+}
+
 // MADV_FREE is not defined in all versions
 #ifndef MADV_FREE
 #define MADV_FREE 0x8
@@ -628,6 +1027,12 @@ sandbox2::PolicyBuilder CreateBasePolicy(absl::string_view binary,
   return builder;
 }
 
+int64_t CpuLimitSeconds(const absl::Duration max_execution_duration) {
+  return std::max<int64_t>(
+      1, absl::ToInt64Seconds(absl::Ceil(max_execution_duration,
+                                         absl::Seconds(1))));
+}
+
 ExecutionResult ExecutionResultFromCompilationSandboxResult(
     const sandbox2::Result& sandbox_result) {
   ExecutionResult execution_result;
@@ -36,11 +36,16 @@
 #include <tuple>
 #include <vector>
 
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
 #include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
 #include "absl/time/time.h"
+#include "execution/output_collector.h"
 #include "execution/temp_path.h"
+#include "execution/test_data.h"
 #include "sandboxed_api/sandbox2/policy.h"
 #include "sandboxed_api/sandbox2/policybuilder.h"
 #include "sandboxed_api/sandbox2/result.h"
@@ -48,7 +53,9 @@
 
 namespace deepmind::code_contests {
 
-enum class ProgramStatus { kUnknown, kSuccess, kFailed, kTimeout };
+// kCancelled is for tests whose program was killed because the results of other
+// tests made them unnecessary, see TestOptions::stop_on_first_failure.
+enum class ProgramStatus { kUnknown, kSuccess, kFailed, kTimeout, kCancelled };
 
 // The result of a single test execution.
 struct ExecutionResult {
@@ -82,19 +89,61 @@ struct ExecutionResult {
 struct MultiTestResult {
   ExecutionResult compilation_result;
   std::vector<ExecutionResult> test_results;
+  // The number of tests that were not run because they duplicate another test,
+  // if TestOptions::deduplicate_tests is set. Their results are copies of the
+  // results of the tests they duplicate.
+  int num_duplicate_tests = 0;
+  // Whether `test_results` were copied from an identical program rather than
+  // run, see TestOptions::result_cache.
+  bool from_cache = false;
+  // The time taken by each tier of tests that ran, see TestOptions::test_tiers.
+  // If a tier does not pass, later tiers do not run and have no entry. Empty
+  // if the program did not compile or `from_cache` is set.
+  std::vector<absl::Duration> tier_durations;
 };
 
 std::ostream& operator<<(std::ostream& os, const ExecutionResult& result);
 std::ostream& operator<<(std::ostream& os, const MultiTestResult& multi_result);
 
+class ResultCache;
+
 /* Default to limit of 256 MiB */
 inline constexpr int64_t kDefaultMemoryLimitBytes = INT64_C(256) << 20;
 
 struct TestOptions {
   absl::Duration max_execution_duration = absl::Seconds(10);
+  // Must be at least 1.
   int num_threads = 1;
   int64_t memory_limit_bytes = kDefaultMemoryLimitBytes;
+  // If true, a program's remaining tests are not run once one of them fails,
+  // and tests that are still running are killed, with
+  // ProgramStatus::kCancelled.
   bool stop_on_first_failure = false;
+  // If true, tests with the same input and expected output are only run once
+  // (see test_dedup.h).
+  bool deduplicate_tests = false;
+  // If set, programs with the same program hash as one tested before on the
+  // same tests take its results from this cache instead of being run, and
+  // results of programs that are run are added to it (see result_cache.h).
+  // Keys do not identify how outputs are compared, so the cache is only used
+  // if they are not, or are compared with OutputsMatch.
+  ResultCache* result_cache = nullptr;
+  // Identifies the problem being tested in keys of `result_cache`.
+  std::string problem_id;
+  // The sizes of consecutive tiers that the tests are split into, which must
+  // add up to the number of tests, e.g. the number of public, private and
+  // generated tests. The tests of a tier only run once every test of the
+  // previous tier passed, so most failing programs only run the first tier.
+  // Tests in tiers that did not run have no result. If empty, all tests form
+  // a single tier.
+  std::vector<int> test_tiers;
+  // If true, and outputs are compared with OutputsMatch, stdout is compared
+  // with the expected output as the program prints it (see
+  // StreamingOutputComparator), and the program is killed as soon as its
+  // output cannot match. Such programs fail the test with the output they
+  // printed until then, and ProgramStatus::kSuccess, as they would have if
+  // they had run to the end.
+  bool stream_outputs = false;
 };
 
 // A class that holds a sandbox, with (optional) file descriptors for its
@@ -118,6 +167,12 @@ class SandboxWithOutputFds {
 
   absl::StatusOr<std::string> Stdout();
   absl::StatusOr<std::string> Stderr();
+  // Reads stdout and stderr on `collector`'s thread, until the end of both, so
+  // that Stdout and Stderr return without reading. `on_chunk` is called with
+  // what is read, with index 0 for stdout and 1 for stderr.
+  absl::Status CollectOutputs(
+      OutputCollector& collector,
+      OutputCollector::ChunkCallback on_chunk = nullptr);
   sandbox2::Sandbox2& Sandbox() { return *sandbox_; }
 
   static constexpr int kInvalidFd = -1;
@@ -137,6 +192,75 @@ std::vector<std::string> CopyEnviron();
 // errors.
 bool OutputsMatch(absl::string_view output, absl::string_view expected);
 
+// Compares output with the expected output while it is being produced, token by
+// token as OutputsMatch does, to find output that cannot match before it ends.
+class StreamingOutputComparator {
+ public:
+  explicit StreamingOutputComparator(absl::string_view expected);
+
+  // Adds the next chunk of output. Returns false once the output cannot match:
+  // a token differs from the expected one, or there are more tokens than
+  // expected. OutputsMatch then rejects any output that starts with the chunks
+  // added so far.
+  bool Add(absl::string_view chunk);
+
+  // Whether Add returned false.
+  bool mismatched() const { return mismatched_; }
+
+ private:
+  bool AddToken(absl::string_view token);
+
+  std::vector<std::string> expected_tokens_;
+  int next_token_ = 0;
+  // The lowercased start of a token that has not ended yet.
+  std::string partial_token_;
+  bool mismatched_ = false;
+};
+
+// The programs running the tests of a program, so that they can all be killed
+// once their results are no longer needed. Thread-safe.
+class RunningPrograms {
+ public:
+  // Keeps a program registered until it is destroyed or finished.
+  class Registration {
+   public:
+    // Registers nothing.
+    Registration() = default;
+    Registration(RunningPrograms* programs, int64_t id)
+        : programs_(programs), id_(id) {}
+    Registration(Registration&& other);
+    Registration& operator=(Registration&& other) = delete;
+    ~Registration() { Finish(); }
+
+    // Unregisters the program, which must not be killed afterwards. Returns
+    // whether KillAll killed it while it was registered, which may have been
+    // after it exited by itself.
+    bool Finish();
+
+   private:
+    RunningPrograms* programs_ = nullptr;
+    int64_t id_ = 0;
+  };
+
+  // Registers a running program, which `kill` kills. `kill` must return
+  // quickly, and is called straight away if KillAll was called already.
+  Registration Add(std::function<void()> kill);
+
+  // Kills every registered program, and every one registered later.
+  void KillAll();
+
+ private:
+  struct Program {
+    std::function<void()> kill;
+    bool killed = false;
+  };
+
+  absl::Mutex mutex_;
+  bool killed_ ABSL_GUARDED_BY(mutex_) = false;
+  int64_t next_id_ ABSL_GUARDED_BY(mutex_) = 0;
+  absl::flat_hash_map<int64_t, Program> programs_ ABSL_GUARDED_BY(mutex_);
+};
+
 // The TesterSandboxer class can execute tests with any suitable sandboxees.
 //
 // The control flow is as follows:
@@ -165,10 +289,36 @@ class TesterSandboxer {
       const std::vector<absl::string_view>& expected_test_outputs = {},
       std::function<bool(std::string_view a, std::string_view b)>
           compare_outputs = OutputsMatch) const;
+  // As Test, but inputs and outputs that are not in memory are only produced
+  // when their test runs. Such tests are never deduplicated.
+  absl::StatusOr<MultiTestResult> TestOnData(
+      absl::string_view code, const std::vector<TestData>& test_inputs,
+      const TestOptions& test_options = TestOptions(),
+      const std::vector<TestData>& expected_test_outputs = {},
+      std::function<bool(std::string_view a, std::string_view b)>
+          compare_outputs = OutputsMatch) const;
+  // As TestOnData, for several programs at once. Programs are compiled
+  // concurrently, and every (program, test) pair runs on a single pool of
+  // `test_options.num_threads` workers, so the pool stays busy even if there
+  // are fewer tests than workers. `stop_on_first_failure` stops only the
+  // program that failed. Returns one result per program, in order.
+  absl::StatusOr<std::vector<MultiTestResult>> TestMany(
+      const std::vector<absl::string_view>& codes,
+      const std::vector<TestData>& test_inputs,
+      const TestOptions& test_options = TestOptions(),
+      const std::vector<TestData>& expected_test_outputs = {},
+      std::function<bool(std::string_view a, std::string_view b)>
+          compare_outputs = OutputsMatch) const;
 
  protected:
+  // Identifies the compiler or interpreter that program hashes are specific
+  // to. Results are only cached if this is not empty, as hashes of programs
+  // that were compiled differently cannot be compared.
+  virtual std::string CompilerId() const { return ""; }
+  // Creates a sandbox running `command`, with `stdin_data` written straight
+  // into the buffer the sandbox reads its stdin from.
   absl::StatusOr<SandboxWithOutputFds> CreateSandboxWithFds(
-      const std::vector<std::string>& command, absl::string_view stdin_data,
+      const std::vector<std::string>& command, const TestData& stdin_data,
       const std::vector<std::string>& ro_files,
       const std::vector<std::string>& ro_dirs,
       const std::vector<std::string>& rw_dirs, const TestOptions& test_options,
@@ -181,7 +331,7 @@ class TesterSandboxer {
   // Creates a sandbox for running the previously compiled code on `test_input`.
   // It should not start the sandbox; i.e. should not call RunAsync().
   virtual absl::StatusOr<SandboxWithOutputFds> CreateTestSandbox(
-      absl::string_view test_input, const TestOptions& test_options,
+      const TestData& test_input, const TestOptions& test_options,
       absl::string_view temp_path) const = 0;
   // Returns a policy for sandboxes. These should have permission to read the
   // code and binary, as well as read-write access to `temp_path`.
@@ -189,12 +339,15 @@ class TesterSandboxer {
       absl::string_view binary_path, const std::vector<std::string>& ro_files,
       const std::vector<std::string>& ro_dirs,
       const std::vector<std::string>& rw_dirs) const = 0;
-
- private:
-  // Runs the previously compiled code on `test_input`.
-  absl::StatusOr<ExecutionResult> RunCodeOnInput(
-      absl::string_view test_input, const TestOptions& test_options,
-      absl::string_view temp_path) const;
+  // Runs the previously compiled code on `test_input`. By default, in the
+  // sandbox made by CreateTestSandbox. If `comparator` is not null, stdout is
+  // added to it as it is read, and the program is killed once it mismatches.
+  // If `running` is not null, the program is registered there while it runs,
+  // and reported as ProgramStatus::kCancelled if it is killed through it.
+  virtual absl::StatusOr<ExecutionResult> RunCodeOnInput(
+      const TestData& test_input, const TestOptions& test_options,
+      absl::string_view temp_path, StreamingOutputComparator* comparator,
+      RunningPrograms* running) const;
 };
 
 namespace internal {
@@ -206,10 +359,18 @@ struct Mappings {
   std::vector<std::string> rw_dirs;
 };
 
+// Reads `fd` until the end of the file.
+absl::StatusOr<std::string> ReadFd(int fd);
+
 // Creates a sandbox2 policy for executing generated programs in a subprocess.
 sandbox2::PolicyBuilder CreateBasePolicy(absl::string_view binary,
                                          const Mappings& mappings);
 
+// Returns the CPU time rlimit, in seconds, for tests limited to
+// `max_execution_duration`. Rlimits are whole seconds, and limits scaled per
+// problem rarely are, so they are rounded up rather than made stricter.
+int64_t CpuLimitSeconds(absl::Duration max_execution_duration);
+
 // These are useful helper functions for filling in test results.
 
 // Converts a sandbox result from a compilation into a ExecutionResult struct.
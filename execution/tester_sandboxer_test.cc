@@ -45,8 +45,10 @@
 #include "absl/types/optional.h"
 #include "execution/py_locations.h"
 #include "execution/py_tester_sandboxer.h"
+#include "execution/result_cache.h"
 #include "execution/status_macros.h"
 #include "execution/status_matchers.h"
+#include "execution/test_data.h"
 #include "sandboxed_api/sandbox2/sandbox2.h"
 #include "execution/simple_threadpool.h"
 
@@ -61,6 +63,7 @@ using ::testing::AllOf;
 using ::testing::Each;
 using ::testing::ElementsAre;
 using ::testing::ExplainMatchResult;
+using ::testing::IsEmpty;
 using ::testing::SizeIs;
 
 // Matchers for MultiTestResult
@@ -115,6 +118,10 @@ struct LanguageTestParams {
   std::string asserts;
   // A program that loops forever.
   std::string loops_forever;
+  // A program that prints "no\n" forever.
+  std::string prints_forever;
+  // A program that exits on empty input, and loops forever otherwise.
+  std::string loops_on_input;
   // A program that sleeps for two seconds.
   std::string sleeps_2_seconds;
   // A program that contains unicode.
@@ -140,6 +147,10 @@ std::ostream& operator<<(std::ostream& os, const LanguageTestParams& params) {
      << params.asserts << "\n\n"
      << "loops_forever:\n"
      << params.loops_forever << "\n\n"
+     << "prints_forever:\n"
+     << params.prints_forever << "\n\n"
+     << "loops_on_input:\n"
+     << params.loops_on_input << "\n\n"
      << "sleeps_2_seconds:\n"
      << params.sleeps_2_seconds << "\n\n"
      << "has_unicode:\n"
@@ -186,6 +197,16 @@ import math
 x = 1.
 while True:
   x += math.sin(x)
+)py",
+      .prints_forever = R"py(
+while True:
+  print('no')
+)py",
+      .loops_on_input = R"py(
+import sys
+if sys.stdin.read():
+  while True:
+    pass
 )py",
       .sleeps_2_seconds = "import time; time.sleep(2)",
       .has_unicode = "print('money')  # £££££",
@@ -203,7 +224,15 @@ while True:
   py2.hello = "print 'hello'";
   py2.has_unicode = "print 'money'   # £££££";
 
-  std::vector<LanguageTestParams> params = {py3};
+  // Py3 tests forked from zygotes should behave exactly as py3.
+  LanguageTestParams py3_zygote = py3;
+  py3_zygote.name = "py3_zygote";
+  py3_zygote.init = []() {
+    return std::make_unique<Py3TesterSandboxer>(
+        Py3InterpreterPath(), Py3LibraryPaths(), /*use_zygote=*/true);
+  };
+
+  std::vector<LanguageTestParams> params = {py3, py3_zygote};
   if (absl::GetFlag(FLAGS_test_py2)) {
     params.push_back(py2);
   }
@@ -337,6 +366,27 @@ TEST_P(TesterSandboxerLanguageTest, HandlesTimeout) {
                   ElementsAre(HasProgramStatus(ProgramStatus::kTimeout)))));
 }
 
+TEST_P(TesterSandboxerLanguageTest, KillsOnStreamedOutputMismatch) {
+  const LanguageTestParams& params = GetParam();
+  std::unique_ptr<TesterSandboxer> tester_sandboxer = params.init();
+  TestOptions options;
+  options.max_execution_duration = absl::Seconds(10);
+  options.stream_outputs = true;
+  ASSERT_OK_AND_ASSIGN(
+      const MultiTestResult result,
+      tester_sandboxer->Test(params.prints_forever, {"", ""}, options,
+                             {"yes", "no no"}));
+  ASSERT_THAT(result.test_results, SizeIs(2));
+  // Killed on the first token, and once it printed more than expected.
+  for (const ExecutionResult& test_result : result.test_results) {
+    EXPECT_THAT(test_result,
+                AllOf(HasProgramStatus(ProgramStatus::kSuccess),
+                      HasDurationBetween(absl::ZeroDuration(),
+                                         absl::Seconds(5))));
+    EXPECT_EQ(test_result.passed, false);
+  }
+}
+
 TEST_P(TesterSandboxerLanguageTest, DurationSetCorrectly) {
   const LanguageTestParams& params = GetParam();
   std::unique_ptr<TesterSandboxer> tester_sandboxer = params.init();
@@ -458,6 +508,176 @@ TEST_P(TesterSandboxerLanguageTest, ExpectedOutputsStopOnFirstFailure) {
       1);
 }
 
+TEST_P(TesterSandboxerLanguageTest, StopOnFirstFailureKillsRunningTests) {
+  const LanguageTestParams& params = GetParam();
+  // The first test fails straight away, the others would run until their
+  // time limit.
+  const std::vector<absl::string_view> inputs = {"", "x", "x", "x"};
+  const std::vector<absl::string_view> expected_outputs(4, "hello\n");
+  TestOptions opts;
+  opts.num_threads = 4;
+  opts.max_execution_duration = absl::Seconds(20);
+  opts.stop_on_first_failure = true;
+  std::unique_ptr<TesterSandboxer> tester_sandboxer = params.init();
+  const absl::Time start = absl::Now();
+  ASSERT_OK_AND_ASSIGN(auto result,
+                       tester_sandboxer->Test(
+                           params.loops_on_input, inputs, opts,
+                           expected_outputs,
+                           [](std::string_view a, std::string_view b) -> bool {
+                             return a == b;
+                           }));
+  EXPECT_LT(absl::Now() - start, absl::Seconds(10));
+  ASSERT_THAT(result.test_results, SizeIs(4));
+  EXPECT_EQ(result.test_results[0].passed, false);
+  // The others were killed, or not started if they had not been yet.
+  for (int i = 1; i < 4; ++i) {
+    EXPECT_THAT(result.test_results[i].program_status,
+                testing::AnyOf(ProgramStatus::kCancelled,
+                               ProgramStatus::kUnknown));
+    EXPECT_FALSE(result.test_results[i].passed.has_value());
+  }
+}
+
+TEST_P(TesterSandboxerLanguageTest, DeduplicatesTests) {
+  const LanguageTestParams& params = GetParam();
+  const std::vector<absl::string_view> inputs(100);
+  const std::string hello_output = "hello\n";
+  std::vector<std::string_view> expected_outputs(100, hello_output);
+  expected_outputs[3] = "goodbye\n";
+  TestOptions opts;
+  opts.num_threads = 4;
+  opts.deduplicate_tests = true;
+  std::unique_ptr<TesterSandboxer> tester_sandboxer = params.init();
+  ASSERT_OK_AND_ASSIGN(auto result,
+                       tester_sandboxer->Test(
+                           params.hello, inputs, opts, expected_outputs,
+                           [](std::string_view a, std::string_view b) -> bool {
+                             return a == b;
+                           }));
+  // Only the two distinct tests were run, but every test has a result.
+  EXPECT_EQ(result.num_duplicate_tests, 98);
+  ASSERT_THAT(result.test_results, SizeIs(100));
+  for (int i = 0; i < 100; ++i) {
+    EXPECT_EQ(result.test_results[i].passed, i != 3) << i;
+  }
+}
+
+TEST_P(TesterSandboxerLanguageTest, RunsTestTiersInOrder) {
+  const LanguageTestParams& params = GetParam();
+  const std::vector<absl::string_view> inputs(10);
+  const std::string hello_output = "hello\n";
+  std::vector<std::string_view> expected_outputs(10, hello_output);
+  TestOptions opts;
+  opts.num_threads = 4;
+  opts.test_tiers = {2, 0, 8};
+  const auto equal = [](std::string_view a, std::string_view b) -> bool {
+    return a == b;
+  };
+  std::unique_ptr<TesterSandboxer> tester_sandboxer = params.init();
+  ASSERT_OK_AND_ASSIGN(auto result,
+                       tester_sandboxer->Test(params.hello, inputs, opts,
+                                              expected_outputs, equal));
+  EXPECT_THAT(result.tier_durations, SizeIs(3));
+  for (const ExecutionResult& test_result : result.test_results) {
+    EXPECT_EQ(test_result.passed, true);
+  }
+
+  // A failure in the first tier keeps the last one from running.
+  expected_outputs[1] = "goodbye\n";
+  ASSERT_OK_AND_ASSIGN(result,
+                       tester_sandboxer->Test(params.hello, inputs, opts,
+                                              expected_outputs, equal));
+  EXPECT_THAT(result.tier_durations, SizeIs(1));
+  ASSERT_THAT(result.test_results, SizeIs(10));
+  EXPECT_EQ(result.test_results[0].passed, true);
+  EXPECT_EQ(result.test_results[1].passed, false);
+  for (int i = 2; i < 10; ++i) {
+    EXPECT_EQ(result.test_results[i].passed, std::nullopt) << i;
+  }
+
+  opts.test_tiers = {2, 7};
+  EXPECT_THAT(tester_sandboxer->Test(params.hello, inputs, opts,
+                                     expected_outputs, equal),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+TEST_P(TesterSandboxerLanguageTest, TestsManyPrograms) {
+  const LanguageTestParams& params = GetParam();
+  const std::vector<TestData> inputs(3, TestData(""));
+  const std::vector<TestData> expected_outputs(3, TestData("hello\n"));
+  TestOptions opts;
+  opts.num_threads = 4;
+  opts.stop_on_first_failure = true;
+  std::unique_ptr<TesterSandboxer> tester_sandboxer = params.init();
+  ASSERT_OK_AND_ASSIGN(
+      std::vector<MultiTestResult> results,
+      tester_sandboxer->TestMany(
+          {params.hello, params.bad_syntax, params.asserts}, inputs, opts,
+          expected_outputs,
+          [](std::string_view a, std::string_view b) -> bool {
+            return a == b;
+          }));
+  ASSERT_THAT(results, SizeIs(3));
+  // A failing program does not stop the others.
+  EXPECT_THAT(results[0].test_results, SizeIs(3));
+  for (const ExecutionResult& result : results[0].test_results) {
+    EXPECT_EQ(result.passed, true);
+  }
+  EXPECT_EQ(results[1].compilation_result.program_status,
+            ProgramStatus::kFailed);
+  EXPECT_THAT(results[1].test_results, IsEmpty());
+  EXPECT_TRUE(absl::c_any_of(results[2].test_results,
+                             [](const ExecutionResult& result) {
+                               return result.passed == false;
+                             }));
+}
+
+TEST_P(TesterSandboxerLanguageTest, ReusesResultsOfIdenticalPrograms) {
+  const LanguageTestParams& params = GetParam();
+  InMemoryResultCache cache;
+  TestOptions opts;
+  opts.result_cache = &cache;
+  opts.problem_id = "hello";
+  std::unique_ptr<TesterSandboxer> tester_sandboxer = params.init();
+  ASSERT_OK_AND_ASSIGN(MultiTestResult first,
+                       tester_sandboxer->Test(params.hello, {""}, opts));
+  EXPECT_FALSE(first.from_cache);
+  // A trailing comment does not change the compiled program.
+  const std::string commented = absl::StrCat(params.hello, "\n# comment\n");
+  ASSERT_OK_AND_ASSIGN(
+      std::vector<MultiTestResult> results,
+      tester_sandboxer->TestMany({commented, commented},
+                                 {TestData("")}, opts));
+  for (const MultiTestResult& result : results) {
+    EXPECT_TRUE(result.from_cache);
+    EXPECT_THAT(result, TestResultsMatches(ElementsAre(HasStdout("hello\n"))));
+  }
+  EXPECT_EQ(cache.stats().hits, 2);
+}
+
+TEST_P(TesterSandboxerLanguageTest, DoesNotCacheCustomComparisons) {
+  const LanguageTestParams& params = GetParam();
+  InMemoryResultCache cache;
+  TestOptions opts;
+  opts.result_cache = &cache;
+  opts.problem_id = "hello";
+  std::unique_ptr<TesterSandboxer> tester_sandboxer = params.init();
+  for (const bool matches : {true, false}) {
+    ASSERT_OK_AND_ASSIGN(
+        MultiTestResult result,
+        tester_sandboxer->Test(
+            params.hello, {""}, opts, {"hello\n"},
+            [matches](std::string_view a, std::string_view b) -> bool {
+              return matches;
+            }));
+    ASSERT_THAT(result.test_results, SizeIs(1));
+    EXPECT_EQ(result.test_results[0].passed, matches);
+    EXPECT_FALSE(result.from_cache);
+  }
+  EXPECT_EQ(cache.stats().hits + cache.stats().misses, 0);
+}
+
 // Below are all tests that are specific to a language, so cannot be included in
 // the parameterized test.
 
@@ -481,6 +701,42 @@ x = 1
                   Each(HasProgramStatus(ProgramStatus::kSuccess)))));
 }
 
+TEST(TesterSandboxerTest, Py3ZygoteChildrenCannotUseZygoteSyscalls) {
+  std::unique_ptr<TesterSandboxer> tester_sandboxer =
+      std::make_unique<Py3TesterSandboxer>(
+          Py3InterpreterPath(), Py3LibraryPaths(), /*use_zygote=*/true);
+  std::string program = R"py(
+import errno
+import os
+import resource
+try:
+  os.wait()
+except OSError as e:
+  print(e.errno == errno.EPERM)
+try:
+  resource.setrlimit(resource.RLIMIT_CPU, (1, 1))
+except ValueError:
+  # Python reports EPERM from setrlimit as a ValueError.
+  print('refused')
+)py";
+  EXPECT_THAT(tester_sandboxer->Test(program, {""}),
+              IsOkAndHolds(TestResultsMatches(ElementsAre(
+                  AllOf(HasProgramStatus(ProgramStatus::kSuccess),
+                        HasStdout("True\nrefused\n"))))));
+}
+
+TEST(TesterSandboxerTest, Py3ZygoteChildrenDrawDifferentRandomNumbers) {
+  std::unique_ptr<TesterSandboxer> tester_sandboxer =
+      std::make_unique<Py3TesterSandboxer>(
+          Py3InterpreterPath(), Py3LibraryPaths(), /*use_zygote=*/true);
+  std::string program = "import random; print(random.getrandbits(64))";
+  // The inputs differ so that the tests are not deduplicated.
+  ASSERT_OK_AND_ASSIGN(const MultiTestResult result,
+                       tester_sandboxer->Test(program, {"1", "2"}));
+  ASSERT_THAT(result.test_results, SizeIs(2));
+  EXPECT_NE(result.test_results[0].stdout, result.test_results[1].stdout);
+}
+
 TEST(TesterSandboxerTest, Py3HandlesReadWhenNoInput) {
   std::unique_ptr<TesterSandboxer> tester_sandboxer =
       std::make_unique<Py3TesterSandboxer>(Py3InterpreterPath(),
@@ -560,6 +816,16 @@ TEST(TesterSandboxerTest, CannotStopOnFirstFailureIfNoOutputs) {
                        "outputs are not provided."));
 }
 
+TEST(TesterSandboxerTest, RejectsTooFewThreads) {
+  std::unique_ptr<TesterSandboxer> tester_sandboxer =
+      std::make_unique<Py3TesterSandboxer>(Py3InterpreterPath(),
+                                           Py3LibraryPaths());
+  TestOptions opts;
+  opts.num_threads = 0;
+  EXPECT_THAT(tester_sandboxer->Test("print('hello')", {""}, opts),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
 TEST(SandboxWithOutputFdsTest, CanReadStdout) {
   int pipe_ends[2];
   ASSERT_EQ(pipe(pipe_ends), 0);
@@ -628,5 +894,71 @@ TEST(OutputsMatchTest, NonCloseFloatsNotAccepted) {
   EXPECT_FALSE(OutputsMatch("abc 123", "abc 123.1"));
 }
 
+TEST(StreamingOutputComparatorTest, MatchesAcrossChunks) {
+  StreamingOutputComparator comparator("abc DEF\n1.5 x");
+  EXPECT_TRUE(comparator.Add("ab"));
+  EXPECT_TRUE(comparator.Add("c d"));
+  EXPECT_TRUE(comparator.Add("ef \n\n 1.500001\t"));
+  EXPECT_TRUE(comparator.Add("x"));
+  EXPECT_FALSE(comparator.mismatched());
+}
+
+TEST(StreamingOutputComparatorTest, RejectsTokensOnceTheyEnd) {
+  StreamingOutputComparator comparator("abc def");
+  EXPECT_TRUE(comparator.Add("abc de"));
+  // "deg" may still be the start of a longer token until whitespace follows.
+  EXPECT_TRUE(comparator.Add("g"));
+  EXPECT_FALSE(comparator.Add("\n"));
+  EXPECT_TRUE(comparator.mismatched());
+  EXPECT_FALSE(OutputsMatch("abc deg\n", "abc def"));
+}
+
+TEST(StreamingOutputComparatorTest, RejectsExcessTokens) {
+  StreamingOutputComparator comparator("abc");
+  EXPECT_TRUE(comparator.Add("abc\n"));
+  EXPECT_FALSE(comparator.Add("abc "));
+  EXPECT_FALSE(comparator.Add("abc "));
+  EXPECT_FALSE(OutputsMatch("abc\nabc ", "abc"));
+}
+
+TEST(StreamingOutputComparatorTest, RejectsNonCloseFloats) {
+  StreamingOutputComparator comparator("123.1 x");
+  EXPECT_FALSE(comparator.Add("123 "));
+}
+
+TEST(CpuLimitSecondsTest, RoundsUp) {
+  EXPECT_EQ(internal::CpuLimitSeconds(absl::Milliseconds(2900)), 3);
+  EXPECT_EQ(internal::CpuLimitSeconds(absl::Seconds(2)), 2);
+  EXPECT_EQ(internal::CpuLimitSeconds(absl::Milliseconds(100)), 1);
+  EXPECT_EQ(internal::CpuLimitSeconds(absl::ZeroDuration()), 1);
+}
+
+TEST(RunningProgramsTest, KillsRegisteredAndLaterPrograms) {
+  RunningPrograms running;
+  int kills = 0;
+  RunningPrograms::Registration finished = running.Add([&] { ++kills; });
+  EXPECT_FALSE(finished.Finish());
+  RunningPrograms::Registration before = running.Add([&] { ++kills; });
+  running.KillAll();
+  EXPECT_EQ(kills, 1);
+  RunningPrograms::Registration after = running.Add([&] { ++kills; });
+  EXPECT_EQ(kills, 2);
+  EXPECT_TRUE(before.Finish());
+  EXPECT_TRUE(after.Finish());
+  // Finishing again is a no-op.
+  EXPECT_FALSE(after.Finish());
+}
+
+TEST(RunningProgramsTest, KillsEachProgramOnce) {
+  RunningPrograms running;
+  int kills = 0;
+  RunningPrograms::Registration killed = running.Add([&] { ++kills; });
+  running.KillAll();
+  // Killing again only kills programs that were not killed yet.
+  running.KillAll();
+  EXPECT_EQ(kills, 1);
+  EXPECT_TRUE(killed.Finish());
+}
+
 }  // namespace
 }  // namespace deepmind::code_contests
@@ -13,45 +13,126 @@
 // limitations under the License.
 
 // A simple utility that prints the names of the problems in a dataset. If
-// provided multiple filenames as arguments, these are read sequentially.
+// provided multiple filenames as arguments, these are read concurrently but
+// printed in order. If a
+// problem index is provided (see dataset/build_problem_index.cc), names are
+// read from it for every shard it covers, without reading the shard itself.
+// Problems can be filtered with the flags in dataset/problem_filter.cc, in
+// which case every shard is read.
 //
 // Example usage:
 //
 //   print_names /path/to/dataset/code_contests_train*
+//   print_names --sources=CODEFORCES --max_cf_rating=1600 \
+//     --solution_languages=PYTHON3 /path/to/dataset/code_contests_train*
 
 #include <iostream>
-#include <tuple>
+#include <optional>
+#include <string>
+#include <utility>
 #include <vector>
 
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
 #include "absl/strings/string_view.h"
 #include "absl/types/span.h"
-#include "contest_problem.pb.h"
-#include "riegeli/bytes/fd_reader.h"
-#include "riegeli/records/record_reader.h"
+#include "dataset/problem_filter.h"
+#include "dataset/problem_index.h"
+#include "dataset/projected_problem.h"
+#include "dataset/shard_reader.h"
+#include "dataset/sharded_problem_reader.h"
+
+ABSL_FLAG(std::string, index_path, "",
+          "Optional path to a problem index for the dataset.");
+ABSL_FLAG(int, reader_threads, 4, "Number of shards to read concurrently.");
+ABSL_FLAG(int, arena_batch_size, 64,
+          "Number of records parsed onto each protobuf arena, or 0 to parse "
+          "onto the heap.");
 
 namespace {
 
-using ::deepmind::code_contests::ContestProblem;
+using ::deepmind::code_contests::IndexedProblem;
+using ::deepmind::code_contests::ProblemFilter;
+using ::deepmind::code_contests::ProblemFilterFromFlags;
+using ::deepmind::code_contests::ProblemFieldMask;
+using ::deepmind::code_contests::ProblemIndex;
+using ::deepmind::code_contests::ProjectedProblem;
+using ::deepmind::code_contests::ShardedProblemReader;
+using ::deepmind::code_contests::ShardedProblemReaderOptions;
+using ::deepmind::code_contests::ShardReadModeFromFlags;
 
-void PrintNames(const absl::Span<const absl::string_view> filenames) {
+void PrintNames(const absl::Span<const absl::string_view> filenames,
+                const std::optional<ProblemIndex>& index,
+                const ProblemFilter& filter) {
+  // Shards that are not covered by the index are read concurrently, but in
+  // order, so that the output is the same as reading them one by one.
+  std::vector<std::string> shards_to_read;
+  for (const absl::string_view filename : filenames) {
+    if (!index.has_value() || !index->IsFresh(filename)) {
+      shards_to_read.push_back(std::string(filename));
+    }
+  }
+  ShardedProblemReaderOptions options{
+      .num_threads = absl::GetFlag(FLAGS_reader_threads),
+      .deterministic = true,
+      .fields = ProblemFieldMask::NameOnly(),
+      .arena_batch_size = absl::GetFlag(FLAGS_arena_batch_size),
+      .read_mode = ShardReadModeFromFlags()};
+  filter.ApplyTo(options);
+  ShardedProblemReader reader(std::move(shards_to_read), std::move(options));
+  ProjectedProblem problem;
+  int shard_index;
+  bool has_problem = reader.ReadProblem(problem, &shard_index);
+  int next_shard_index = 0;
   for (const absl::string_view filename : filenames) {
-    riegeli::RecordReader<riegeli::FdReader<>> reader(
-        std::forward_as_tuple(filename));
-    ContestProblem problem;
-    while (reader.ReadRecord(problem)) {
-      std::cout << problem.name() << '\n';
+    if (index.has_value() && index->IsFresh(filename)) {
+      for (const IndexedProblem* location : index->ProblemsInShard(filename)) {
+        std::cout << location->name() << '\n';
+      }
+      continue;
+    }
+    while (has_problem && shard_index == next_shard_index) {
+      std::cout << problem.problem().name() << '\n';
+      has_problem = reader.ReadProblem(problem, &shard_index);
     }
-    reader.Close();
+    ++next_shard_index;
+  }
+  if (const absl::Status status = reader.Close(); !status.ok()) {
+    std::cerr << "Failed: " << status << std::endl;
   }
 }
 
 }  // namespace
 
 int main(int argc, char* argv[]) {
+  const std::vector<char*> args = absl::ParseCommandLine(argc, argv);
   std::vector<absl::string_view> filenames;
-  filenames.reserve(argc - 1);
-  for (int i = 1; i < argc; ++i) {
-    filenames.push_back(argv[i]);
+  filenames.reserve(args.size() - 1);
+  for (int i = 1; i < args.size(); ++i) {
+    filenames.push_back(args[i]);
+  }
+
+  const absl::StatusOr<ProblemFilter> filter = ProblemFilterFromFlags();
+  if (!filter.ok()) {
+    std::cerr << "Failed: " << filter.status() << std::endl;
+    return 1;
+  }
+
+  std::optional<ProblemIndex> index;
+  if (const std::string index_path = absl::GetFlag(FLAGS_index_path);
+      !index_path.empty() && !filter->MatchesAll()) {
+    // The index holds too little metadata to filter on.
+    std::cerr << "Ignoring problem index, as problems are filtered."
+              << std::endl;
+  } else if (!index_path.empty()) {
+    absl::StatusOr<ProblemIndex> loaded = ProblemIndex::Load(index_path);
+    if (loaded.ok()) {
+      index = *std::move(loaded);
+    } else {
+      std::cerr << "Ignoring problem index: " << loaded.status() << std::endl;
+    }
   }
-  PrintNames(filenames);
+  PrintNames(filenames, index, *filter);
 }